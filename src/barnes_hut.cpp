@@ -0,0 +1,355 @@
+#include "barnes_hut.h"
+#include "simulation.h"
+#include "profiler.h"
+#include "cpu_dispatch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Bits per axis in a Morton key, which is also the deepest tree level
+const int BARNES_HUT_KEY_BITS = 16;
+
+// Groups a worker claims at a time
+const int BARNES_HUT_GROUP_BATCH = 16;
+
+// Per-worker interaction lists, counted with the tree
+typedef TaggedVector<float, MEMORY_NBODY> NbodyFloats;
+
+struct BarnesHutWorkerPool
+{
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake, finished;
+    std::function<void()> job; // Claims and walks groups until none are left
+    int active;                // Workers taking part in the current job
+    unsigned int generation;
+    int busy;                  // Workers still on the current job
+    bool quit;
+};
+
+static void nbodyWorker(BarnesHutWorkerPool *pool, int index)
+{
+    profilerSetThreadName("nbody worker");
+    unsigned int seen = 0;
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    for (;;)
+    {
+        pool->wake.wait(lock, [&]() { return pool->quit || pool->generation != seen; });
+        if (pool->quit)
+            return;
+        seen = pool->generation;
+        if (index < pool->active)
+        {
+            lock.unlock();
+            pool->job();
+            lock.lock();
+        }
+        if (--pool->busy == 0)
+            pool->finished.notify_one();
+    }
+}
+
+static void stopNbodyWorkers(BarnesHutWorkerPool *pool)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->quit = true;
+    }
+    pool->wake.notify_all();
+    for (std::thread &thread : pool->threads)
+        thread.join();
+    delete pool;
+}
+
+// Run job on threadCount threads, the calling thread included. The tree's
+// pool is started on first use and grows to the most threads asked for.
+static void parallelGroups(BarnesHutTree &tree, int threadCount, const std::function<void()> &job)
+{
+    if (threadCount <= 1)
+    {
+        job();
+        return;
+    }
+    if (!tree.pool)
+    {
+        BarnesHutWorkerPool *pool = new BarnesHutWorkerPool();
+        pool->active = 0;
+        pool->generation = 0;
+        pool->busy = 0;
+        pool->quit = false;
+        tree.pool.reset(pool, stopNbodyWorkers);
+    }
+    BarnesHutWorkerPool &pool = *tree.pool;
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        while ((int)pool.threads.size() < threadCount - 1)
+            pool.threads.emplace_back(nbodyWorker, &pool, (int)pool.threads.size());
+        pool.job = job;
+        pool.active = threadCount - 1;
+        pool.busy = (int)pool.threads.size();
+        pool.generation++;
+    }
+    pool.wake.notify_all();
+    job();
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    pool.finished.wait(lock, [&]() { return pool.busy == 0; });
+}
+
+// Interleave the low 16 bits of v with zeros
+static inline unsigned int spreadBits(unsigned int v)
+{
+    v &= 0xFFFF;
+    v = (v | (v << 8)) & 0x00FF00FF;
+    v = (v | (v << 4)) & 0x0F0F0F0F;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+// LSD radix sort of keys (8 bits per pass), carrying the body permutation along
+static void radixSort(BarnesHutTree &tree, int count)
+{
+    tree.scratchKeys.resize(count);
+    tree.scratchOrder.resize(count);
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        int offsets[256] = {};
+        for (int i = 0; i < count; i++)
+            offsets[(tree.keys[i] >> shift) & 0xFF]++;
+        for (int b = 0, sum = 0; b < 256; b++)
+        {
+            int bucket = offsets[b];
+            offsets[b] = sum;
+            sum += bucket;
+        }
+        for (int i = 0; i < count; i++)
+        {
+            int slot = offsets[(tree.keys[i] >> shift) & 0xFF]++;
+            tree.scratchKeys[slot] = tree.keys[i];
+            tree.scratchOrder[slot] = tree.order[i];
+        }
+        tree.keys.swap(tree.scratchKeys);
+        tree.order.swap(tree.scratchOrder);
+    }
+}
+
+// Append the subtree for sorted bodies [first, end) whose keys share the bits above level
+static void buildNode(BarnesHutTree &tree, const BallVector &balls, int first, int end, int level, float size, bool inGroup)
+{
+    int index = (int)tree.nodes.size();
+    tree.nodes.push_back(BarnesHutNode());
+    float mass = 0.0f, sumX = 0.0f, sumY = 0.0f;
+
+    // The largest subtrees of at most BARNES_HUT_GROUP_SIZE bodies are the
+    // groups. A leaf at the deepest level can hold more (bodies sharing a key)
+    // and becomes a group of its own, so every body belongs to one.
+    bool leaf = end - first <= BARNES_HUT_LEAF_SIZE || level == BARNES_HUT_KEY_BITS;
+    if (!inGroup && (end - first <= BARNES_HUT_GROUP_SIZE || leaf))
+    {
+        tree.groups.push_back(index);
+        inGroup = true;
+    }
+
+    if (leaf)
+    {
+        for (int i = first; i < end; i++)
+        {
+            sumX += balls[i].x;
+            sumY += balls[i].y;
+        }
+        mass = (float)(end - first);
+    }
+    else
+    {
+        // Children are the runs of equal 2-bit digits at this level
+        int shift = 2 * (BARNES_HUT_KEY_BITS - 1 - level);
+        int start = first;
+        while (start < end)
+        {
+            int stop = (int)(std::upper_bound(tree.keys.begin() + start, tree.keys.begin() + end, tree.keys[start] | ((1u << shift) - 1)) - tree.keys.begin());
+            int child = (int)tree.nodes.size();
+            buildNode(tree, balls, start, stop, level + 1, size * 0.5f, inGroup);
+            const BarnesHutNode &c = tree.nodes[child];
+            mass += c.mass;
+            sumX += c.comX * c.mass;
+            sumY += c.comY * c.mass;
+            start = stop;
+        }
+    }
+
+    BarnesHutNode &node = tree.nodes[index];
+    node.mass = mass;
+    node.comX = sumX / mass;
+    node.comY = sumY / mass;
+    node.size = size;
+    node.first = first;
+    node.count = end - first;
+    node.next = (int)tree.nodes.size();
+}
+
+void buildBarnesHutTree(BarnesHutTree &tree, BallVector &balls)
+{
+    PROFILE_ZONE("buildBarnesHutTree");
+    int count = (int)balls.size();
+    tree.nodes.clear();
+    tree.groups.clear();
+    if (count == 0)
+        return;
+
+    // Root cell: a square enclosing all bodies
+    float minX = balls[0].x, maxX = balls[0].x, minY = balls[0].y, maxY = balls[0].y;
+    for (const Ball &b : balls)
+    {
+        minX = std::min(minX, b.x);
+        maxX = std::max(maxX, b.x);
+        minY = std::min(minY, b.y);
+        maxY = std::max(maxY, b.y);
+    }
+    float size = std::max(std::max(maxX - minX, maxY - minY), 1e-6f) * 1.0001f;
+    float scale = (1 << BARNES_HUT_KEY_BITS) / size;
+
+    tree.keys.resize(count);
+    tree.order.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        unsigned int qx = (unsigned int)std::min((balls[i].x - minX) * scale, 65535.0f);
+        unsigned int qy = (unsigned int)std::min((balls[i].y - minY) * scale, 65535.0f);
+        tree.keys[i] = (spreadBits(qy) << 1) | spreadBits(qx);
+        tree.order[i] = i;
+    }
+    radixSort(tree, count);
+
+    // Permute the balls in place by following the cycles of the sort order.
+    // Consecutive steps barely change it, so most bodies stay put.
+    for (int i = 0; i < count; i++)
+    {
+        if (tree.order[i] == (unsigned int)i)
+            continue;
+        Ball held = balls[i];
+        int j = i;
+        for (;;)
+        {
+            int source = (int)tree.order[j];
+            tree.order[j] = j;
+            if (source == i)
+                break;
+            balls[j] = balls[source];
+            j = source;
+        }
+        balls[j] = held;
+    }
+
+    buildNode(tree, balls, 0, count, 0, size, false);
+}
+
+// Accumulate the field of every interaction in the list on bodies [first, end).
+// The list is padded to the widest lane with massless entries.
+static void applyInteractions(BarnesHutTree &tree, const BallVector &balls, int first, int end,
+                              const NbodyFloats &listX, const NbodyFloats &listY, const NbodyFloats &listMass,
+                              const BarnesHutParams &params)
+{
+    float softeningSq = params.softening * params.softening;
+    int listCount = (int)listX.size();
+    const float *lx = listX.data(), *ly = listY.data(), *lm = listMass.data();
+    for (int i = first; i < end; i++)
+    {
+        float sums[3];
+        simdKernels->gravityList(lx, ly, lm, listCount, balls[i].x, balls[i].y, softeningSq, sums);
+        // The body's own entry adds no force but -1/softening of potential
+        tree.accelX[i] = params.gravity * sums[0];
+        tree.accelY[i] = params.gravity * sums[1];
+        tree.potential[i] = params.gravity * (1.0f / params.softening - sums[2]);
+    }
+}
+
+void computeBarnesHutForces(BarnesHutTree &tree, const BallVector &balls, const BarnesHutParams &params)
+{
+    PROFILE_ZONE("computeBarnesHutForces");
+    int count = (int)balls.size();
+    tree.accelX.resize(count);
+    tree.accelY.resize(count);
+    tree.potential.resize(count);
+    if (count == 0)
+        return;
+
+    int groupCount = (int)tree.groups.size();
+    float thetaSq = params.openingAngle * params.openingAngle;
+    std::atomic<int> nextGroup(0);
+    auto worker = [&]()
+    {
+        NbodyFloats listX, listY, listMass;
+        for (int batch = nextGroup.fetch_add(BARNES_HUT_GROUP_BATCH); batch < groupCount; batch = nextGroup.fetch_add(BARNES_HUT_GROUP_BATCH))
+        {
+            for (int g = batch; g < std::min(batch + BARNES_HUT_GROUP_BATCH, groupCount); g++)
+            {
+                const BarnesHutNode &group = tree.nodes[tree.groups[g]];
+                int first = group.first, end = group.first + group.count;
+
+                // Bounding box of the group
+                float minX = balls[first].x, maxX = minX, minY = balls[first].y, maxY = minY;
+                for (int i = first + 1; i < end; i++)
+                {
+                    minX = std::min(minX, balls[i].x);
+                    maxX = std::max(maxX, balls[i].x);
+                    minY = std::min(minY, balls[i].y);
+                    maxY = std::max(maxY, balls[i].y);
+                }
+
+                // Walk the tree once for the whole group: a cell is used as a
+                // point mass if it is small compared with its distance to the
+                // nearest point of the box and does not hold the group itself,
+                // otherwise it is opened; unopened leaves contribute their
+                // bodies directly
+                listX.clear();
+                listY.clear();
+                listMass.clear();
+                int nodeCount = (int)tree.nodes.size();
+                for (int n = 0; n < nodeCount;)
+                {
+                    const BarnesHutNode &node = tree.nodes[n];
+                    float dx = std::max(std::max(minX - node.comX, node.comX - maxX), 0.0f);
+                    float dy = std::max(std::max(minY - node.comY, node.comY - maxY), 0.0f);
+                    float distanceSq = dx * dx + dy * dy;
+                    bool holdsGroup = node.first <= first && first < node.first + node.count;
+                    if (!holdsGroup && node.size * node.size < thetaSq * distanceSq)
+                    {
+                        listX.push_back(node.comX);
+                        listY.push_back(node.comY);
+                        listMass.push_back(node.mass);
+                        n = node.next;
+                    }
+                    else if (node.next == n + 1)
+                    {
+                        for (int i = node.first; i < node.first + node.count; i++)
+                        {
+                            listX.push_back(balls[i].x);
+                            listY.push_back(balls[i].y);
+                            listMass.push_back(1.0f);
+                        }
+                        n = node.next;
+                    }
+                    else
+                    {
+                        n++;
+                    }
+                }
+                while (listX.size() % SIMD_KERNEL_MAX_LANES != 0)
+                {
+                    listX.push_back(0.0f);
+                    listY.push_back(0.0f);
+                    listMass.push_back(0.0f);
+                }
+                applyInteractions(tree, balls, first, end, listX, listY, listMass, params);
+            }
+        }
+    };
+
+    int threadCount = params.threads > 0 ? params.threads : (int)std::max(1u, std::thread::hardware_concurrency());
+    threadCount = std::min(threadCount, (groupCount + BARNES_HUT_GROUP_BATCH - 1) / BARNES_HUT_GROUP_BATCH);
+    parallelGroups(tree, threadCount, worker);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "memory_tracker.h"
+
+#include <memory>
+#include <vector>
+
+// Barnes-Hut gravity for the red demo's N-body mode. Every step the bodies
+// are sorted along a Morton (Z-order) curve and a quadtree is built over the
+// sorted array: each node covers a contiguous range of bodies, and nodes are
+// stored depth first with a skip index to the next sibling, so the tree is
+// one flat array walked without a stack. Leaves hold up to
+// BARNES_HUT_LEAF_SIZE bodies. Neighbouring bodies, up to
+// BARNES_HUT_GROUP_SIZE of them, share one walk (cells far enough from the
+// whole group become a single interaction), and the groups are spread over
+// worker threads that each tree starts on first use and keeps.
+
+struct Ball;
+
+// Body storage of BallSim, counted as ball memory
+typedef TaggedVector<Ball, MEMORY_BALLS> BallVector;
+
+// Most bodies in a leaf, and in a group sharing one tree walk
+const int BARNES_HUT_LEAF_SIZE = 16;
+const int BARNES_HUT_GROUP_SIZE = 32;
+
+struct BarnesHutNode
+{
+    float comX, comY; // Centre of mass
+    float mass;
+    float size;       // Cell edge length
+    int first, count; // Bodies covered, in sorted order
+    int next;         // Next node after this subtree; first child is this + 1 unless a leaf
+};
+
+struct BarnesHutParams
+{
+    float gravity;      // G times the mass of one body
+    float softening;    // Plummer softening length
+    float openingAngle; // Cells smaller than this times their distance are not opened
+    int threads;        // 0 = one per hardware thread
+};
+
+struct BarnesHutWorkerPool;
+
+struct BarnesHutTree
+{
+    TaggedVector<BarnesHutNode, MEMORY_NBODY> nodes;
+    TaggedVector<int, MEMORY_NBODY> groups;                      // Node indices of the walk groups
+    TaggedVector<unsigned int, MEMORY_NBODY> keys, order;        // Sorted Morton keys and the permutation that sorted them
+    TaggedVector<unsigned int, MEMORY_NBODY> scratchKeys, scratchOrder;
+    TaggedVector<float, MEMORY_NBODY> accelX, accelY, potential; // Per body, in sorted order
+    std::shared_ptr<BarnesHutWorkerPool> pool;                    // Force threads; stopped with the tree
+};
+
+// Sort balls into Morton order (the vector is permuted in place) and rebuild
+// the tree over them
+void buildBarnesHutTree(BarnesHutTree &tree, BallVector &balls);
+
+// Accelerations and potentials of all bodies, into tree.accelX/Y and tree.potential.
+// Bodies have unit mass; the potential energy of the system is half the sum
+// of the potentials.
+void computeBarnesHutForces(BarnesHutTree &tree, const BallVector &balls, const BarnesHutParams &params);
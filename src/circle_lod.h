@@ -0,0 +1,84 @@
+#pragma once
+
+// Screen-space level of detail for circle tessellation. A handful of unit
+// circle meshes are built at compile time (constexpr sin/cos tables); the mesh
+// for a circle is the coarsest one whose chord error stays below
+// CIRCLE_LOD_TOLERANCE pixels at the circle's projected radius.
+
+const int CIRCLE_LOD_LEVELS = 8;
+constexpr int CIRCLE_LOD_SEGMENTS[CIRCLE_LOD_LEVELS] = {6, 8, 12, 16, 24, 32, 48, 64};
+const int CIRCLE_MAX_SEGMENTS = 64;
+
+// Largest gap allowed between the true outline and the polygon, in pixels
+constexpr double CIRCLE_LOD_TOLERANCE = 0.5;
+
+// Points across all levels (each level repeats its first point at the end)
+constexpr int UNIT_CIRCLE_POINTS = 6 + 8 + 12 + 16 + 24 + 32 + 48 + 64 + CIRCLE_LOD_LEVELS;
+
+constexpr double CIRCLE_PI = 3.14159265358979323846;
+
+// Taylor series, accurate to float precision on [-pi, pi]
+constexpr double constexprSin(double x)
+{
+    while (x > CIRCLE_PI)
+        x -= 2.0 * CIRCLE_PI;
+    while (x < -CIRCLE_PI)
+        x += 2.0 * CIRCLE_PI;
+    double term = x, sum = x;
+    for (int n = 1; n < 12; n++)
+    {
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double constexprCos(double x)
+{
+    return constexprSin(x + CIRCLE_PI * 0.5);
+}
+
+struct UnitCircleTable
+{
+    float x[UNIT_CIRCLE_POINTS];
+    float y[UNIT_CIRCLE_POINTS];
+    int offset[CIRCLE_LOD_LEVELS];
+    float maxPixelRadius[CIRCLE_LOD_LEVELS]; // Largest radius each level draws within tolerance
+};
+
+constexpr UnitCircleTable buildUnitCircleTable()
+{
+    UnitCircleTable table = {};
+    int point = 0;
+    for (int level = 0; level < CIRCLE_LOD_LEVELS; level++)
+    {
+        int segments = CIRCLE_LOD_SEGMENTS[level];
+        table.offset[level] = point;
+        for (int i = 0; i <= segments; i++)
+        {
+            double angle = 2.0 * CIRCLE_PI * (i % segments) / segments;
+            table.x[point] = (float)constexprCos(angle);
+            table.y[point] = (float)constexprSin(angle);
+            point++;
+        }
+        // Sagitta of one segment: r (1 - cos(pi / n))
+        table.maxPixelRadius[level] = (float)(CIRCLE_LOD_TOLERANCE / (1.0 - constexprCos(CIRCLE_PI / segments)));
+    }
+    return table;
+}
+
+inline constexpr UnitCircleTable UNIT_CIRCLES = buildUnitCircleTable();
+
+static_assert(UNIT_CIRCLES.x[0] == 1.0f && UNIT_CIRCLES.y[0] == 0.0f, "unit circle starts at angle 0");
+static_assert(UNIT_CIRCLES.offset[CIRCLE_LOD_LEVELS - 1] + CIRCLE_MAX_SEGMENTS + 1 == UNIT_CIRCLE_POINTS, "table size");
+
+// LOD level for a circle of the given on-screen radius
+inline int selectCircleLod(float pixelRadius)
+{
+    for (int level = 0; level < CIRCLE_LOD_LEVELS - 1; level++)
+    {
+        if (pixelRadius <= UNIT_CIRCLES.maxPixelRadius[level])
+            return level;
+    }
+    return CIRCLE_LOD_LEVELS - 1;
+}
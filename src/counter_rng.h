@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+
+// Counter-based random numbers (Philox4x32-10, Salmon et al. 2011). Each
+// draw is a pure function of a key and a counter, with no generator state,
+// so results do not depend on the order or the thread that makes them: key
+// with the run's seed and a stream tag, count with what is being randomised
+// (an object's index and the step). Four independent 32-bit words per call.
+
+struct CounterRngKey
+{
+    uint32_t seed;   // Run seed
+    uint32_t stream; // Tag that separates the uses of one seed
+};
+
+// Philox round constants
+const uint32_t PHILOX_M0 = 0xD2511F53u;
+const uint32_t PHILOX_M1 = 0xCD9E8D57u;
+const uint32_t PHILOX_W0 = 0x9E3779B9u;
+const uint32_t PHILOX_W1 = 0xBB67AE85u;
+const int PHILOX_ROUNDS = 10;
+
+// Philox4x32-10 of the counter (c0, c1, c2, c3) under the key (k0, k1)
+inline void philox4x32(const uint32_t counter[4], uint32_t k0, uint32_t k1, uint32_t out[4])
+{
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    for (int round = 0; round < PHILOX_ROUNDS; round++)
+    {
+        uint64_t product0 = (uint64_t)PHILOX_M0 * c0;
+        uint64_t product1 = (uint64_t)PHILOX_M1 * c2;
+        uint32_t next0 = (uint32_t)(product1 >> 32) ^ c1 ^ k0;
+        uint32_t next2 = (uint32_t)(product0 >> 32) ^ c3 ^ k1;
+        c1 = (uint32_t)product1;
+        c3 = (uint32_t)product0;
+        c0 = next0;
+        c2 = next2;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+// Uniform float in [0, 1) from the top 24 bits of a word
+inline float counterRngUnit(uint32_t bits)
+{
+    return (float)(bits >> 8) * (1.0f / 16777216.0f);
+}
+
+// Four uniform floats in [0, 1) for item id at step
+inline void counterRngFloats(CounterRngKey key, uint32_t id, uint64_t step, float out[4])
+{
+    uint32_t counter[4] = {id, (uint32_t)step, (uint32_t)(step >> 32), 0};
+    uint32_t bits[4];
+    philox4x32(counter, key.seed, key.stream, bits);
+    for (int k = 0; k < 4; k++)
+        out[k] = counterRngUnit(bits[k]);
+}
+
+// counterRngFloats for items firstId .. firstId + count - 1 into out[4 * i ..
+// 4 * i + 3], several items at a time with SSE2; identical to the scalar results
+void counterRngFloatBatch(CounterRngKey key, uint32_t firstId, int count, uint64_t step, float *out);
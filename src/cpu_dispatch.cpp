@@ -0,0 +1,102 @@
+#include "cpu_dispatch.h"
+
+#include <cstring>
+#include <iostream>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#define CPU_DISPATCH_X86 1
+#elif defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#define CPU_DISPATCH_X86 1
+#else
+#define CPU_DISPATCH_X86 0
+#endif
+
+extern const SimdKernels simdKernelsBaseline;
+extern const SimdKernels simdKernelsAvx2;
+extern const SimdKernels simdKernelsAvx512;
+
+const SimdKernels *simdKernels = &simdKernelsBaseline;
+
+#if CPU_DISPATCH_X86
+static void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int regs[4])
+{
+#if defined(_MSC_VER)
+    __cpuidex((int *)regs, (int)leaf, (int)subleaf);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Register state the OS saves on context switches (XCR0)
+static unsigned long long enabledStateMask()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+#endif
+
+SimdIsa detectSimdIsa()
+{
+#if CPU_DISPATCH_X86
+    unsigned int regs[4];
+    cpuid(0, 0, regs);
+    unsigned int maxLeaf = regs[0];
+    cpuid(1, 0, regs);
+    bool osxsave = (regs[2] >> 27) & 1, avx = (regs[2] >> 28) & 1, fma = (regs[2] >> 12) & 1;
+    if (!osxsave || !avx || maxLeaf < 7)
+        return SimdIsa::BASELINE;
+
+    // The OS must save the YMM (and for AVX-512 the opmask and ZMM) registers
+    unsigned long long state = enabledStateMask();
+    bool ymmSaved = (state & 0x6) == 0x6, zmmSaved = (state & 0xE6) == 0xE6;
+    cpuid(7, 0, regs);
+    bool avx2 = (regs[1] >> 5) & 1, avx512f = (regs[1] >> 16) & 1;
+    if (avx512f && zmmSaved)
+        return SimdIsa::AVX512;
+    if (avx2 && fma && ymmSaved)
+        return SimdIsa::AVX2;
+#endif
+    return SimdIsa::BASELINE;
+}
+
+SimdIsa initSimdKernels(SimdIsa limit)
+{
+    SimdIsa isa = detectSimdIsa();
+    if ((int)isa > (int)limit)
+        isa = limit;
+    switch (isa)
+    {
+    case SimdIsa::AVX512:
+        simdKernels = &simdKernelsAvx512;
+        break;
+    case SimdIsa::AVX2:
+        simdKernels = &simdKernelsAvx2;
+        break;
+    case SimdIsa::BASELINE:
+        simdKernels = &simdKernelsBaseline;
+        break;
+    }
+    std::cout << "SIMD kernels: " << simdKernels->name << " (" << simdKernels->lanes << " lanes)" << std::endl;
+    return isa;
+}
+
+bool parseSimdIsa(const char *name, SimdIsa &isa)
+{
+    if (strcmp(name, "baseline") == 0 || strcmp(name, "sse2") == 0)
+        isa = SimdIsa::BASELINE;
+    else if (strcmp(name, "avx2") == 0)
+        isa = SimdIsa::AVX2;
+    else if (strcmp(name, "avx512") == 0)
+        isa = SimdIsa::AVX512;
+    else
+        return false;
+    return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+// Instruction-set dispatch for the SIMD kernels. The kernels in
+// simd_kernels.inl are compiled once per target in their own translation
+// units (simd_kernels_baseline/avx2/avx512.cpp, each with its own compiler
+// flags), and at startup the best table the CPU and OS support is picked from
+// CPUID and XGETBV. The baseline unit uses the build's default flags, so the
+// binary runs anywhere the build does. The per-target units only include
+// simd_lane.h (whose operations have internal linkage) so that no inline
+// function built for a newer instruction set can leak into baseline code.
+
+// Widest lane the kernels may use; interaction lists and the like are padded
+// to a multiple of this
+const int SIMD_KERNEL_MAX_LANES = 16;
+
+// Square ensembles are padded to a multiple of this many systems, enough
+// whole groups of interleaved lane blocks for any table
+const int SIMD_KERNEL_ENSEMBLE_PADDING = SIMD_KERNEL_MAX_LANES * 4;
+
+// Structure-of-arrays state of a square ensemble (see square_ensemble.h)
+struct EnsembleArrays
+{
+    float *x0, *x1, *v0, *v1;
+    const float *m0, *m1;
+    float *collisions;
+    float *momentumHistory, *energyHistory; // Sample s of system i at [s * padded + i]; NULL without history
+    int padded;                             // Systems, a multiple of SIMD_KERNEL_ENSEMBLE_PADDING
+};
+
+enum class SimdIsa
+{
+    BASELINE, // SSE2 on x86-64, whatever the build targets elsewhere
+    AVX2,     // AVX2 and FMA
+    AVX512    // AVX-512F
+};
+
+struct SimdKernels
+{
+    const char *name; // Instruction set the table was compiled for
+    int lanes;
+
+    // Gravity of an interaction list (count a multiple of lanes, padded with
+    // massless entries) on a body at (x, y): sums of m dx / r^3, m dy / r^3
+    // and m / r with Plummer softening, into sums[0..2]
+    void (*gravityList)(const float *listX, const float *listY, const float *listMass, int count, float x, float y,
+                        float softeningSq, float sums[3]);
+
+    // Multigrid rows (see stable_fluid.cpp): x, b and the outputs point at the
+    // first interior cell of a row; neighbours are at +-1 and +-stride
+    void (*jacobiRow)(const float *x, const float *b, const float *invDiag, float *out, int width, int stride, float weight);
+    void (*residualRow)(const float *x, const float *b, const float *diag, const float *fluidMask, float *out, int width,
+                        int stride);
+
+    // Stable-fluid projection rows: out = (u[i + 1] - u[i] + vTop - vBottom) *
+    // cellSize * fluidMask, and velocity -= (p - pBelow) * inverseH * open
+    void (*divergenceRow)(const float *u, const float *vBottom, const float *vTop, const float *fluidMask, float *out,
+                          int width, float cellSize);
+    void (*gradientRow)(const float *p, const float *pBelow, const float *open, float *velocity, int count, float inverseH);
+
+    // Square ensemble steps firstStep + 1 .. firstStep + steps, recording history
+    // every interval steps (0 for none); squares are size wide in [left, right]
+    void (*squareEnsembleSteps)(const EnsembleArrays &arrays, int firstStep, int steps, int interval, float size, float left,
+                                float right);
+};
+
+// The table in use; the baseline until initSimdKernels picks another
+extern const SimdKernels *simdKernels;
+
+// Best instruction set this CPU and OS support
+SimdIsa detectSimdIsa();
+
+// Pick the kernels for the best supported instruction set, at most limit, and
+// log the choice; returns the instruction set picked
+SimdIsa initSimdKernels(SimdIsa limit = SimdIsa::AVX512);
+
+// Parse "baseline"/"sse2", "avx2" or "avx512"
+bool parseSimdIsa(const char *name, SimdIsa &isa);
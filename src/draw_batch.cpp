@@ -0,0 +1,237 @@
+#include "draw_batch.h"
+#include "memory_tracker.h"
+#include "profiler.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <iostream>
+
+// Scene space is reserved in steps of this many vertices so that switching
+// between obstacle shapes does not reallocate the buffer every time
+const int SCENE_RESERVE_STEP = 1024;
+
+// Floats per vertex: position + colour
+const int BATCH_VERTEX_FLOATS = 6;
+
+RenderStats renderStats;
+
+// Totals over all frames for the exit summary
+static long long statsFrames = 0;
+static long long totalDrawCalls = 0, totalStateChanges = 0, totalBatchedDraws = 0;
+static int maxDrawCalls = 0, maxStateChanges = 0;
+
+void setPositionColorLayout()
+{
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+}
+
+void initDrawBatch(DrawBatch &batch, unsigned int program, FrameArena &arena)
+{
+    glGenVertexArrays(1, &batch.vao);
+    glGenBuffers(1, &batch.vbo);
+    glBindVertexArray(batch.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, batch.vbo);
+    setPositionColorLayout();
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    batch.program = program;
+    batch.arena = &arena;
+    batch.bufferBytes = 0;
+    batch.sceneVertices = 0;
+    batch.scene = nullptr;
+    batch.itemVertices = nullptr;
+    batch.used = 0;
+    batch.flushed = 0;
+    batch.items.clear();
+    batch.draws.clear();
+}
+
+// Make the data store hold at least the given number of bytes. Growing
+// discards the contents, so the scene is uploaded again.
+static void reserveBatchBuffer(DrawBatch &batch, size_t bytes)
+{
+    if (bytes <= batch.bufferBytes)
+        return;
+    batch.bufferBytes = std::max(bytes, batch.bufferBytes * 2);
+    glBufferData(GL_ARRAY_BUFFER, batch.bufferBytes, nullptr, GL_DYNAMIC_DRAW);
+    trackGlBuffer(batch.vbo, batch.bufferBytes, MEMORY_GL_DRAW_BATCH);
+    if (batch.scene && !batch.scene->vertices.empty())
+    {
+        size_t sceneBytes = batch.scene->vertices.size() * sizeof(float);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sceneBytes, batch.scene->vertices.data());
+        renderStats.uploadBytes += sceneBytes;
+    }
+}
+
+void setDrawBatchScene(DrawBatch &batch, const RetainedScene &scene)
+{
+    PROFILE_ZONE("setDrawBatchScene");
+    batch.scene = &scene;
+    int vertices = (int)(scene.vertices.size() / BATCH_VERTEX_FLOATS);
+    glBindBuffer(GL_ARRAY_BUFFER, batch.vbo);
+    if (vertices > batch.sceneVertices)
+    {
+        // Dynamic data moves behind the larger scene; it is re-uploaded every frame anyway
+        batch.sceneVertices = (vertices + SCENE_RESERVE_STEP - 1) / SCENE_RESERVE_STEP * SCENE_RESERVE_STEP;
+        batch.bufferBytes = 0;
+        reserveBatchBuffer(batch, (size_t)batch.sceneVertices * BATCH_VERTEX_FLOATS * sizeof(float));
+    }
+    else if (vertices > 0)
+    {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, scene.vertices.size() * sizeof(float), scene.vertices.data());
+        renderStats.uploadBytes += scene.vertices.size() * sizeof(float);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void beginDrawBatch(DrawBatch &batch)
+{
+    batch.used = 0;
+    batch.flushed = 0;
+    batch.items.clear();
+    batch.draws.clear();
+}
+
+void batchSceneItem(DrawBatch &batch, int item)
+{
+    const SceneRange &range = batch.scene->ranges[item];
+    if (range.count > 0)
+        batch.draws.push_back(BatchDraw{range.mode, range.first, range.count});
+}
+
+float *beginBatchItem(DrawBatch &batch, int maxVertices)
+{
+    batch.itemVertices = frameArenaAlloc<float>(*batch.arena, (size_t)maxVertices * BATCH_VERTEX_FLOATS);
+    return batch.itemVertices;
+}
+
+void endBatchItem(DrawBatch &batch, unsigned int mode, int floatsWritten)
+{
+    int count = floatsWritten / BATCH_VERTEX_FLOATS;
+    if (count == 0)
+        return;
+    // Items sit back to back in the dynamic region
+    batch.items.push_back(BatchItem{batch.itemVertices, floatsWritten});
+    batch.draws.push_back(BatchDraw{mode, batch.sceneVertices + (int)(batch.used / BATCH_VERTEX_FLOATS), count});
+    batch.used += floatsWritten;
+}
+
+void endBatchItemRuns(DrawBatch &batch, unsigned int mode, const int *counts, int runs)
+{
+    int first = batch.sceneVertices + (int)(batch.used / BATCH_VERTEX_FLOATS);
+    int total = 0;
+    for (int r = 0; r < runs; r++)
+    {
+        if (counts[r] > 0)
+            batch.draws.push_back(BatchDraw{mode, first + total, counts[r]});
+        total += counts[r];
+    }
+    if (total == 0)
+        return;
+    batch.items.push_back(BatchItem{batch.itemVertices, total * BATCH_VERTEX_FLOATS});
+    batch.used += (size_t)total * BATCH_VERTEX_FLOATS;
+}
+
+// Separate primitives can be joined into one range when their vertices are adjacent
+static bool isListMode(unsigned int mode)
+{
+    return mode == GL_TRIANGLES || mode == GL_LINES || mode == GL_POINTS;
+}
+
+void flushDrawBatch(DrawBatch &batch)
+{
+    PROFILE_ZONE("flushDrawBatch");
+    if (batch.draws.empty())
+        return;
+
+    // Upload the dynamic vertices queued since the last flush
+    glBindBuffer(GL_ARRAY_BUFFER, batch.vbo);
+    if (batch.used > batch.flushed)
+    {
+        size_t sceneBytes = (size_t)batch.sceneVertices * BATCH_VERTEX_FLOATS * sizeof(float);
+        size_t offset = sceneBytes + batch.flushed * sizeof(float);
+        size_t bytes = (batch.used - batch.flushed) * sizeof(float);
+        reserveBatchBuffer(batch, offset + bytes);
+        for (const BatchItem &item : batch.items)
+        {
+            glBufferSubData(GL_ARRAY_BUFFER, offset, item.floats * sizeof(float), item.vertices);
+            offset += item.floats * sizeof(float);
+        }
+        renderStats.uploadBytes += bytes;
+        batch.flushed = batch.used;
+        batch.items.clear();
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glUseProgram(batch.program);
+    glBindVertexArray(batch.vao);
+    renderStats.stateChanges += 2;
+
+    // One submission per run of draws sharing a primitive type; painter's
+    // order is kept because runs are never reordered
+    size_t i = 0;
+    while (i < batch.draws.size())
+    {
+        unsigned int mode = batch.draws[i].mode;
+        batch.firsts.clear();
+        batch.counts.clear();
+        for (; i < batch.draws.size() && batch.draws[i].mode == mode; i++)
+        {
+            const BatchDraw &draw = batch.draws[i];
+            if (!batch.firsts.empty() && isListMode(mode) && batch.firsts.back() + batch.counts.back() == draw.first)
+                batch.counts.back() += draw.count;
+            else
+            {
+                batch.firsts.push_back(draw.first);
+                batch.counts.push_back(draw.count);
+            }
+        }
+        if (batch.firsts.size() == 1)
+            glDrawArrays(mode, batch.firsts[0], batch.counts[0]);
+        else
+            glMultiDrawArrays(mode, batch.firsts.data(), batch.counts.data(), (GLsizei)batch.firsts.size());
+        renderStats.drawCalls++;
+    }
+    renderStats.batchedDraws += (int)batch.draws.size();
+    batch.draws.clear();
+}
+
+void destroyDrawBatch(DrawBatch &batch)
+{
+    glDeleteVertexArrays(1, &batch.vao);
+    releaseGlBuffer(batch.vbo);
+    glDeleteBuffers(1, &batch.vbo);
+    batch.vao = 0;
+    batch.vbo = 0;
+}
+
+void beginRenderStats()
+{
+    renderStats = RenderStats{};
+}
+
+void endRenderStats()
+{
+    statsFrames++;
+    totalDrawCalls += renderStats.drawCalls;
+    totalStateChanges += renderStats.stateChanges;
+    totalBatchedDraws += renderStats.batchedDraws;
+    maxDrawCalls = std::max(maxDrawCalls, renderStats.drawCalls);
+    maxStateChanges = std::max(maxStateChanges, renderStats.stateChanges);
+}
+
+void printRenderStats()
+{
+    if (statsFrames == 0)
+        return;
+    std::cout << "Render: " << (double)totalDrawCalls / statsFrames << " draw calls ("
+              << (double)totalBatchedDraws / statsFrames << " batched draws), "
+              << (double)totalStateChanges / statsFrames << " state changes per frame on average; max "
+              << maxDrawCalls << " draw calls, " << maxStateChanges << " state changes over "
+              << statsFrames << " frames" << std::endl;
+}
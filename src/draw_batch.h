@@ -0,0 +1,97 @@
+#pragma once
+
+#include "frame_arena.h"
+#include "retained_scene.h"
+
+#include <cstddef>
+#include <vector>
+
+// Batched renderer for everything drawn with the position + colour shader.
+// One vertex buffer holds the retained scene at the front (uploaded only when
+// the scene is rebuilt) followed by the frame's dynamic geometry. Draws are
+// queued in painter's order; flushDrawBatch uploads the dynamic vertices once
+// and submits each run of draws sharing a primitive type with a single
+// glMultiDrawArrays, so a demo frame costs one or two draw calls.
+
+struct BatchDraw
+{
+    unsigned int mode; // GL primitive type
+    int first;         // First vertex in the shared buffer
+    int count;
+};
+
+// Dynamic vertices written by the caller, waiting for upload
+struct BatchItem
+{
+    const float *vertices;
+    int floats;
+};
+
+struct DrawBatch
+{
+    unsigned int vao, vbo;
+    unsigned int program;
+    FrameArena *arena;               // Scratch memory for dynamic vertices
+    size_t bufferBytes;              // Size of the buffer's data store
+    int sceneVertices;               // Vertices reserved at the front for the retained scene
+    const RetainedScene *scene;      // Re-uploaded if the buffer has to grow
+    float *itemVertices;             // Item being built
+    size_t used;                     // Dynamic floats placed this frame
+    size_t flushed;                  // Dynamic floats already uploaded this frame
+    std::vector<BatchItem> items;    // Built since the last flush
+    std::vector<BatchDraw> draws;    // Queued since the last flush
+    std::vector<int> firsts, counts; // glMultiDrawArrays arguments
+};
+
+// GL work submitted in the current frame. State changes count the calls that
+// change pipeline state between draws: program and VAO binds, texture binds,
+// uniform uploads and capability toggles.
+struct RenderStats
+{
+    int drawCalls;
+    int stateChanges;
+    int batchedDraws; // Queued draws, before merging into multi-draws
+    size_t uploadBytes;
+};
+
+extern RenderStats renderStats;
+
+// Bind the shared position (location 0) + colour (location 1) layout to the
+// currently bound VAO and array buffer
+void setPositionColorLayout();
+
+// Dynamic vertices are allocated from the arena, which must not be reset
+// between beginDrawBatch and the last flush of the frame
+void initDrawBatch(DrawBatch &batch, unsigned int program, FrameArena &arena);
+
+// Upload a freshly built retained scene into the front of the buffer
+void setDrawBatchScene(DrawBatch &batch, const RetainedScene &scene);
+
+// Start a frame: drops the previous frame's dynamic geometry
+void beginDrawBatch(DrawBatch &batch);
+
+// Queue one item of the retained scene
+void batchSceneItem(DrawBatch &batch, int item);
+
+// Queue dynamic geometry: reserve room for maxVertices, write them through the
+// returned pointer and close the item with the number of floats written
+float *beginBatchItem(DrawBatch &batch, int maxVertices);
+void endBatchItem(DrawBatch &batch, unsigned int mode, int floatsWritten);
+
+// Close an item holding several separate primitives of one type back to back
+// (line strips, say), uploaded as one block; counts[r] is the vertex count of
+// run r
+void endBatchItemRuns(DrawBatch &batch, unsigned int mode, const int *counts, int runs);
+
+// Submit everything queued. Call before drawing with another shader and at the
+// end of the frame; leaves the batch's program and VAO bound.
+void flushDrawBatch(DrawBatch &batch);
+
+void destroyDrawBatch(DrawBatch &batch);
+
+// Per-frame counters: reset at the start of a frame, accumulated at the end
+void beginRenderStats();
+void endRenderStats();
+
+// Print averages and maxima over all frames recorded
+void printRenderStats();
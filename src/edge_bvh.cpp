@@ -0,0 +1,185 @@
+#include "edge_bvh.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Query stacks hold at most one pending sibling per level, and median splits
+// keep the depth near log2 of the edge count
+const int EDGE_BVH_MAX_DEPTH = 64;
+
+struct EdgeRef
+{
+    float midX, midY;
+    int edge;
+};
+
+static int buildNode(EdgeBvh &bvh, const std::vector<float> &source, std::vector<EdgeRef> &refs, int first, int end)
+{
+    int index = (int)bvh.nodes.size();
+    bvh.nodes.push_back(EdgeBvhNode());
+
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+    float midMinX = 1e30f, midMinY = 1e30f, midMaxX = -1e30f, midMaxY = -1e30f;
+    for (int i = first; i < end; i++)
+    {
+        const float *e = &source[refs[i].edge * 4];
+        minX = std::min(minX, std::min(e[0], e[2]));
+        maxX = std::max(maxX, std::max(e[0], e[2]));
+        minY = std::min(minY, std::min(e[1], e[3]));
+        maxY = std::max(maxY, std::max(e[1], e[3]));
+        midMinX = std::min(midMinX, refs[i].midX);
+        midMaxX = std::max(midMaxX, refs[i].midX);
+        midMinY = std::min(midMinY, refs[i].midY);
+        midMaxY = std::max(midMaxY, refs[i].midY);
+    }
+
+    int right = -1, leafFirst = 0, leafCount = 0;
+    if (end - first <= EDGE_BVH_LEAF_SIZE)
+    {
+        // Leaf: copy its edges out in order
+        leafFirst = (int)bvh.edges.size() / 4;
+        leafCount = end - first;
+        for (int i = first; i < end; i++)
+            bvh.edges.insert(bvh.edges.end(), &source[refs[i].edge * 4], &source[refs[i].edge * 4] + 4);
+    }
+    else
+    {
+        int middle = (first + end) / 2;
+        bool splitX = midMaxX - midMinX >= midMaxY - midMinY;
+        std::nth_element(refs.begin() + first, refs.begin() + middle, refs.begin() + end,
+                         [splitX](const EdgeRef &a, const EdgeRef &b) { return splitX ? a.midX < b.midX : a.midY < b.midY; });
+        buildNode(bvh, source, refs, first, middle);
+        right = buildNode(bvh, source, refs, middle, end);
+    }
+
+    EdgeBvhNode &node = bvh.nodes[index];
+    node.minX = minX;
+    node.minY = minY;
+    node.maxX = maxX;
+    node.maxY = maxY;
+    node.right = right;
+    node.first = leafFirst;
+    node.count = leafCount;
+    return index;
+}
+
+void buildEdgeBvh(EdgeBvh &bvh, const TaggedVector<float, MEMORY_OBSTACLES> &points,
+                  const TaggedVector<int, MEMORY_OBSTACLES> &ringEnds)
+{
+    PROFILE_ZONE("buildEdgeBvh");
+    bvh.edges.clear();
+    bvh.nodes.clear();
+
+    // Every ring is closed from its last point back to its first
+    std::vector<float> source;
+    std::vector<EdgeRef> refs;
+    for (size_t r = 0, start = 0; r < ringEnds.size(); start = ringEnds[r++])
+    {
+        int end = ringEnds[r];
+        for (int i = (int)start; i < end; i++)
+        {
+            int j = i + 1 < end ? i + 1 : (int)start;
+            float ax = points[i * 2], ay = points[i * 2 + 1], bx = points[j * 2], by = points[j * 2 + 1];
+            if (ax == bx && ay == by)
+                continue;
+            refs.push_back(EdgeRef{0.5f * (ax + bx), 0.5f * (ay + by), (int)source.size() / 4});
+            source.insert(source.end(), {ax, ay, bx, by});
+        }
+    }
+    if (refs.empty())
+        return;
+    bvh.edges.reserve(source.size());
+    buildNode(bvh, source, refs, 0, (int)refs.size());
+}
+
+static inline float boxDistanceSq(const EdgeBvhNode &node, float x, float y)
+{
+    float dx = std::max(std::max(node.minX - x, x - node.maxX), 0.0f);
+    float dy = std::max(std::max(node.minY - y, y - node.maxY), 0.0f);
+    return dx * dx + dy * dy;
+}
+
+float edgeBvhClosestPoint(const EdgeBvh &bvh, float x, float y, float &closestX, float &closestY)
+{
+    float bestSq = 1e30f;
+    closestX = x;
+    closestY = y;
+    if (bvh.nodes.empty())
+        return 1e30f;
+
+    // Depth first, nearer child first, skipping boxes farther than the best edge so far
+    int stack[EDGE_BVH_MAX_DEPTH * 2];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        int n = stack[--top];
+        const EdgeBvhNode &node = bvh.nodes[n];
+        if (boxDistanceSq(node, x, y) >= bestSq)
+            continue;
+        if (node.right < 0)
+        {
+            for (int i = node.first; i < node.first + node.count; i++)
+            {
+                const float *e = &bvh.edges[i * 4];
+                float ex = e[2] - e[0], ey = e[3] - e[1];
+                float t = ((x - e[0]) * ex + (y - e[1]) * ey) / (ex * ex + ey * ey);
+                t = std::min(std::max(t, 0.0f), 1.0f);
+                float px = e[0] + t * ex, py = e[1] + t * ey;
+                float distanceSq = (x - px) * (x - px) + (y - py) * (y - py);
+                if (distanceSq < bestSq)
+                {
+                    bestSq = distanceSq;
+                    closestX = px;
+                    closestY = py;
+                }
+            }
+            continue;
+        }
+        int left = n + 1, right = node.right;
+        if (boxDistanceSq(bvh.nodes[left], x, y) < boxDistanceSq(bvh.nodes[right], x, y))
+            std::swap(left, right);
+        stack[top++] = left;
+        stack[top++] = right; // Popped first
+    }
+    return sqrt(bestSq);
+}
+
+bool edgeBvhInside(const EdgeBvh &bvh, float x, float y)
+{
+    if (bvh.nodes.empty())
+        return false;
+    bool inside = false;
+    int stack[EDGE_BVH_MAX_DEPTH * 2];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        int n = stack[--top];
+        const EdgeBvhNode &node = bvh.nodes[n];
+        // Only boxes straddling the ray's height and reaching right of the point
+        if (y < node.minY || y > node.maxY || node.maxX < x)
+            continue;
+        if (node.right < 0)
+        {
+            for (int i = node.first; i < node.first + node.count; i++)
+            {
+                const float *e = &bvh.edges[i * 4];
+                if ((e[1] > y) != (e[3] > y) && x < e[0] + (y - e[1]) * (e[2] - e[0]) / (e[3] - e[1]))
+                    inside = !inside;
+            }
+            continue;
+        }
+        stack[top++] = n + 1;
+        stack[top++] = node.right;
+    }
+    return inside;
+}
+
+float edgeBvhSignedDistance(const EdgeBvh &bvh, float x, float y)
+{
+    float closestX, closestY;
+    float distance = edgeBvhClosestPoint(bvh, x, y, closestX, closestY);
+    return edgeBvhInside(bvh, x, y) ? -distance : distance;
+}
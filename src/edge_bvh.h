@@ -0,0 +1,40 @@
+#pragma once
+
+#include "memory_tracker.h"
+
+#include <vector>
+
+// Bounding volume hierarchy over the edges of closed polygons, answering
+// closest-point and inside/outside queries in time logarithmic in the edge
+// count. Edges are split at the median of their midpoints along the longer
+// axis; nodes are stored depth first in one array, so a node's left child is
+// the next node and only the right child needs an index.
+
+// Most edges in a leaf
+const int EDGE_BVH_LEAF_SIZE = 4;
+
+struct EdgeBvhNode
+{
+    float minX, minY, maxX, maxY;
+    int right;        // Right child, or -1 for a leaf
+    int first, count; // Edges covered, in leaf order
+};
+
+struct EdgeBvh
+{
+    TaggedVector<float, MEMORY_OBSTACLES> edges; // ax, ay, bx, by per edge, in leaf order
+    TaggedVector<EdgeBvhNode, MEMORY_OBSTACLES> nodes;
+};
+
+// Build over closed rings of x/y points; ringEnds holds one past the last point of each ring
+void buildEdgeBvh(EdgeBvh &bvh, const TaggedVector<float, MEMORY_OBSTACLES> &points,
+                  const TaggedVector<int, MEMORY_OBSTACLES> &ringEnds);
+
+// Distance from (x, y) to the nearest edge and the point on it (1e30 without edges)
+float edgeBvhClosestPoint(const EdgeBvh &bvh, float x, float y, float &closestX, float &closestY);
+
+// Even-odd inside test: counts the edges crossed by a ray towards +x
+bool edgeBvhInside(const EdgeBvh &bvh, float x, float y);
+
+// Signed distance to the edges (negative inside)
+float edgeBvhSignedDistance(const EdgeBvh &bvh, float x, float y);
@@ -0,0 +1,200 @@
+#include "flow_lines.h"
+#include "stable_fluid.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+// Points per streamline whose velocity decides whether it is kept
+const int FLOW_LINE_PROBES = 8;
+
+// Seeds a worker claims at a time
+const int FLOW_LINE_SEED_BATCH = 16;
+
+// Below this speed (box units per step) the flow counts as stagnant and a
+// streamline ends
+const float FLOW_LINE_MIN_SPEED = 1e-6f;
+
+void initFlowLines(FlowLines &lines, const FlowLineParams &params, float minX, float minY, float maxX, float maxY)
+{
+    lines.seedCount = std::max(1, params.seeds);
+    lines.maxPoints = std::max(2, params.maxPoints);
+    lines.minX = minX;
+    lines.minY = minY;
+    lines.maxX = maxX;
+    lines.maxY = maxY;
+
+    // The rake sits just inside the inflow edge
+    lines.seedX.assign(lines.seedCount, minX + 1e-3f * (maxX - minX));
+    lines.seedY.resize(lines.seedCount);
+    for (int s = 0; s < lines.seedCount; s++)
+        lines.seedY[s] = minY + (s + 0.5f) * (maxY - minY) / lines.seedCount;
+
+    lines.points.assign((size_t)lines.seedCount * lines.maxPoints * 2, 0.0f);
+    lines.counts.assign(lines.seedCount, 0);
+    lines.probes.assign((size_t)lines.seedCount * FLOW_LINE_PROBES * 2, 0.0f);
+    lines.traced.assign(lines.seedCount, 0);
+    lines.retraced = 0;
+}
+
+void clearFlowLines(FlowLines &lines)
+{
+    std::fill(lines.counts.begin(), lines.counts.end(), 0);
+    std::fill(lines.traced.begin(), lines.traced.end(), 0);
+}
+
+// Run work(seed) for every seed, spread over worker threads
+template <typename Work>
+static void forEachSeed(int seedCount, int threads, const Work &work)
+{
+    std::atomic<int> nextSeed(0);
+    auto worker = [&]()
+    {
+        for (int batch = nextSeed.fetch_add(FLOW_LINE_SEED_BATCH); batch < seedCount; batch = nextSeed.fetch_add(FLOW_LINE_SEED_BATCH))
+            for (int s = batch; s < std::min(batch + FLOW_LINE_SEED_BATCH, seedCount); s++)
+                work(s);
+    };
+    int threadCount = threads > 0 ? threads : (int)std::max(1u, std::thread::hardware_concurrency());
+    threadCount = std::min(threadCount, (seedCount + FLOW_LINE_SEED_BATCH - 1) / FLOW_LINE_SEED_BATCH);
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threadCount; t++)
+        workers.emplace_back(worker);
+    worker();
+    for (std::thread &thread : workers)
+        thread.join();
+}
+
+static bool insideBox(const FlowLines &lines, float x, float y)
+{
+    return x >= lines.minX && x <= lines.maxX && y >= lines.minY && y <= lines.maxY;
+}
+
+// Unit flow direction at a point; false where the flow is stagnant
+static bool flowDirection(const StableFluid &field, float x, float y, float &dx, float &dy)
+{
+    float vx, vy;
+    sampleStableFluidVelocity(field, x, y, vx, vy);
+    float speed = std::sqrt(vx * vx + vy * vy);
+    if (speed < FLOW_LINE_MIN_SPEED)
+        return false;
+    dx = vx / speed;
+    dy = vy / speed;
+    return true;
+}
+
+// Index of probe k along a line of count points
+static int probePoint(int count, int k)
+{
+    return (count - 1) * k / (FLOW_LINE_PROBES - 1);
+}
+
+// Whether the field at the line's probe points is still what it was traced through
+static bool streamlineCurrent(const FlowLines &lines, const StableFluid &field, int s, float tolerance)
+{
+    if (!lines.traced[s])
+        return false;
+    const float *line = &lines.points[(size_t)s * lines.maxPoints * 2];
+    const float *probe = &lines.probes[(size_t)s * FLOW_LINE_PROBES * 2];
+    for (int k = 0; k < FLOW_LINE_PROBES; k++)
+    {
+        int p = probePoint(lines.counts[s], k);
+        float vx, vy;
+        sampleStableFluidVelocity(field, line[p * 2], line[p * 2 + 1], vx, vy);
+        float dx = vx - probe[k * 2], dy = vy - probe[k * 2 + 1];
+        if (dx * dx + dy * dy > tolerance * tolerance)
+            return false;
+    }
+    return true;
+}
+
+// RK4 in arc length from the seed until the line leaves the box, reaches the
+// obstacle or stagnant air, or runs out of points
+static void traceStreamline(FlowLines &lines, const StableFluid &field, int s, float h)
+{
+    float *line = &lines.points[(size_t)s * lines.maxPoints * 2];
+    float x = lines.seedX[s], y = lines.seedY[s];
+    line[0] = x;
+    line[1] = y;
+    int count = 1;
+    while (count < lines.maxPoints)
+    {
+        float k1x, k1y, k2x, k2y, k3x, k3y, k4x, k4y;
+        if (!flowDirection(field, x, y, k1x, k1y) ||
+            !flowDirection(field, x + 0.5f * h * k1x, y + 0.5f * h * k1y, k2x, k2y) ||
+            !flowDirection(field, x + 0.5f * h * k2x, y + 0.5f * h * k2y, k3x, k3y) ||
+            !flowDirection(field, x + h * k3x, y + h * k3y, k4x, k4y))
+            break;
+        float nextX = x + h / 6.0f * (k1x + 2.0f * k2x + 2.0f * k3x + k4x);
+        float nextY = y + h / 6.0f * (k1y + 2.0f * k2y + 2.0f * k3y + k4y);
+        if (!insideBox(lines, nextX, nextY) || stableFluidSolidAt(field, nextX, nextY))
+            break;
+        x = nextX;
+        y = nextY;
+        line[count * 2] = x;
+        line[count * 2 + 1] = y;
+        count++;
+    }
+    lines.counts[s] = count;
+
+    float *probe = &lines.probes[(size_t)s * FLOW_LINE_PROBES * 2];
+    for (int k = 0; k < FLOW_LINE_PROBES; k++)
+    {
+        int p = probePoint(count, k);
+        sampleStableFluidVelocity(field, line[p * 2], line[p * 2 + 1], probe[k * 2], probe[k * 2 + 1]);
+    }
+    lines.traced[s] = 1;
+}
+
+void traceStreamlines(FlowLines &lines, const StableFluid &field, const FlowLineParams &params, float streamSpeed)
+{
+    PROFILE_ZONE("traceStreamlines");
+    float tolerance = params.reuseTolerance * streamSpeed;
+    std::atomic<int> retraced(0);
+    forEachSeed(lines.seedCount, params.threads, [&](int s)
+                {
+        if (streamlineCurrent(lines, field, s, tolerance))
+            return;
+        traceStreamline(lines, field, s, params.stepSize);
+        retraced++; });
+    lines.retraced = retraced;
+}
+
+void advanceStreaklines(FlowLines &lines, const StableFluid &field, const FlowLineParams &params)
+{
+    PROFILE_ZONE("advanceStreaklines");
+    forEachSeed(lines.seedCount, params.threads, [&](int s)
+                {
+        float *line = &lines.points[(size_t)s * lines.maxPoints * 2];
+
+        // Particles are ordered by age, so the line ends at the first one to
+        // leave the box. One that would enter the obstacle waits a step.
+        int kept = 0;
+        for (; kept < lines.counts[s]; kept++)
+        {
+            float x = line[kept * 2], y = line[kept * 2 + 1];
+            float k1x, k1y, k2x, k2y, k3x, k3y, k4x, k4y;
+            sampleStableFluidVelocity(field, x, y, k1x, k1y);
+            sampleStableFluidVelocity(field, x + 0.5f * k1x, y + 0.5f * k1y, k2x, k2y);
+            sampleStableFluidVelocity(field, x + 0.5f * k2x, y + 0.5f * k2y, k3x, k3y);
+            sampleStableFluidVelocity(field, x + k3x, y + k3y, k4x, k4y);
+            float nextX = x + (k1x + 2.0f * k2x + 2.0f * k3x + k4x) / 6.0f;
+            float nextY = y + (k1y + 2.0f * k2y + 2.0f * k3y + k4y) / 6.0f;
+            if (!insideBox(lines, nextX, nextY))
+                break;
+            if (stableFluidSolidAt(field, nextX, nextY))
+                continue;
+            line[kept * 2] = nextX;
+            line[kept * 2 + 1] = nextY;
+        }
+
+        // Release a new particle at the seed
+        int count = std::min(kept + 1, lines.maxPoints);
+        memmove(line + 2, line, (size_t)(count - 1) * 2 * sizeof(float));
+        line[0] = lines.seedX[s];
+        line[1] = lines.seedY[s];
+        lines.counts[s] = count; });
+    lines.retraced = lines.seedCount;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "memory_tracker.h"
+
+#include <vector>
+
+// Flow lines through the wind tunnel's grid velocity, seeded from a rake of
+// evenly spaced points just inside the inflow edge.
+//
+// Streamlines are RK4 integral curves of the current field, traced in arc
+// length so their point spacing does not depend on the speed. A line is kept
+// from the previous update while the velocity at a few probe points along it
+// has barely changed, so a settled flow costs little more than the checks.
+//
+// Streaklines are the dye a seed would leave: every step each seed releases
+// a particle at its head and all particles are advanced with RK4 in time.
+//
+// Both are computed in parallel over seeds, and each line's points sit in
+// one flat buffer ready to be drawn as a line strip.
+
+struct StableFluid;
+
+enum class FlowLineMode
+{
+    NONE,
+    STREAMLINES,
+    STREAKLINES
+};
+
+struct FlowLineParams
+{
+    int seeds;
+    int maxPoints;        // Per line
+    float stepSize;       // Streamline step in box units
+    float reuseTolerance; // Largest velocity change at a probe, relative to the stream speed, for a line to be kept
+    int threads;          // 0 = one per hardware thread
+};
+
+struct FlowLines
+{
+    int seedCount, maxPoints;
+    float minX, minY, maxX, maxY;
+    TaggedVector<float, MEMORY_FLOW_LINES> seedX, seedY;
+    TaggedVector<float, MEMORY_FLOW_LINES> points;         // x, y pairs; line s starts at point s * maxPoints
+    TaggedVector<int, MEMORY_FLOW_LINES> counts;           // Points in each line
+    TaggedVector<float, MEMORY_FLOW_LINES> probes;         // Streamlines: velocity at the probe points when last traced
+    TaggedVector<unsigned char, MEMORY_FLOW_LINES> traced; // Streamlines: whether the stored line is usable
+    int retraced;                                          // Lines traced by the last update
+};
+
+void initFlowLines(FlowLines &lines, const FlowLineParams &params, float minX, float minY, float maxX, float maxY);
+
+// Drop all lines, e.g. when switching between streamlines and streaklines
+void clearFlowLines(FlowLines &lines);
+
+// Bring the streamlines up to date with the field
+void traceStreamlines(FlowLines &lines, const StableFluid &field, const FlowLineParams &params, float streamSpeed);
+
+// Advance the streaklines by one simulation step of the field
+void advanceStreaklines(FlowLines &lines, const StableFluid &field, const FlowLineParams &params);
@@ -0,0 +1,145 @@
+#include "frame_arena.h"
+#include "memory_tracker.h"
+
+#include <iostream>
+#include <cstdlib>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+static const size_t ARENA_ALIGNMENT = 64;
+static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+static const size_t COMMIT_GRANULARITY = 1024 * 1024;
+
+// Explicit huge pages are pinned in full as soon as they are mapped, so only
+// arenas up to this size use them; larger ones are reserved and filled lazily
+static const size_t EXPLICIT_HUGE_PAGE_LIMIT = 16 * 1024 * 1024;
+
+static size_t roundUp(size_t value, size_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+bool initFrameArena(FrameArena &arena, size_t capacity)
+{
+    arena = FrameArena{};
+    capacity = roundUp(capacity, HUGE_PAGE_SIZE);
+
+#ifdef _WIN32
+    // Large pages need SeLockMemoryPrivilege and must be committed up front
+    SIZE_T largePage = GetLargePageMinimum();
+    if (largePage > 0 && capacity <= EXPLICIT_HUGE_PAGE_LIMIT)
+    {
+        size_t size = roundUp(capacity, largePage);
+        void *memory = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (memory)
+        {
+            arena.base = static_cast<unsigned char *>(memory);
+            arena.capacity = size;
+            arena.committed = size;
+            arena.hugePages = true;
+        }
+    }
+    if (!arena.base)
+    {
+        // Reserve address space only; frameArenaAllocBytes commits as needed
+        void *memory = VirtualAlloc(NULL, capacity, MEM_RESERVE, PAGE_READWRITE);
+        if (!memory)
+        {
+            std::cerr << "ERROR::FRAME_ARENA::RESERVE_FAILED (" << capacity << " bytes)" << std::endl;
+            return false;
+        }
+        arena.base = static_cast<unsigned char *>(memory);
+        arena.capacity = capacity;
+    }
+#else
+    // Explicit huge pages for small arenas, otherwise transparent huge pages
+    // on a normal mapping. The hugetlb mapping must not use MAP_NORESERVE:
+    // without a reservation a page fault on an exhausted pool raises SIGBUS
+    // instead of failing here.
+    void *memory = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (capacity <= EXPLICIT_HUGE_PAGE_LIMIT)
+        memory = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (memory != MAP_FAILED)
+        arena.hugePages = true;
+#endif
+    if (memory == MAP_FAILED)
+    {
+        memory = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (memory == MAP_FAILED)
+        {
+            std::cerr << "ERROR::FRAME_ARENA::RESERVE_FAILED (" << capacity << " bytes)" << std::endl;
+            return false;
+        }
+#ifdef MADV_HUGEPAGE
+        if (madvise(memory, capacity, MADV_HUGEPAGE) == 0)
+            arena.hugePages = true;
+#endif
+    }
+    arena.base = static_cast<unsigned char *>(memory);
+    arena.capacity = capacity;
+    arena.committed = capacity; // Pages are faulted in lazily by the kernel
+#endif
+    return true;
+}
+
+void resetFrameArena(FrameArena &arena)
+{
+    // The tracker sees the last complete frame, so sampling it mid-frame
+    // does not read a freshly reset arena
+    memoryReleased(MEMORY_FRAME_ARENA, arena.lastFrame);
+    memoryAllocated(MEMORY_FRAME_ARENA, arena.used);
+    arena.lastFrame = arena.used;
+    if (arena.used > arena.peak)
+        arena.peak = arena.used;
+    arena.used = 0;
+}
+
+void *frameArenaAllocBytes(FrameArena &arena, size_t bytes)
+{
+    size_t offset = roundUp(arena.used, ARENA_ALIGNMENT);
+    if (offset + bytes > arena.capacity)
+    {
+        std::cerr << "ERROR::FRAME_ARENA::OUT_OF_MEMORY (requested " << bytes << " bytes, "
+                  << arena.capacity - offset << " left)" << std::endl;
+        std::abort();
+    }
+
+#ifdef _WIN32
+    if (offset + bytes > arena.committed)
+    {
+        size_t newCommitted = roundUp(offset + bytes, COMMIT_GRANULARITY);
+        if (newCommitted > arena.capacity)
+            newCommitted = arena.capacity;
+        if (!VirtualAlloc(arena.base + arena.committed, newCommitted - arena.committed, MEM_COMMIT, PAGE_READWRITE))
+        {
+            std::cerr << "ERROR::FRAME_ARENA::COMMIT_FAILED (" << newCommitted << " bytes)" << std::endl;
+            std::abort();
+        }
+        arena.committed = newCommitted;
+    }
+#endif
+
+    arena.used = offset + bytes;
+    return arena.base + offset;
+}
+
+void destroyFrameArena(FrameArena &arena)
+{
+    memoryReleased(MEMORY_FRAME_ARENA, arena.lastFrame);
+    if (arena.base)
+    {
+#ifdef _WIN32
+        VirtualFree(arena.base, 0, MEM_RELEASE);
+#else
+        munmap(arena.base, arena.capacity);
+#endif
+    }
+    arena = FrameArena{};
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+
+// Per-frame bump allocator for vertex scratch memory. A large virtual range is
+// reserved up front and pages are committed lazily (as transparent huge pages
+// where the OS allows it), so vertex counts can grow without stack overflows
+// or per-frame malloc/free. Small arenas, up to 16 MB, use explicit huge pages
+// when available, which are committed in full. Everything allocated is released at once by
+// resetFrameArena() at the start of the next frame.
+struct FrameArena
+{
+    unsigned char *base;
+    size_t capacity;  // Reserved bytes
+    size_t committed; // Bytes backed by memory (Windows commits on demand)
+    size_t used;      // Bytes handed out this frame
+    size_t lastFrame; // Bytes used by the previous frame
+    size_t peak;      // Highest per-frame usage seen
+    bool hugePages;   // Whether the range is backed by large pages
+};
+
+bool initFrameArena(FrameArena &arena, size_t capacity);
+
+// Start a new frame: everything handed out so far becomes invalid
+void resetFrameArena(FrameArena &arena);
+
+// Allocate 64-byte aligned scratch memory valid until the next reset.
+// Running out of reserved space is fatal.
+void *frameArenaAllocBytes(FrameArena &arena, size_t bytes);
+
+template <typename T>
+T *frameArenaAlloc(FrameArena &arena, size_t count)
+{
+    return static_cast<T *>(frameArenaAllocBytes(arena, count * sizeof(T)));
+}
+
+void destroyFrameArena(FrameArena &arena);
@@ -0,0 +1,277 @@
+#include "frame_capture.h"
+#include "memory_tracker.h"
+#include "profiler.h"
+#include "spsc_queue.h"
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#define PIPE_WRITE_MODE "wb"
+#else
+#define PIPE_WRITE_MODE "w"
+#endif
+
+// PBOs in the ring, and how many frames a readback gets before it is mapped
+const int CAPTURE_SLOTS = 4;
+const int CAPTURE_LAG = 2;
+
+struct CaptureSlot
+{
+    unsigned int pbo;
+    GLsync fence;                // Set while the readback is in flight
+    unsigned char *mapped;       // Set while the writer owns the data
+    std::atomic<bool> writing;   // Cleared by the writer when done with mapped
+    unsigned long long frame;    // Capture frame number of the readback
+};
+
+static CaptureSlot slots[CAPTURE_SLOTS];
+static SpscQueue<int, 8> writeQueue; // Slot indices, main -> writer
+static std::atomic<bool> writerRunning(false);
+static std::thread writerThread;
+static FILE *captureFile = NULL;
+static bool capturePipe = false;
+static bool captureActive = false;
+static int captureWidth = 0, captureHeight = 0;
+
+// Main thread statistics
+static unsigned long long capturedFrames = 0, droppedFrames = 0, resizedFrames = 0;
+static unsigned long long nextFrame = 0;
+static double overheadSeconds = 0.0;
+static std::chrono::steady_clock::time_point firstCapture, lastCapture;
+
+// Written by the writer thread, read after it has been joined
+static unsigned long long writtenFrames = 0;
+static bool writeFailed = false;
+
+// RGBA rows (bottom-up, as read from GL) to planar 4:2:0 YUV, full-range
+// BT.601. One pass per pair of output rows produces both luma rows and the
+// chroma row they share, so every pixel is read once.
+static void convertToI420(const unsigned char *rgba, int width, int height, unsigned char *yuv)
+{
+    unsigned char *yPlane = yuv;
+    unsigned char *uPlane = yuv + width * height;
+    unsigned char *vPlane = uPlane + (width / 2) * (height / 2);
+    for (int y = 0; y < height / 2; y++)
+    {
+        const unsigned char *row0 = rgba + (size_t)(height - 1 - 2 * y) * width * 4;
+        const unsigned char *row1 = row0 - (size_t)width * 4;
+        unsigned char *out0 = yPlane + (size_t)(2 * y) * width;
+        unsigned char *out1 = out0 + width;
+        unsigned char *u = uPlane + (size_t)y * (width / 2);
+        unsigned char *v = vPlane + (size_t)y * (width / 2);
+        for (int x = 0; x < width / 2; x++)
+        {
+            const unsigned char *a = row0 + x * 8, *b = row1 + x * 8;
+            out0[2 * x] = (unsigned char)((77 * a[0] + 150 * a[1] + 29 * a[2]) >> 8);
+            out0[2 * x + 1] = (unsigned char)((77 * a[4] + 150 * a[5] + 29 * a[6]) >> 8);
+            out1[2 * x] = (unsigned char)((77 * b[0] + 150 * b[1] + 29 * b[2]) >> 8);
+            out1[2 * x + 1] = (unsigned char)((77 * b[4] + 150 * b[5] + 29 * b[6]) >> 8);
+            int r = a[0] + a[4] + b[0] + b[4];
+            int g = a[1] + a[5] + b[1] + b[5];
+            int bl = a[2] + a[6] + b[2] + b[6];
+            u[x] = (unsigned char)(((-43 * r - 85 * g + 128 * bl) >> 10) + 128);
+            v[x] = (unsigned char)(((128 * r - 107 * g - 21 * bl) >> 10) + 128);
+        }
+    }
+}
+
+static void captureWriter()
+{
+    profilerSetThreadName("capture writer");
+    std::vector<unsigned char> yuv((size_t)captureWidth * captureHeight * 3 / 2);
+    int index;
+    for (;;)
+    {
+        bool running = writerRunning.load(std::memory_order_acquire);
+        bool any = false;
+        while (writeQueue.pop(index))
+        {
+            PROFILE_ZONE("Capture write");
+            any = true;
+            CaptureSlot &slot = slots[index];
+            convertToI420(slot.mapped, captureWidth, captureHeight, yuv.data());
+            slot.writing.store(false, std::memory_order_release);
+            if (!writeFailed)
+            {
+                if (fputs("FRAME\n", captureFile) < 0 || fwrite(yuv.data(), 1, yuv.size(), captureFile) != yuv.size())
+                    writeFailed = true;
+                else
+                    writtenFrames++;
+            }
+        }
+        if (!running)
+            break;
+        if (!any)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+bool initFrameCapture(const char *target, int width, int height, int fps)
+{
+    capturePipe = target[0] == '|';
+    captureFile = capturePipe ? popen(target + 1, PIPE_WRITE_MODE) : fopen(target, "wb");
+    if (!captureFile)
+    {
+        std::cerr << "ERROR::CAPTURE::OUTPUT_NOT_OPENED " << target << std::endl;
+        return false;
+    }
+    captureWidth = width & ~1;
+    captureHeight = height & ~1;
+    fprintf(captureFile, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", captureWidth, captureHeight, fps);
+
+    size_t bytes = (size_t)captureWidth * captureHeight * 4;
+    for (CaptureSlot &slot : slots)
+    {
+        glGenBuffers(1, &slot.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+        trackGlBuffer(slot.pbo, bytes, MEMORY_GL_CAPTURE);
+        slot.fence = 0;
+        slot.mapped = nullptr;
+        slot.writing = false;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    writerRunning = true;
+    writerThread = std::thread(captureWriter);
+    captureActive = true;
+    std::cout << "Capturing " << captureWidth << "x" << captureHeight << " at " << fps << " fps to " << target << std::endl;
+    return true;
+}
+
+// Unmap buffers the writer has finished with
+static void reclaimSlots()
+{
+    for (CaptureSlot &slot : slots)
+    {
+        if (slot.mapped && !slot.writing.load(std::memory_order_acquire))
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            slot.mapped = nullptr;
+        }
+    }
+}
+
+// Hand readbacks to the writer, oldest first. With wait set the GPU is waited
+// on (shutdown); otherwise only readbacks at least CAPTURE_LAG frames old whose
+// fence has already signalled are taken.
+static void submitSlots(bool wait)
+{
+    for (;;)
+    {
+        CaptureSlot *oldest = nullptr;
+        int oldestIndex = 0;
+        for (int i = 0; i < CAPTURE_SLOTS; i++)
+        {
+            if (slots[i].fence && (!oldest || slots[i].frame < oldest->frame))
+            {
+                oldest = &slots[i];
+                oldestIndex = i;
+            }
+        }
+        if (!oldest || (!wait && nextFrame - oldest->frame < CAPTURE_LAG))
+            return;
+        GLenum status = glClientWaitSync(oldest->fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000 : 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            return;
+        glDeleteSync(oldest->fence);
+        oldest->fence = 0;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, oldest->pbo);
+        oldest->mapped = (unsigned char *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (size_t)captureWidth * captureHeight * 4, GL_MAP_READ_BIT);
+        if (!oldest->mapped)
+        {
+            droppedFrames++;
+            continue;
+        }
+        oldest->writing.store(true, std::memory_order_relaxed);
+        while (!writeQueue.push(oldestIndex))
+            std::this_thread::yield(); // Never full: at most CAPTURE_SLOTS entries are outstanding
+    }
+}
+
+void captureFrame(int width, int height)
+{
+    if (!captureActive)
+        return;
+    PROFILE_ZONE("captureFrame");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (capturedFrames + droppedFrames + resizedFrames == 0)
+        firstCapture = start;
+    lastCapture = start;
+
+    reclaimSlots();
+    submitSlots(false);
+
+    if ((width & ~1) != captureWidth || (height & ~1) != captureHeight)
+    {
+        resizedFrames++;
+    }
+    else
+    {
+        CaptureSlot &slot = slots[nextFrame % CAPTURE_SLOTS];
+        if (slot.fence || slot.mapped)
+        {
+            // GPU or writer still holds this buffer
+            droppedFrames++;
+        }
+        else
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+            glReadPixels(0, 0, captureWidth, captureHeight, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+            slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            slot.frame = nextFrame;
+            capturedFrames++;
+        }
+        nextFrame++;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    overheadSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void finishFrameCapture()
+{
+    if (!captureActive)
+        return;
+    submitSlots(true);
+    writerRunning = false;
+    writerThread.join();
+    reclaimSlots();
+    for (CaptureSlot &slot : slots)
+    {
+        if (slot.fence)
+            glDeleteSync(slot.fence);
+        releaseGlBuffer(slot.pbo);
+        glDeleteBuffers(1, &slot.pbo);
+    }
+    if (capturePipe)
+        pclose(captureFile);
+    else
+        fclose(captureFile);
+    captureFile = NULL;
+    captureActive = false;
+
+    unsigned long long calls = capturedFrames + droppedFrames + resizedFrames;
+    double frameSeconds = calls > 1 ? std::chrono::duration<double>(lastCapture - firstCapture).count() / (calls - 1) : 0.0;
+    double overhead = calls > 0 ? overheadSeconds / calls : 0.0;
+    std::cout << "Capture: " << writtenFrames << " frames written, " << droppedFrames << " dropped";
+    if (resizedFrames > 0)
+        std::cout << ", " << resizedFrames << " skipped (window size changed)";
+    std::cout << "; render-thread overhead " << overhead * 1000.0 << " ms per frame";
+    if (frameSeconds > 0.0)
+        std::cout << " (" << overhead / frameSeconds * 100.0 << "% of frame time)";
+    std::cout << std::endl;
+    if (writeFailed)
+        std::cerr << "ERROR::CAPTURE::WRITE_FAILED output closed early" << std::endl;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+// Asynchronous frame capture to Y4M video. Each captured frame is read from
+// the back buffer into one of a ring of pixel buffer objects (the readback is
+// queued on the GPU, nothing waits for it). Two frames later, once its fence
+// has signalled, the buffer is mapped and handed to a writer thread that
+// converts RGBA to 4:2:0 YUV and streams it to a .y4m file or to the stdin of
+// an encoder:
+//
+//   --capture demo.y4m
+//   --capture "|ffmpeg -y -i - -c:v libx264 demo.mp4"
+//
+// If the GPU or the writer falls behind, frames are dropped rather than
+// stalling the render loop, and counted.
+
+// Open the output and create the PBO ring; needs a current context. The
+// frame size is fixed here (rounded down to even for chroma subsampling).
+bool initFrameCapture(const char *target, int width, int height, int fps);
+
+// Call after rendering, before the swap. Frames whose size no longer matches
+// the capture size (window resized) are dropped.
+void captureFrame(int width, int height);
+
+// Flush the frames still in flight, stop the writer and print a summary
+void finishFrameCapture();
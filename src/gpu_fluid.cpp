@@ -0,0 +1,303 @@
+#include "gpu_fluid.h"
+#include "shader_cache.h"
+#include "draw_batch.h"
+#include "memory_tracker.h"
+#include "profiler.h"
+
+#include <vector>
+
+// Transform feedback integrator. Mirrors updateFluidDemo(): respawn at the left
+// edge, advect, push out of the obstacle along the SDF gradient, clamp to the
+// walls, then damp and jitter. Random numbers come from a hash of the particle
+// id and the step counter so nothing but uniforms has to be uploaded.
+static const char *updateVertexShaderSource = R"(
+    #version 330 core
+    layout (location = 0) in vec4 inState;
+
+    uniform vec4 box;            // left, right, bottom, top
+    uniform float streamSpeed;
+    uniform vec2 obstacleCenter;
+    uniform float particleRadius;
+    uniform uint frame;
+    uniform sampler2D sdf;
+    uniform vec4 sdfBounds;      // minX, minY, maxX, maxY
+
+    out vec4 outState;
+
+    uint hash(uint x)
+    {
+        // PCG output permutation
+        uint state = x * 747796405u + 2891336453u;
+        uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+        return (word >> 22u) ^ word;
+    }
+
+    float random01(uint id, uint salt)
+    {
+        return float(hash(hash(id) ^ (frame * 3u + salt))) / 4294967295.0;
+    }
+
+    float sampleSdf(vec2 p)
+    {
+        vec2 uv = (p - sdfBounds.xy) / (sdfBounds.zw - sdfBounds.xy);
+        return texture(sdf, uv).r;
+    }
+
+    void main()
+    {
+        vec2 pos = inState.xy;
+        vec2 vel = inState.zw;
+        uint id = uint(gl_VertexID);
+        float r = particleRadius;
+
+        // Respawn particles that left the tunnel (or were never spawned)
+        if (pos.x - r >= box.y)
+        {
+            pos = vec2(box.x + 0.05, box.z + 0.1 + random01(id, 0u) * (box.w - box.z - 0.2));
+            vel = vec2(streamSpeed, 0.0);
+        }
+
+        pos += vel;
+
+        // Obstacle push-out using the distance field
+        float d = sampleSdf(pos);
+        if (d < r)
+        {
+            vec2 h = (sdfBounds.zw - sdfBounds.xy) / vec2(textureSize(sdf, 0));
+            vec2 grad = vec2(sampleSdf(pos + vec2(h.x, 0.0)) - sampleSdf(pos - vec2(h.x, 0.0)),
+                             sampleSdf(pos + vec2(0.0, h.y)) - sampleSdf(pos - vec2(0.0, h.y)));
+            vec2 n = dot(grad, grad) > 1e-12 ? normalize(grad) : pos - obstacleCenter;
+            if (dot(n, n) > 1e-12)
+            {
+                n = normalize(n);
+                pos += n * (r + 0.01 - d);
+                float flowForce = streamSpeed * 0.5;
+                vel.x += n.y * flowForce;
+                vel.y -= n.x * flowForce;
+                vel.x = max(vel.x, streamSpeed * 0.5);
+            }
+        }
+
+        // Box walls - particles flow through, not bounce
+        if (pos.x - r <= box.x)
+        {
+            pos.x = box.x + r;
+            vel.x = streamSpeed;
+        }
+        if (pos.y - r <= box.z)
+        {
+            pos.y = box.z + r;
+            vel.y = 0.0;
+        }
+        if (pos.y + r >= box.w)
+        {
+            pos.y = box.w - r;
+            vel.y = 0.0;
+        }
+
+        vel *= 0.998;
+        if (streamSpeed > 0.007)
+        {
+            vel += (vec2(random01(id, 1u), random01(id, 2u)) - 0.5) * 0.0003;
+        }
+
+        outState = vec4(pos, vel);
+    }
+)";
+
+// Point sprite renderer, coloured by speed like the CPU path
+static const char *drawVertexShaderSource = R"(
+    #version 330 core
+    layout (location = 0) in vec4 inState;
+
+    uniform mat4 projection;
+    uniform float pointScale;
+    uniform float particleRadius;
+    uniform float streamSpeed;
+
+    out vec3 ourColor;
+
+    void main()
+    {
+        gl_Position = projection * vec4(inState.xy, 0.0, 1.0);
+        gl_PointSize = max(2.0 * particleRadius * pointScale, 1.0);
+        ourColor = length(inState.zw) < streamSpeed * 1.5 ? vec3(0.0, 0.5, 1.0) : vec3(1.0, 0.3, 0.0);
+    }
+)";
+
+static const char *drawFragmentShaderSource = R"(
+    #version 330 core
+    in vec3 ourColor;
+    out vec4 FragColor;
+
+    void main()
+    {
+        vec2 c = gl_PointCoord * 2.0 - 1.0;
+        if (dot(c, c) > 1.0)
+            discard;
+        FragColor = vec4(ourColor, 1.0);
+    }
+)";
+
+bool initGpuFluid(GpuFluid &fluid, int particleCount)
+{
+    fluid = GpuFluid{};
+    fluid.particleCount = particleCount;
+
+    const char *varyings[] = {"outState"};
+    fluid.updateProgram = buildShaderProgram("gpu_fluid_update", updateVertexShaderSource, NULL, varyings, 1);
+    fluid.drawProgram = buildShaderProgram("gpu_fluid_draw", drawVertexShaderSource, drawFragmentShaderSource);
+    if (!fluid.updateProgram || !fluid.drawProgram)
+    {
+        destroyGpuFluid(fluid);
+        return false;
+    }
+
+    // Two state buffers, each with a VAO so either can be the feedback source
+    glGenBuffers(2, fluid.stateVBO);
+    glGenVertexArrays(2, fluid.stateVAO);
+    for (int i = 0; i < 2; i++)
+    {
+        glBindVertexArray(fluid.stateVAO[i]);
+        glBindBuffer(GL_ARRAY_BUFFER, fluid.stateVBO[i]);
+        glBufferData(GL_ARRAY_BUFFER, particleCount * 4 * sizeof(float), NULL, GL_DYNAMIC_COPY);
+        trackGlBuffer(fluid.stateVBO[i], particleCount * 4 * sizeof(float), MEMORY_GL_GPU_FLUID);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)0);
+        glEnableVertexAttribArray(0);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    // Distance field texture, filled by uploadGpuFluidSdf()
+    glGenTextures(1, &fluid.sdfTexture);
+    glBindTexture(GL_TEXTURE_2D, fluid.sdfTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    float farAway = 1000.0f;
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, 1, 1, 0, GL_RED, GL_FLOAT, &farAway);
+    trackGlTexture(fluid.sdfTexture, sizeof(float), MEMORY_GL_GPU_FLUID);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    fluid.sdfMinX = -1.0f;
+    fluid.sdfMinY = -1.0f;
+    fluid.sdfMaxX = 1.0f;
+    fluid.sdfMaxY = 1.0f;
+
+    resetGpuFluid(fluid);
+    fluid.ready = true;
+    return true;
+}
+
+void resetGpuFluid(GpuFluid &fluid)
+{
+    // Park every particle far to the right so the first step spawns it
+    std::vector<float> state(fluid.particleCount * 4, 0.0f);
+    for (int i = 0; i < fluid.particleCount; i++)
+    {
+        state[i * 4] = 1000.0f;
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, fluid.stateVBO[i]);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, state.size() * sizeof(float), state.data());
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    fluid.current = 0;
+    fluid.frame = 0;
+}
+
+void uploadGpuFluidSdf(GpuFluid &fluid, const float *distances, int width, int height,
+                       float minX, float minY, float maxX, float maxY)
+{
+    glBindTexture(GL_TEXTURE_2D, fluid.sdfTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, distances);
+    trackGlTexture(fluid.sdfTexture, (size_t)width * height * sizeof(float), MEMORY_GL_GPU_FLUID);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    fluid.sdfMinX = minX;
+    fluid.sdfMinY = minY;
+    fluid.sdfMaxX = maxX;
+    fluid.sdfMaxY = maxY;
+}
+
+void updateGpuFluid(GpuFluid &fluid, const GpuFluidParams &params)
+{
+    PROFILE_ZONE("updateGpuFluid");
+    if (!fluid.ready)
+        return;
+
+    unsigned int program = fluid.updateProgram;
+    glUseProgram(program);
+    glUniform4f(glGetUniformLocation(program, "box"), params.boxLeft, params.boxRight, params.boxBottom, params.boxTop);
+    glUniform1f(glGetUniformLocation(program, "streamSpeed"), params.streamSpeed);
+    glUniform2f(glGetUniformLocation(program, "obstacleCenter"), params.obstacleX, params.obstacleY);
+    glUniform1f(glGetUniformLocation(program, "particleRadius"), params.particleRadius);
+    glUniform1ui(glGetUniformLocation(program, "frame"), fluid.frame);
+    glUniform4f(glGetUniformLocation(program, "sdfBounds"), fluid.sdfMinX, fluid.sdfMinY, fluid.sdfMaxX, fluid.sdfMaxY);
+    glUniform1i(glGetUniformLocation(program, "sdf"), 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, fluid.sdfTexture);
+
+    // Read from the current buffer, capture into the other one
+    int next = 1 - fluid.current;
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(fluid.stateVAO[fluid.current]);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, fluid.stateVBO[next]);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, fluid.particleCount);
+    glEndTransformFeedback();
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glDisable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    renderStats.drawCalls++;
+    renderStats.stateChanges += 17; // Program, 7 uniforms, 2 texture, 2 VAO, 2 feedback buffer, 2 toggles, active unit
+
+    fluid.current = next;
+    fluid.frame++;
+}
+
+void drawGpuFluid(const GpuFluid &fluid, const GpuFluidParams &params, const float *projection, int viewportHeight)
+{
+    PROFILE_ZONE("drawGpuFluid");
+    if (!fluid.ready)
+        return;
+
+    unsigned int program = fluid.drawProgram;
+    glUseProgram(program);
+    glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, projection);
+    glUniform1f(glGetUniformLocation(program, "pointScale"), viewportHeight * 0.5f);
+    glUniform1f(glGetUniformLocation(program, "particleRadius"), params.particleRadius);
+    glUniform1f(glGetUniformLocation(program, "streamSpeed"), params.streamSpeed);
+
+    glEnable(GL_PROGRAM_POINT_SIZE);
+    glBindVertexArray(fluid.stateVAO[fluid.current]);
+    glDrawArrays(GL_POINTS, 0, fluid.particleCount);
+    glBindVertexArray(0);
+    glDisable(GL_PROGRAM_POINT_SIZE);
+    renderStats.drawCalls++;
+    renderStats.stateChanges += 9; // Program, 4 uniforms, 2 VAO, 2 toggles
+}
+
+void destroyGpuFluid(GpuFluid &fluid)
+{
+    if (fluid.stateVAO[0])
+        glDeleteVertexArrays(2, fluid.stateVAO);
+    if (fluid.stateVBO[0])
+    {
+        releaseGlBuffer(fluid.stateVBO[0]);
+        releaseGlBuffer(fluid.stateVBO[1]);
+        glDeleteBuffers(2, fluid.stateVBO);
+    }
+    if (fluid.sdfTexture)
+    {
+        releaseGlTexture(fluid.sdfTexture);
+        glDeleteTextures(1, &fluid.sdfTexture);
+    }
+    if (fluid.updateProgram)
+        glDeleteProgram(fluid.updateProgram);
+    if (fluid.drawProgram)
+        glDeleteProgram(fluid.drawProgram);
+    fluid = GpuFluid{};
+}
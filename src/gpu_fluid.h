@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// GPU wind tunnel backend: particle state lives in two buffers that are
+// integrated with transform feedback and swapped every step (ping-pong).
+// Only the per-frame spawn/flow parameters are uploaded as uniforms.
+
+// Per-frame parameters shared with the CPU fluid update
+struct GpuFluidParams
+{
+    float boxLeft, boxRight, boxBottom, boxTop;
+    float streamSpeed;
+    float obstacleX, obstacleY;
+    float particleRadius;
+};
+
+struct GpuFluid
+{
+    unsigned int stateVBO[2];   // x, y, vx, vy per particle
+    unsigned int stateVAO[2];   // VAOs reading each state buffer
+    unsigned int updateProgram; // Transform feedback integrator
+    unsigned int drawProgram;   // Point sprite renderer
+    unsigned int sdfTexture;    // Obstacle signed distance field
+    int current;                // Index of the buffer holding the latest state
+    int particleCount;
+    unsigned int frame;         // Step counter, seeds the spawn/jitter hash
+    float sdfMinX, sdfMinY, sdfMaxX, sdfMaxY;
+    bool ready;
+};
+
+// Create buffers, programs and the SDF texture. Returns false (and leaves the
+// backend unusable) if the driver rejects any of the shaders.
+bool initGpuFluid(GpuFluid &fluid, int particleCount);
+
+// Reset all particles to the "needs spawning" state
+void resetGpuFluid(GpuFluid &fluid);
+
+// Upload an obstacle signed distance field covering [minX,maxX] x [minY,maxY]
+void uploadGpuFluidSdf(GpuFluid &fluid, const float *distances, int width, int height,
+                       float minX, float minY, float maxX, float maxY);
+
+// Advance the particles one step on the GPU
+void updateGpuFluid(GpuFluid &fluid, const GpuFluidParams &params);
+
+// Draw the current particle state as round point sprites
+void drawGpuFluid(const GpuFluid &fluid, const GpuFluidParams &params, const float *projection, int viewportHeight);
+
+void destroyGpuFluid(GpuFluid &fluid);
@@ -0,0 +1,196 @@
+#include "kernel_tuner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+// Each variant is timed for at least this long (after one warm-up call) and
+// at most this many calls; the fastest call counts
+const double TUNE_MIN_SECONDS = 0.05;
+const int TUNE_MAX_CALLS = 20;
+
+struct TunedKernel
+{
+    std::string name;
+    std::vector<std::string> variants;
+    std::vector<int> buckets;
+    TunedKernelSetup setup;
+    std::vector<int> choice; // Per bucket, -1 until decided
+};
+
+static std::vector<TunedKernel> kernels;
+static std::map<std::string, std::string> overrides;                  // Kernel name -> variant name
+static std::map<std::string, std::map<std::string, std::string>> cache; // Machine -> "kernel size" -> variant
+static std::string cachePath;
+
+std::string kernelTuningMachine()
+{
+    char brand[49] = {};
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0x80000000);
+    if ((unsigned int)info[0] >= 0x80000004u)
+        for (int i = 0; i < 3; i++)
+            __cpuid((int *)(brand + i * 16), 0x80000002 + i);
+#elif defined(__i386__) || defined(__x86_64__)
+    if (__get_cpuid_max(0x80000000u, NULL) >= 0x80000004u)
+    {
+        unsigned int *words = (unsigned int *)brand;
+        for (int i = 0; i < 3; i++)
+            __get_cpuid(0x80000002u + i, &words[i * 4], &words[i * 4 + 1], &words[i * 4 + 2], &words[i * 4 + 3]);
+    }
+#endif
+    std::string model = brand;
+    model.erase(0, model.find_first_not_of(' '));
+    if (model.empty())
+        model = "unknown CPU";
+    std::ostringstream machine;
+    machine << model << " (" << std::max(1u, std::thread::hardware_concurrency()) << " threads)";
+    return machine.str();
+}
+
+static std::string bucketKey(const TunedKernel &kernel, int bucket)
+{
+    return kernel.name + " " + std::to_string(kernel.buckets[bucket]);
+}
+
+int registerTunedKernel(const char *name, const std::vector<std::string> &variants, const std::vector<int> &buckets,
+                        const TunedKernelSetup &setup)
+{
+    TunedKernel kernel;
+    kernel.name = name;
+    kernel.variants = variants;
+    kernel.buckets = buckets;
+    kernel.setup = setup;
+    kernel.choice.assign(buckets.size(), -1);
+
+    // Adopt cached decisions for this machine
+    const std::map<std::string, std::string> &decisions = cache[kernelTuningMachine()];
+    for (size_t b = 0; b < buckets.size(); b++)
+    {
+        auto decision = decisions.find(bucketKey(kernel, (int)b));
+        if (decision == decisions.end())
+            continue;
+        auto variant = std::find(variants.begin(), variants.end(), decision->second);
+        if (variant != variants.end())
+            kernel.choice[b] = (int)(variant - variants.begin());
+    }
+    kernels.push_back(kernel);
+    return (int)kernels.size() - 1;
+}
+
+bool overrideTunedKernel(const char *spec)
+{
+    const char *equals = strchr(spec, '=');
+    if (!equals || equals == spec || !equals[1])
+        return false;
+    overrides[std::string(spec, equals - spec)] = equals + 1;
+    return true;
+}
+
+void loadKernelTuning(const char *path)
+{
+    cachePath = path;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        // machine <tab> kernel size <tab> variant
+        size_t first = line.find('\t'), second = line.find('\t', first + 1);
+        if (line.empty() || line[0] == '#' || second == std::string::npos)
+            continue;
+        cache[line.substr(0, first)][line.substr(first + 1, second - first - 1)] = line.substr(second + 1);
+    }
+}
+
+void saveKernelTuning(const char *path)
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cerr << "ERROR::KERNEL_TUNER::CANNOT_WRITE " << path << std::endl;
+        return;
+    }
+    file << "# Fastest kernel variants per machine, written by the kernel tuner" << std::endl;
+    for (const auto &machine : cache)
+        for (const auto &decision : machine.second)
+            file << machine.first << '\t' << decision.first << '\t' << decision.second << std::endl;
+}
+
+// Time every variant of one bucket and record the fastest
+static void calibrateBucket(TunedKernel &kernel, int bucket)
+{
+    typedef std::chrono::steady_clock Clock;
+    int size = kernel.buckets[bucket];
+    int best = 0;
+    double bestSeconds = 1e30;
+    std::ostringstream report;
+    for (size_t v = 0; v < kernel.variants.size(); v++)
+    {
+        std::function<void()> call = kernel.setup((int)v, size);
+        call();
+        double fastest = 1e30, total = 0.0;
+        for (int calls = 0; calls < TUNE_MAX_CALLS && (calls < 3 || total < TUNE_MIN_SECONDS); calls++)
+        {
+            Clock::time_point start = Clock::now();
+            call();
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            fastest = std::min(fastest, seconds);
+            total += seconds;
+        }
+        report << (v ? ", " : "") << kernel.variants[v] << " " << fastest * 1000.0 << " ms";
+        if (fastest < bestSeconds)
+        {
+            bestSeconds = fastest;
+            best = (int)v;
+        }
+    }
+    kernel.choice[bucket] = best;
+    cache[kernelTuningMachine()][bucketKey(kernel, bucket)] = kernel.variants[best];
+    std::cout << "Kernel '" << kernel.name << "' at " << size << ": " << kernel.variants[best] << " (" << report.str() << ")" << std::endl;
+}
+
+int selectTunedVariant(int kernelIndex, int size)
+{
+    TunedKernel &kernel = kernels[kernelIndex];
+    auto pinned = overrides.find(kernel.name);
+    if (pinned != overrides.end())
+    {
+        auto variant = std::find(kernel.variants.begin(), kernel.variants.end(), pinned->second);
+        if (variant != kernel.variants.end())
+            return (int)(variant - kernel.variants.begin());
+        std::cerr << "Unknown variant " << pinned->second << " for kernel " << kernel.name << ", tuning instead" << std::endl;
+        overrides.erase(pinned);
+    }
+
+    int bucket = 0;
+    while (bucket + 1 < (int)kernel.buckets.size() && kernel.buckets[bucket] < size)
+        bucket++;
+    if (kernel.choice[bucket] < 0)
+    {
+        calibrateBucket(kernel, bucket);
+        if (!cachePath.empty())
+            saveKernelTuning(cachePath.c_str());
+    }
+    return kernel.choice[bucket];
+}
+
+void calibrateTunedKernels()
+{
+    for (TunedKernel &kernel : kernels)
+        for (size_t b = 0; b < kernel.buckets.size(); b++)
+            calibrateBucket(kernel, (int)b);
+    if (!cachePath.empty())
+        saveKernelTuning(cachePath.c_str());
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Runtime selection between interchangeable implementations of a hot path
+// (serial or threaded, CPU or GPU, ...). Each kernel registers its variants
+// and the problem sizes it is tuned at; the first time a choice is needed for
+// a size bucket every variant is timed on that size and the fastest is kept.
+// Decisions are cached on disk per CPU model and thread count, so the
+// benchmark only runs once per machine, and any kernel can be pinned to a
+// variant from the command line.
+
+// Build a variant's input for a problem size and return one call of it; the
+// registry times the returned callable, not the setup
+typedef std::function<std::function<void()>(int variant, int size)> TunedKernelSetup;
+
+// Register a kernel; buckets are the benchmarked sizes in increasing order.
+// Returns the kernel's handle.
+int registerTunedKernel(const char *name, const std::vector<std::string> &variants, const std::vector<int> &buckets,
+                        const TunedKernelSetup &setup);
+
+// Pin a kernel to a variant, as "name=variant"; may come before the kernel is
+// registered. Returns false if the spec is malformed.
+bool overrideTunedKernel(const char *spec);
+
+// Read and write the decision cache; decisions for other machines are kept.
+// Load before registering kernels, which adopt this machine's decisions; new
+// decisions are written back to the loaded path.
+void loadKernelTuning(const char *path);
+void saveKernelTuning(const char *path);
+
+// Variant to use for a problem of this size: the bucket is the first one at
+// least as large (or the largest). Benchmarks the bucket if it has no cached
+// decision, so call this at setup time rather than every step.
+int selectTunedVariant(int kernel, int size);
+
+// Re-benchmark every bucket of every kernel, replacing cached decisions
+void calibrateTunedKernels();
+
+// CPU brand string and hardware thread count, the key of cached decisions
+std::string kernelTuningMachine();
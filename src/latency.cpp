@@ -0,0 +1,144 @@
+#include "latency.h"
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+// Frames whose timestamp can be in flight at once; more than this and the
+// inputs of the newest frame are not measured
+const int LATENCY_QUERY_POOL = 16;
+
+// Seconds between re-reads of the GPU clock offset
+const double LATENCY_CALIBRATION_INTERVAL = 1.0;
+
+struct LatencyFrame
+{
+    unsigned int query;
+    bool inFlight;
+    std::vector<double> inputs; // Arrival times of the inputs this frame reflects
+};
+
+static LatencyFrame frames[LATENCY_QUERY_POOL];
+static int frameHead = 0, frameTail = 0; // Oldest in flight, next free
+static std::vector<double> frameInputs;  // Applied since the last present
+static std::vector<double> stepLatencies, presentLatencies;
+static int droppedInputs = 0;
+static bool trackerReady = false;
+
+// glfwGetTime() minus the GPU timestamp clock, in seconds
+static double gpuClockOffset = 0.0;
+static double lastCalibration = 0.0;
+
+static void calibrateGpuClock()
+{
+    GLint64 gpuTime = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+    lastCalibration = glfwGetTime();
+    gpuClockOffset = lastCalibration - gpuTime * 1e-9;
+}
+
+void initLatencyTracker()
+{
+    for (LatencyFrame &frame : frames)
+    {
+        glGenQueries(1, &frame.query);
+        frame.inFlight = false;
+    }
+    calibrateGpuClock();
+    trackerReady = true;
+}
+
+void recordInputApplied(double issuedAt, double appliedAt)
+{
+    stepLatencies.push_back(appliedAt - issuedAt);
+    frameInputs.push_back(issuedAt);
+}
+
+void markFramePresented()
+{
+    if (frameInputs.empty() || !trackerReady)
+        return;
+    LatencyFrame &frame = frames[frameTail];
+    if (frame.inFlight)
+    {
+        droppedInputs += (int)frameInputs.size();
+        frameInputs.clear();
+        return;
+    }
+    glQueryCounter(frame.query, GL_TIMESTAMP);
+    frame.inputs.swap(frameInputs);
+    frameInputs.clear();
+    frame.inFlight = true;
+    frameTail = (frameTail + 1) % LATENCY_QUERY_POOL;
+}
+
+void pollLatencyQueries()
+{
+    if (!trackerReady)
+        return;
+    if (glfwGetTime() - lastCalibration > LATENCY_CALIBRATION_INTERVAL)
+        calibrateGpuClock();
+
+    // Queries complete in submission order, so stop at the first pending one
+    while (frames[frameHead].inFlight)
+    {
+        LatencyFrame &frame = frames[frameHead];
+        GLint available = 0;
+        glGetQueryObjectiv(frame.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+        GLuint64 gpuTime = 0;
+        glGetQueryObjectui64v(frame.query, GL_QUERY_RESULT, &gpuTime);
+        double presentedAt = gpuTime * 1e-9 + gpuClockOffset;
+        for (double issuedAt : frame.inputs)
+            presentLatencies.push_back(presentedAt - issuedAt);
+        frame.inputs.clear();
+        frame.inFlight = false;
+        frameHead = (frameHead + 1) % LATENCY_QUERY_POOL;
+    }
+}
+
+// Nearest-rank percentile of sorted values
+static double percentile(const std::vector<double> &sorted, double p)
+{
+    size_t rank = (size_t)(p / 100.0 * sorted.size() + 0.5);
+    rank = std::min(std::max(rank, (size_t)1), sorted.size());
+    return sorted[rank - 1];
+}
+
+static void printPercentiles(const char *label, std::vector<double> values)
+{
+    if (values.empty())
+        return;
+    std::sort(values.begin(), values.end());
+    printf("%s latency: p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms over %zu inputs\n", label,
+           percentile(values, 50.0) * 1000.0, percentile(values, 90.0) * 1000.0,
+           percentile(values, 99.0) * 1000.0, values.back() * 1000.0, values.size());
+}
+
+void printLatencyReport()
+{
+    if (trackerReady)
+    {
+        // Let the last frames' timestamps land
+        glFinish();
+        pollLatencyQueries();
+    }
+    printPercentiles("Input-to-step", stepLatencies);
+    printPercentiles("Input-to-present", presentLatencies);
+    if (droppedInputs > 0)
+        std::cout << "(" << droppedInputs << " inputs not timed, too many frames in flight)" << std::endl;
+}
+
+void destroyLatencyTracker()
+{
+    if (!trackerReady)
+        return;
+    for (LatencyFrame &frame : frames)
+        glDeleteQueries(1, &frame.query);
+    trackerReady = false;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+// Input-to-photon latency. Every live input is timestamped on arrival
+// (glfwGetTime); when its command is applied the arrival time is attached to
+// the frame being built. Right after that frame's swap a GL_TIMESTAMP query is
+// issued, and once the GPU has passed it (polled without blocking on later
+// frames) the query time is converted to the CPU clock. That is when the GPU
+// finished the frame; scanout of a vsynced swap chain can add up to one more
+// refresh interval. Percentiles are reported on exit.
+
+// Create the query pool and calibrate the GPU clock; needs a current context
+void initLatencyTracker();
+
+// A command issued at issuedAt was applied at appliedAt, before this frame's update
+void recordInputApplied(double issuedAt, double appliedAt);
+
+// Call right after the swap of a rendered frame
+void markFramePresented();
+
+// Collect finished queries; never waits for the GPU
+void pollLatencyQueries();
+
+// Print input-to-step and input-to-present percentiles
+void printLatencyReport();
+
+void destroyLatencyTracker();
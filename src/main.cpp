@@ -6,6 +6,30 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <cstdlib>
 #include <ctime>
+#include <cstring>
+#include <cctype>
+#include "gpu_fluid.h"
+#include "frame_arena.h"
+#include "spsc_queue.h"
+#include "shader_cache.h"
+#include "simulation.h"
+#include "sweep.h"
+#include "telemetry.h"
+#include "profiler.h"
+#include "circle_lod.h"
+#include "retained_scene.h"
+#include "draw_batch.h"
+#include "latency.h"
+#include "frame_capture.h"
+#include "flow_lines.h"
+#include "kernel_tuner.h"
+#include "cpu_dispatch.h"
+#include "memory_tracker.h"
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include <utility>
 
 // Screen states
 enum class Screen
@@ -44,27 +68,33 @@ Button backButton = {-0.95f, 0.85f, 0.3f, 0.12f, glm::vec3(0.2f, 0.2f, 0.2f), "B
 int windowWidth = 800;
 int windowHeight = 600;
 
-// Mouse position
-double mouseX = 0.0;
-double mouseY = 0.0;
+// Damage tracking: set whenever the next frame must be drawn regardless of
+// whether the simulation moved (input, resize, window exposure)
+bool sceneDirty = true;
 
-// Ball physics properties
-struct Ball
+// Static UI geometry, built once into one shared buffer
+enum UiItem
 {
-    float x, y;
-    float vx, vy;
-    float radius;
-    glm::vec3 color;
+    UI_MENU_BUTTONS,
+    UI_BACK_BUTTON,
+    UI_BOX_WALLS,
+    UI_BALL_COUNT_BUTTONS,
+    UI_MASS_BUTTONS,
+    UI_RESET_BUTTON,
+    UI_SHAPE_BUTTONS,
+    UI_OBSTACLE,
+    UI_ITEM_COUNT
 };
+RetainedScene uiScene;
+DrawBatch drawBatch;
+bool paused = false;
 
-// Ball initialization function prototype
-void initBalls(int count);
-
-// Square mass initialization function prototype
-void initSquareMasses(float massRatio);
+// How long to sleep between steps of a running demo whose state has settled
+const double IDLE_WAIT_TIMEOUT = 0.25;
 
-// Reset blue squares to initial state
-void resetSquares();
+// Mouse position
+double mouseX = 0.0;
+double mouseY = 0.0;
 
 // Ball count selection buttons for red demo
 struct BallCountButton
@@ -103,16 +133,6 @@ struct ResetButton
 
 ResetButton resetButton = {-0.9f, 0.75f, 0.5f, 0.08f, "Reset"};
 
-// Fluid flow parameters
-struct FluidParticle
-{
-    float x, y;
-    float vx, vy;
-    float radius;
-    glm::vec3 color;
-    bool active;
-};
-
 // Speed control buttons for fluid demo
 struct SpeedButton
 {
@@ -127,14 +147,6 @@ SpeedButton speedButtons[] = {
     {0.5f, 0.6f, 0.5f, 0.08f, 0.01f, "Fast"}};
 const int NUM_SPEED_BUTTONS = 3;
 
-// Shape types for aerodynamics demo
-enum class ObstacleShape
-{
-    BALL,
-    TRIANGLE,
-    AIRFOIL
-};
-
 // Shape selection buttons
 struct ShapeButton
 {
@@ -149,75 +161,43 @@ ShapeButton shapeButtons[] = {
     {0.5f, 0.75f, 0.5f, 0.08f, ObstacleShape::AIRFOIL, "Airfoil"}};
 const int NUM_SHAPE_BUTTONS = 3;
 
-// Ball array and count
-const int MAX_BALLS = 50;
-Ball balls[MAX_BALLS];
-int NUM_BALLS = 5;
-
-// Square physics properties
-struct Square
-{
-    float x, y;
-    float vx, vy;
-    float size;
-    float mass;
-    glm::vec3 color;
-};
-
-Square square = {0.0f, 0.0f, 0.004f, 0.0f, 0.1f, 1.0f, glm::vec3(0.0f, 0.0f, 1.0f)};
-Square square2 = {0.3f, 0.0f, -0.003f, 0.0f, 0.1f, 1.0f, glm::vec3(0.0f, 0.0f, 1.0f)};
-
-const int NUM_SQUARES = 2;
-Square squares[NUM_SQUARES] = {square, square2};
-
-// Newton's Cradle structures
-struct Pendulum
-{
-    float x, y;       // Current position
-    float angle;      // Current angle (radians)
-    float angularVel; // Angular velocity
-    float length;     // Length of pendulum string
-    float mass;       // Mass of the bob
-    float radius;     // Radius of the bob
-    glm::vec3 color;  // Color of the bob
-    bool isDragging;  // Whether this pendulum is being dragged
-};
-
-// Newton's Cradle parameters
-const int NUM_PENDULUMS = 5;
-Pendulum pendulums[NUM_PENDULUMS];
-const float PENDULUM_LENGTH = 0.8f;
-const float PENDULUM_SPACING = 0.12f;
-const float PENDULUM_RADIUS = 0.05f;
-const float PENDULUM_MASS = 1.0f;
-const float GRAVITY = 0.001f;
-const float DAMPING = 0.999f;
-const float COLLISION_DISTANCE = PENDULUM_RADIUS * 2.0f;
-
-// Newton's Cradle initialization function prototype
-void initNewtonsCradle();
-
-// Newton's Cradle update function prototype
-void updateNewtonsCradle();
-
-// Newton's Cradle reset function prototype
-void resetNewtonsCradle();
-
-// Box boundaries
-const float BOX_LEFT = -0.8f;
-const float BOX_RIGHT = 0.8f;
-const float BOX_TOP = 0.6f;
-const float BOX_BOTTOM = -0.6f;
-
-// Fluid demo parameters
-const int MAX_FLUID_PARTICLES = 200;
-FluidParticle fluidParticles[MAX_FLUID_PARTICLES];
-int NUM_FLUID_PARTICLES = 0;
-float streamSpeed = 0.005f;
-float obstacleX = 0.0f;
-float obstacleY = 0.0f;
-float obstacleRadius = 0.15f;
-ObstacleShape currentShape = ObstacleShape::BALL;
+// One simulation instance per demo
+BallSim redSim;
+SquareSim blueSim;
+CradleSim greenSim;
+FluidSim yellowSim;
+
+// GPU wind tunnel backend (enabled with --gpu-fluid)
+bool useGpuFluid = false;
+GpuFluid gpuFluid;
+
+// Eulerian grid backend (enabled with --stable-fluid [cells across]); the
+// particles become tracers of its flow and its vorticity is drawn underneath
+const int STABLE_FLUID_DEFAULT_WIDTH = 512;
+const int STABLE_FLUID_OVERLAY_BLOCK = 8;          // Grid cells per overlay quad side
+const float STABLE_FLUID_VORTICITY_SCALE = 0.2f;   // Vorticity drawn at full colour
+bool useStableFluid = false;
+int stableFluidWidth = STABLE_FLUID_DEFAULT_WIDTH;
+StableFluid stableFluid;
+
+// Streamlines or streaklines through the grid flow (L key with --stable-fluid;
+// --flow-lines N sets the number of seeds)
+const int FLOW_LINE_DEFAULT_SEEDS = 1000;
+const int FLOW_LINE_MAX_POINTS = 384;
+const float FLOW_LINE_STEP_CELLS = 2.0f;      // Streamline step in grid cells
+const float FLOW_LINE_REUSE_TOLERANCE = 0.02f;
+FlowLineMode flowLineMode = FlowLineMode::NONE;
+FlowLineParams flowLineParams = {FLOW_LINE_DEFAULT_SEEDS, FLOW_LINE_MAX_POINTS, 0.0f, FLOW_LINE_REUSE_TOLERANCE, 0};
+FlowLines flowLines;
+
+// Scratch memory for vertex data, reset at the start of every frame
+const size_t FRAME_ARENA_CAPACITY = 512 * 1024 * 1024;
+FrameArena frameArena;
+
+// Obstacle distance field sampled over the box for the GPU and grid backends
+const int OBSTACLE_SDF_WIDTH = 256;
+const int OBSTACLE_SDF_HEIGHT = 192;
+float obstacleSdf[OBSTACLE_SDF_WIDTH * OBSTACLE_SDF_HEIGHT];
 
 // Vertex Shader source code
 const char *vertexShaderSource = R"(
@@ -249,6 +229,96 @@ const char *fragmentShaderSource = R"(
     }
 )";
 
+// UI actions. Input callbacks only queue commands; the simulation applies
+// them between steps, so input timing is deterministic and can be replayed.
+enum class CommandType
+{
+    SET_SCREEN,     // value = Screen
+    SET_BALL_COUNT, // value = ball count
+    SET_MASS_RATIO, // x = mass ratio
+    RESET_CRADLE,
+    PULL_PENDULUM, // x, y = click position
+    SET_SHAPE,     // value = ObstacleShape
+    TOGGLE_PAUSE,
+    TOGGLE_GRAVITY, // N-body mode on or off
+    SET_FLOW_LINES, // value = FlowLineMode
+    ADJUST_ANGLE_OF_ATTACK // x = change of the airfoil angle of attack in radians
+};
+
+struct Command
+{
+    CommandType type;
+    int value;
+    float x, y;
+    double issuedAt; // glfwGetTime() when the input arrived
+};
+
+// Input thread -> simulation command queue
+SpscQueue<Command, 256> commandQueue;
+
+// Number of simulation steps taken so far; commands apply at step boundaries
+unsigned long long simulationStep = 0;
+
+// Red demo N-body mode (G key, or --nbody N to start in it)
+const int NBODY_DEFAULT_COUNT = 20000;
+int nbodyCount = NBODY_DEFAULT_COUNT;
+float nbodyOpeningAngle = NBODY_OPENING_ANGLE;
+
+// Airfoil profile (--naca XXXX, default 0040) and angle of attack (--angle-of-attack D,
+// changed with the Up/Down keys on the airfoil)
+const char *nacaDesignation = NULL;
+float angleOfAttackDegrees = 0.0f;
+const float AIRFOIL_ANGLE_STEP_DEGREES = 2.0f;
+const float AIRFOIL_MAX_ANGLE_DEGREES = 30.0f;
+
+// Imported obstacle outline (--obstacle FILE), selected with the O key
+const char *obstaclePath = NULL;
+ObstaclePolygon obstaclePolygon;
+
+// Further wind tunnel obstacles (--obstacles FILE); the deque keeps the
+// layout's outlines at stable addresses
+const char *obstacleLayoutPath = NULL;
+std::deque<ObstaclePolygon> layoutPolygons;
+
+// Kernel variants picked per machine and problem size (--kernel name=variant
+// pins one, --tune re-benchmarks all); decisions are cached in this file
+const char *KERNEL_TUNING_PATH = "kernel_tuning.txt";
+enum
+{
+    KERNEL_SERIAL,
+    KERNEL_THREADED
+};
+int nbodyKernel = -1;
+int stableFluidKernel = -1;
+
+// Low-latency mode (--low-latency): poll input right before the step instead
+// of after the swap, and wait for the GPU after every swap so no frames queue up
+bool lowLatency = false;
+
+// Input recording/replay (--record-input / --replay-input)
+FILE *inputRecordFile = NULL;
+std::vector<std::pair<unsigned long long, Command>> replayCommands;
+size_t replayIndex = 0;
+
+// Conservation monitor: next recorded sample starts a new drift baseline
+bool telemetryRestart = true;
+
+// Window title HUD: conservation readout of the running demo (kept while
+// paused) and memory use per subsystem
+double hudTime = 0.0;
+const double HUD_INTERVAL = 0.25; // Seconds between window title updates
+char conservationHud[256] = "";
+
+// Queue a UI action for the next step boundary
+void pushCommand(CommandType type, int value = 0, float x = 0.0f, float y = 0.0f)
+{
+    Command command = {type, value, x, y, glfwGetTime()};
+    if (!commandQueue.push(command))
+    {
+        std::cerr << "Command queue full, dropping input" << std::endl;
+    }
+}
+
 // Error callback for GLFW
 void errorCallback(int error, const char *description)
 {
@@ -256,22 +326,64 @@ void errorCallback(int error, const char *description)
 }
 
 // Window resize callback
-void framebufferSizeCallback(GLFWwindow *window, int width, int height)
+void framebufferSizeCallback(GLFWwindow * /*window*/, int width, int height)
 {
     windowWidth = width;
     windowHeight = height;
     glViewport(0, 0, width, height);
+    sceneDirty = true;
+    invalidateRetainedScene(uiScene); // Circle LOD follows the window size
+}
+
+// Window contents were damaged by the system (uncovered, restored)
+void windowRefreshCallback(GLFWwindow * /*window*/)
+{
+    sceneDirty = true;
+}
+
+// Key callback for toggles
+void keyCallback(GLFWwindow * /*window*/, int key, int /*scancode*/, int action, int /*mods*/)
+{
+    if (key == GLFW_KEY_P && action == GLFW_PRESS)
+    {
+        pushCommand(CommandType::TOGGLE_PAUSE);
+    }
+    else if (key == GLFW_KEY_G && action == GLFW_PRESS && currentScreen == Screen::RED_DEMO)
+    {
+        pushCommand(CommandType::TOGGLE_GRAVITY);
+    }
+    else if ((key == GLFW_KEY_UP || key == GLFW_KEY_DOWN) && action != GLFW_RELEASE && currentScreen == Screen::YELLOW_DEMO &&
+             yellowSim.shape == ObstacleShape::AIRFOIL)
+    {
+        float step = glm::radians(AIRFOIL_ANGLE_STEP_DEGREES) * (key == GLFW_KEY_UP ? 1.0f : -1.0f);
+        pushCommand(CommandType::ADJUST_ANGLE_OF_ATTACK, 0, step);
+    }
+    else if (key == GLFW_KEY_L && action == GLFW_PRESS && currentScreen == Screen::YELLOW_DEMO && useStableFluid)
+    {
+        // Cycle off -> streamlines -> streaklines
+        pushCommand(CommandType::SET_FLOW_LINES, ((int)flowLineMode + 1) % 3);
+    }
+    else if (key == GLFW_KEY_O && action == GLFW_PRESS && currentScreen == Screen::YELLOW_DEMO && yellowSim.polygon)
+    {
+        pushCommand(CommandType::SET_SHAPE, (int)ObstacleShape::POLYGON);
+    }
 }
 
 // Mouse position callback
-void mouseCallback(GLFWwindow *window, double xpos, double ypos)
+void mouseCallback(GLFWwindow * /*window*/, double xpos, double ypos)
 {
     mouseX = xpos;
     mouseY = ypos;
 }
 
-// Mouse button callback
-void mouseButtonCallback(GLFWwindow *window, int button, int action, int mods)
+// Hit test for the axis-aligned UI rectangles
+bool insideRect(float px, float py, float x, float y, float width, float height)
+{
+    return px >= x && px <= x + width && py >= y && py <= y + height;
+}
+
+// Mouse button callback: hit-tests the UI and queues the resulting command
+void mouseButtonCallback(GLFWwindow * /*window*/, int button, int action, int /*mods*/)
 {
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
     {
@@ -282,50 +394,38 @@ void mouseButtonCallback(GLFWwindow *window, int button, int action, int mods)
         if (currentScreen == Screen::MAIN_MENU)
         {
             // Check if any main menu button was clicked
+            const Screen demoScreens[NUM_BUTTONS] = {Screen::RED_DEMO, Screen::BLUE_DEMO, Screen::GREEN_DEMO, Screen::YELLOW_DEMO};
             for (int i = 0; i < NUM_BUTTONS; i++)
             {
-                if (normalizedX >= buttons[i].x && normalizedX <= buttons[i].x + buttons[i].width &&
-                    normalizedY >= buttons[i].y && normalizedY <= buttons[i].y + buttons[i].height)
+                if (insideRect(normalizedX, normalizedY, buttons[i].x, buttons[i].y, buttons[i].width, buttons[i].height))
                 {
                     // Navigate to corresponding demo
-                    switch (i)
-                    {
-                    case 0:
-                        currentScreen = Screen::RED_DEMO;
-                        break;
-                    case 1:
-                        currentScreen = Screen::BLUE_DEMO;
-                        break;
-                    case 2:
-                        currentScreen = Screen::GREEN_DEMO;
-                        break;
-                    case 3:
-                        currentScreen = Screen::YELLOW_DEMO;
-                        break;
-                    }
+                    pushCommand(CommandType::SET_SCREEN, (int)demoScreens[i]);
                     break;
                 }
             }
+            return;
         }
-        else if (currentScreen == Screen::RED_DEMO)
+
+        // Back button is shared by all demo screens
+        if (insideRect(normalizedX, normalizedY, backButton.x, backButton.y, backButton.width, backButton.height))
+        {
+            pushCommand(CommandType::SET_SCREEN, (int)Screen::MAIN_MENU);
+            return;
+        }
+
+        if (currentScreen == Screen::RED_DEMO)
         {
             // Check if a ball count button was clicked
             for (int i = 0; i < NUM_BALL_COUNT_BUTTONS; i++)
             {
                 BallCountButton &b = ballCountButtons[i];
-                if (normalizedX >= b.x && normalizedX <= b.x + b.width &&
-                    normalizedY >= b.y && normalizedY <= b.y + b.height)
+                if (insideRect(normalizedX, normalizedY, b.x, b.y, b.width, b.height))
                 {
-                    initBalls(b.count);
+                    pushCommand(CommandType::SET_BALL_COUNT, b.count);
                     return;
                 }
             }
-            // Check if back button was clicked
-            if (normalizedX >= backButton.x && normalizedX <= backButton.x + backButton.width &&
-                normalizedY >= backButton.y && normalizedY <= backButton.y + backButton.height)
-            {
-                currentScreen = Screen::MAIN_MENU;
-            }
         }
         else if (currentScreen == Screen::BLUE_DEMO)
         {
@@ -333,59 +433,24 @@ void mouseButtonCallback(GLFWwindow *window, int button, int action, int mods)
             for (int i = 0; i < NUM_MASS_BUTTONS; i++)
             {
                 MassButton &b = massButtons[i];
-                if (normalizedX >= b.x && normalizedX <= b.x + b.width &&
-                    normalizedY >= b.y && normalizedY <= b.y + b.height)
+                if (insideRect(normalizedX, normalizedY, b.x, b.y, b.width, b.height))
                 {
-                    initSquareMasses(b.massRatio);
-                    resetSquares();
+                    pushCommand(CommandType::SET_MASS_RATIO, 0, b.massRatio);
                     return;
                 }
             }
-            // Check if back button was clicked
-            if (normalizedX >= backButton.x && normalizedX <= backButton.x + backButton.width &&
-                normalizedY >= backButton.y && normalizedY <= backButton.y + backButton.height)
-            {
-                currentScreen = Screen::MAIN_MENU;
-            }
         }
         else if (currentScreen == Screen::GREEN_DEMO)
         {
             // Check if reset button was clicked
-            if (normalizedX >= resetButton.x && normalizedX <= resetButton.x + resetButton.width &&
-                normalizedY >= resetButton.y && normalizedY <= resetButton.y + resetButton.height)
+            if (insideRect(normalizedX, normalizedY, resetButton.x, resetButton.y, resetButton.width, resetButton.height))
             {
-                resetNewtonsCradle();
+                pushCommand(CommandType::RESET_CRADLE);
                 return;
             }
-            // Check if back button was clicked
-            if (normalizedX >= backButton.x && normalizedX <= backButton.x + backButton.width &&
-                normalizedY >= backButton.y && normalizedY <= backButton.y + backButton.height)
-            {
-                currentScreen = Screen::MAIN_MENU;
-            }
-            else
-            {
-                // Check if clicking on any pendulum to pull it and all balls to its left back
-                for (int i = 0; i < NUM_PENDULUMS; i++)
-                {
-                    float bobX = pendulums[i].x + pendulums[i].length * sin(pendulums[i].angle);
-                    float bobY = pendulums[i].y - pendulums[i].length * cos(pendulums[i].angle);
-
-                    float clickDistance = sqrt((normalizedX - bobX) * (normalizedX - bobX) +
-                                               (normalizedY - bobY) * (normalizedY - bobY));
-
-                    if (clickDistance < pendulums[i].radius * 2.0f)
-                    {
-                        // Pull back this pendulum and all pendulums to its left
-                        for (int j = 0; j <= i; j++)
-                        {
-                            pendulums[j].angle = -0.5f;     // Pull back about 30 degrees
-                            pendulums[j].angularVel = 0.0f; // Reset velocity
-                        }
-                        break; // Exit the loop after finding the clicked ball
-                    }
-                }
-            }
+            // Clicks elsewhere may grab a bob; resolved against the pendulum
+            // positions when the command is applied
+            pushCommand(CommandType::PULL_PENDULUM, 0, normalizedX, normalizedY);
         }
         else if (currentScreen == Screen::YELLOW_DEMO)
         {
@@ -393,28 +458,12 @@ void mouseButtonCallback(GLFWwindow *window, int button, int action, int mods)
             for (int i = 0; i < NUM_SHAPE_BUTTONS; i++)
             {
                 ShapeButton &b = shapeButtons[i];
-                if (normalizedX >= b.x && normalizedX <= b.x + b.width &&
-                    normalizedY >= b.y && normalizedY <= b.y + b.height)
+                if (insideRect(normalizedX, normalizedY, b.x, b.y, b.width, b.height))
                 {
-                    currentShape = b.shape;
+                    pushCommand(CommandType::SET_SHAPE, (int)b.shape);
                     return;
                 }
             }
-            // Check if back button was clicked
-            if (normalizedX >= backButton.x && normalizedX <= backButton.x + backButton.width &&
-                normalizedY >= backButton.y && normalizedY <= backButton.y + backButton.height)
-            {
-                currentScreen = Screen::MAIN_MENU;
-            }
-        }
-        else
-        {
-            // Check if back button was clicked
-            if (normalizedX >= backButton.x && normalizedX <= backButton.x + backButton.width &&
-                normalizedY >= backButton.y && normalizedY <= backButton.y + backButton.height)
-            {
-                currentScreen = Screen::MAIN_MENU;
-            }
         }
     }
 }
@@ -426,7 +475,7 @@ void processInput(GLFWwindow *window)
     {
         if (currentScreen != Screen::MAIN_MENU)
         {
-            currentScreen = Screen::MAIN_MENU;
+            pushCommand(CommandType::SET_SCREEN, (int)Screen::MAIN_MENU);
         }
         else
         {
@@ -438,6 +487,7 @@ void processInput(GLFWwindow *window)
 // Create a rectangle vertex data
 void createRectangle(float x, float y, float width, float height, glm::vec3 color, float vertices[], int &vertexIndex)
 {
+    PROFILE_ZONE("createRectangle");
     // Top-left
     vertices[vertexIndex++] = x;
     vertices[vertexIndex++] = y + height;
@@ -487,14 +537,20 @@ void createRectangle(float x, float y, float width, float height, glm::vec3 colo
     vertices[vertexIndex++] = color.b;
 }
 
-// Create a circle vertex data (approximated with triangles)
-void createCircle(float centerX, float centerY, float radius, glm::vec3 color, float vertices[], int &vertexIndex, int segments = 32)
+// Create a circle vertex data (approximated with triangles). The segment
+// count follows the circle's radius on screen; points come from the
+// precomputed unit circle tables rather than per-vertex cos/sin.
+void createCircle(float centerX, float centerY, float radius, glm::vec3 color, float vertices[], int &vertexIndex)
 {
+    PROFILE_ZONE("createCircle");
+    // The projection maps 2 units onto the viewport on each axis
+    float pixelRadius = radius * 0.5f * (float)std::max(windowWidth, windowHeight);
+    int level = selectCircleLod(pixelRadius);
+    int segments = CIRCLE_LOD_SEGMENTS[level];
+    const float *unitX = &UNIT_CIRCLES.x[UNIT_CIRCLES.offset[level]];
+    const float *unitY = &UNIT_CIRCLES.y[UNIT_CIRCLES.offset[level]];
     for (int i = 0; i < segments; i++)
     {
-        float angle1 = 2.0f * 3.14159f * i / segments;
-        float angle2 = 2.0f * 3.14159f * (i + 1) / segments;
-
         // Center
         vertices[vertexIndex++] = centerX;
         vertices[vertexIndex++] = centerY;
@@ -504,16 +560,16 @@ void createCircle(float centerX, float centerY, float radius, glm::vec3 color, f
         vertices[vertexIndex++] = color.b;
 
         // First point
-        vertices[vertexIndex++] = centerX + radius * cos(angle1);
-        vertices[vertexIndex++] = centerY + radius * sin(angle1);
+        vertices[vertexIndex++] = centerX + radius * unitX[i];
+        vertices[vertexIndex++] = centerY + radius * unitY[i];
         vertices[vertexIndex++] = 0.0f;
         vertices[vertexIndex++] = color.r;
         vertices[vertexIndex++] = color.g;
         vertices[vertexIndex++] = color.b;
 
         // Second point
-        vertices[vertexIndex++] = centerX + radius * cos(angle2);
-        vertices[vertexIndex++] = centerY + radius * sin(angle2);
+        vertices[vertexIndex++] = centerX + radius * unitX[i + 1];
+        vertices[vertexIndex++] = centerY + radius * unitY[i + 1];
         vertices[vertexIndex++] = 0.0f;
         vertices[vertexIndex++] = color.r;
         vertices[vertexIndex++] = color.g;
@@ -521,101 +577,10 @@ void createCircle(float centerX, float centerY, float radius, glm::vec3 color, f
     }
 }
 
-// Ball initialization function
-void initBalls(int count)
-{
-    NUM_BALLS = count;
-    float radius = (count <= 5) ? 0.05f : (count <= 10 ? 0.035f : 0.018f);
-    srand((unsigned int)glfwGetTime());
-    for (int i = 0; i < count; i++)
-    {
-        float angle = 2.0f * 3.14159f * i / count;
-        float r = 0.5f * ((float)rand() / RAND_MAX) + 0.2f;
-        balls[i].x = r * cos(angle) * 0.7f;
-        balls[i].y = r * sin(angle) * 0.7f;
-        float speed = (count <= 5) ? 0.003f : (count <= 10 ? 0.0025f : 0.0015f);
-        float theta = 2.0f * 3.14159f * ((float)rand() / RAND_MAX);
-        balls[i].vx = speed * cos(theta);
-        balls[i].vy = speed * sin(theta);
-        balls[i].radius = radius;
-        balls[i].color = glm::vec3(1.0f, 0.0f, 0.0f);
-    }
-}
-
-// Update ball physics
-void updateBall()
-{
-    // Update position for all balls
-    for (int i = 0; i < NUM_BALLS; i++)
-    {
-        balls[i].x += balls[i].vx;
-        balls[i].y += balls[i].vy;
-
-        // Check collision with walls
-        if (balls[i].x - balls[i].radius <= BOX_LEFT || balls[i].x + balls[i].radius >= BOX_RIGHT)
-        {
-            balls[i].vx = -balls[i].vx;
-            // Clamp position to prevent sticking
-            if (balls[i].x - balls[i].radius <= BOX_LEFT)
-                balls[i].x = BOX_LEFT + balls[i].radius;
-            if (balls[i].x + balls[i].radius >= BOX_RIGHT)
-                balls[i].x = BOX_RIGHT - balls[i].radius;
-        }
-
-        if (balls[i].y - balls[i].radius <= BOX_BOTTOM || balls[i].y + balls[i].radius >= BOX_TOP)
-        {
-            balls[i].vy = -balls[i].vy;
-            // Clamp position to prevent sticking
-            if (balls[i].y - balls[i].radius <= BOX_BOTTOM)
-                balls[i].y = BOX_BOTTOM + balls[i].radius;
-            if (balls[i].y + balls[i].radius >= BOX_TOP)
-                balls[i].y = BOX_TOP - balls[i].radius;
-        }
-    }
-
-    // Check ball-to-ball collisions
-    for (int i = 0; i < NUM_BALLS; i++)
-    {
-        for (int j = i + 1; j < NUM_BALLS; j++)
-        {
-            float dx = balls[j].x - balls[i].x;
-            float dy = balls[j].y - balls[i].y;
-            float distance = sqrt(dx * dx + dy * dy);
-            float minDistance = balls[i].radius + balls[j].radius;
-
-            if (distance < minDistance)
-            {
-                // Collision detected - separate balls
-                float overlap = minDistance - distance;
-                float separationX = (dx / distance) * overlap * 0.5f;
-                float separationY = (dy / distance) * overlap * 0.5f;
-
-                balls[i].x -= separationX;
-                balls[i].y -= separationY;
-                balls[j].x += separationX;
-                balls[j].y += separationY;
-
-                // Calculate collision response (elastic collision for equal masses)
-                float nx = dx / distance;
-                float ny = dy / distance;
-
-                // For equal masses, elastic collision simply swaps velocities along the normal
-                float v1n = balls[i].vx * nx + balls[i].vy * ny;
-                float v2n = balls[j].vx * nx + balls[j].vy * ny;
-
-                // Swap normal velocities
-                balls[i].vx = balls[i].vx + (v2n - v1n) * nx;
-                balls[i].vy = balls[i].vy + (v2n - v1n) * ny;
-                balls[j].vx = balls[j].vx + (v1n - v2n) * nx;
-                balls[j].vy = balls[j].vy + (v1n - v2n) * ny;
-            }
-        }
-    }
-}
-
 // Create a square vertex data
 void createSquareVertices(float centerX, float centerY, float size, glm::vec3 color, float vertices[], int &vertexIndex)
 {
+    PROFILE_ZONE("createSquareVertices");
     float halfSize = size * 0.5f;
 
     // Top-left
@@ -670,6 +635,7 @@ void createSquareVertices(float centerX, float centerY, float size, glm::vec3 co
 // Create pendulum string vertex data
 void createPendulumString(float anchorX, float anchorY, float bobX, float bobY, glm::vec3 color, float vertices[], int &vertexIndex)
 {
+    PROFILE_ZONE("createPendulumString");
     // Create a thin line for the string
     float thickness = 0.002f;
 
@@ -739,460 +705,357 @@ void createPendulumString(float anchorX, float anchorY, float bobX, float bobY,
     }
 }
 
-// Square mass initialization function
-void initSquareMasses(float massRatio)
-{
-    squares[0].mass = 1.0f;
-    squares[1].mass = massRatio;
-}
-
-// Reset blue squares to initial state
-void resetSquares()
+// Append a flat-coloured vertex
+void pushVertex(float vertices[], int &vertexIndex, float x, float y, glm::vec3 color)
 {
-    squares[0].x = 0.0f;
-    squares[0].y = 0.0f;
-    squares[0].vx = 0.004f;
-    squares[0].vy = 0.0f;
-    squares[0].size = 0.1f;
-    squares[0].color = glm::vec3(0.0f, 0.0f, 1.0f);
-
-    squares[1].x = 0.3f;
-    squares[1].y = 0.0f;
-    squares[1].vx = -0.003f;
-    squares[1].vy = 0.0f;
-    squares[1].size = 0.1f;
-    squares[1].color = glm::vec3(0.0f, 0.0f, 1.0f);
+    vertices[vertexIndex++] = x;
+    vertices[vertexIndex++] = y;
+    vertices[vertexIndex++] = 0.0f;
+    vertices[vertexIndex++] = color.r;
+    vertices[vertexIndex++] = color.g;
+    vertices[vertexIndex++] = color.b;
 }
 
-// Update square physics
-void updateSquare()
+// Rebuild all static UI geometry into the retained scene
+void buildUiScene()
 {
-    // Update position for all squares
-    for (int i = 0; i < NUM_SQUARES; i++)
+    PROFILE_ZONE("buildUiScene");
+    beginRetainedScene(uiScene);
+    float *vertices;
+    int vertexIndex;
+
+    // Main menu buttons
+    vertices = beginSceneItem(uiScene, NUM_BUTTONS * 6);
+    vertexIndex = 0;
+    for (int i = 0; i < NUM_BUTTONS; i++)
+        createRectangle(buttons[i].x, buttons[i].y, buttons[i].width, buttons[i].height, buttons[i].color, vertices, vertexIndex);
+    endSceneItem(uiScene, UI_MENU_BUTTONS, GL_TRIANGLES, vertexIndex);
+
+    vertices = beginSceneItem(uiScene, 6);
+    vertexIndex = 0;
+    createRectangle(backButton.x, backButton.y, backButton.width, backButton.height, backButton.color, vertices, vertexIndex);
+    endSceneItem(uiScene, UI_BACK_BUTTON, GL_TRIANGLES, vertexIndex);
+
+    // Box walls: top, bottom, left, right
+    glm::vec3 white = glm::vec3(1.0f, 1.0f, 1.0f);
+    vertices = beginSceneItem(uiScene, 4 * 6);
+    vertexIndex = 0;
+    createRectangle(BOX_LEFT, BOX_TOP - 0.02f, BOX_RIGHT - BOX_LEFT, 0.02f, white, vertices, vertexIndex);
+    createRectangle(BOX_LEFT, BOX_BOTTOM, BOX_RIGHT - BOX_LEFT, 0.02f, white, vertices, vertexIndex);
+    createRectangle(BOX_LEFT, BOX_BOTTOM, 0.02f, BOX_TOP - BOX_BOTTOM, white, vertices, vertexIndex);
+    createRectangle(BOX_RIGHT - 0.02f, BOX_BOTTOM, 0.02f, BOX_TOP - BOX_BOTTOM, white, vertices, vertexIndex);
+    endSceneItem(uiScene, UI_BOX_WALLS, GL_TRIANGLES, vertexIndex);
+
+    vertices = beginSceneItem(uiScene, NUM_BALL_COUNT_BUTTONS * 6);
+    vertexIndex = 0;
+    for (int i = 0; i < NUM_BALL_COUNT_BUTTONS; i++)
+        createRectangle(ballCountButtons[i].x, ballCountButtons[i].y, ballCountButtons[i].width, ballCountButtons[i].height, glm::vec3(0.3f, 0.3f, 0.3f), vertices, vertexIndex);
+    endSceneItem(uiScene, UI_BALL_COUNT_BUTTONS, GL_TRIANGLES, vertexIndex);
+
+    vertices = beginSceneItem(uiScene, NUM_MASS_BUTTONS * 6);
+    vertexIndex = 0;
+    for (int i = 0; i < NUM_MASS_BUTTONS; i++)
+        createRectangle(massButtons[i].x, massButtons[i].y, massButtons[i].width, massButtons[i].height, glm::vec3(0.3f, 0.3f, 0.3f), vertices, vertexIndex);
+    endSceneItem(uiScene, UI_MASS_BUTTONS, GL_TRIANGLES, vertexIndex);
+
+    vertices = beginSceneItem(uiScene, 6);
+    vertexIndex = 0;
+    createRectangle(resetButton.x, resetButton.y, resetButton.width, resetButton.height, glm::vec3(0.3f, 0.3f, 0.3f), vertices, vertexIndex);
+    endSceneItem(uiScene, UI_RESET_BUTTON, GL_TRIANGLES, vertexIndex);
+
+    vertices = beginSceneItem(uiScene, NUM_SHAPE_BUTTONS * 6);
+    vertexIndex = 0;
+    for (int i = 0; i < NUM_SHAPE_BUTTONS; i++)
+        createRectangle(shapeButtons[i].x, shapeButtons[i].y, shapeButtons[i].width, shapeButtons[i].height, glm::vec3(0.4f, 0.4f, 0.4f), vertices, vertexIndex);
+    endSceneItem(uiScene, UI_SHAPE_BUTTONS, GL_TRIANGLES, vertexIndex);
+
+    // Wind tunnel obstacles (the selected shape and any layout), from the cached outlines
+    glm::vec3 grey = glm::vec3(0.8f, 0.8f, 0.8f);
+    updateFluidObstacle(yellowSim);
+    std::vector<const ObstacleGeometry *> geometries = {&yellowSim.geometry};
+    int obstacleVertices = 0;
+    for (const ObstacleInstance &obstacle : yellowSim.obstacles)
+        geometries.push_back(&obstacle.geometry);
+    for (const ObstacleGeometry *geometry : geometries)
+        obstacleVertices += geometry->outline.empty() ? CIRCLE_MAX_SEGMENTS * 3 : (int)geometry->triangles.size() / 2;
+    vertices = beginSceneItem(uiScene, obstacleVertices);
+    vertexIndex = 0;
+    for (const ObstacleGeometry *geometry : geometries)
     {
-        // Apply small damping to prevent energy buildup
-        squares[i].vx *= 1.0f; // No damping for now
-        squares[i].vy *= 1.0f;
-
-        squares[i].x += squares[i].vx;
-        squares[i].y += squares[i].vy;
-
-        // Check collision with walls
-        if (squares[i].x - squares[i].size * 0.5f <= BOX_LEFT || squares[i].x + squares[i].size * 0.5f >= BOX_RIGHT)
-        {
-            squares[i].vx = -squares[i].vx;
-            // Clamp position to prevent sticking
-            if (squares[i].x - squares[i].size * 0.5f <= BOX_LEFT)
-                squares[i].x = BOX_LEFT + squares[i].size * 0.5f;
-            if (squares[i].x + squares[i].size * 0.5f >= BOX_RIGHT)
-                squares[i].x = BOX_RIGHT - squares[i].size * 0.5f;
-        }
-
-        if (squares[i].y - squares[i].size * 0.5f <= BOX_BOTTOM || squares[i].y + squares[i].size * 0.5f >= BOX_TOP)
+        // Balls are drawn as circles, everything else from the triangles
+        // tessellated with the outline
+        if (geometry->outline.empty())
         {
-            squares[i].vy = -squares[i].vy;
-            // Clamp position to prevent sticking
-            if (squares[i].y - squares[i].size * 0.5f <= BOX_BOTTOM)
-                squares[i].y = BOX_BOTTOM + squares[i].size * 0.5f;
-            if (squares[i].y + squares[i].size * 0.5f >= BOX_TOP)
-                squares[i].y = BOX_TOP - squares[i].size * 0.5f;
+            createCircle(geometry->x, geometry->y, geometry->radius, grey, vertices, vertexIndex);
+            continue;
         }
+        for (size_t i = 0; i < geometry->triangles.size(); i += 2)
+            pushVertex(vertices, vertexIndex, geometry->triangles[i], geometry->triangles[i + 1], grey);
     }
+    endSceneItem(uiScene, UI_OBSTACLE, GL_TRIANGLES, vertexIndex);
+    endRetainedScene(uiScene);
+}
 
-    // Check square-to-square collisions (1D horizontal only)
-    for (int i = 0; i < NUM_SQUARES; i++)
+// Fill obstacleSdf with the signed distance to the nearest obstacle over the box
+void buildObstacleSdf()
+{
+    PROFILE_ZONE("buildObstacleSdf");
+    updateFluidObstacle(yellowSim);
+    for (int j = 0; j < OBSTACLE_SDF_HEIGHT; j++)
     {
-        for (int j = i + 1; j < NUM_SQUARES; j++)
+        for (int i = 0; i < OBSTACLE_SDF_WIDTH; i++)
         {
-            float dx = squares[j].x - squares[i].x;
-            float distance = fabs(dx);
-            float minDistance = squares[i].size * 0.5f + squares[j].size * 0.5f;
-
-            if (distance < minDistance && distance > 0.001f)
-            {
-                // Only handle if moving toward each other (1D)
-                if ((squares[j].vx - squares[i].vx) * (squares[j].x - squares[i].x) >= 0)
-                    continue;
-
-                // Separate squares
-                float overlap = minDistance - distance;
-                float separation = overlap * 0.5f * (dx > 0 ? 1.0f : -1.0f);
-                squares[i].x -= separation;
-                squares[j].x += separation;
-
-                // 1D elastic collision equations for vx
-                float m1 = squares[i].mass;
-                float m2 = squares[j].mass;
-                float v1 = squares[i].vx;
-                float v2 = squares[j].vx;
-                float v1p = ((m1 - m2) * v1 + 2 * m2 * v2) / (m1 + m2);
-                float v2p = ((m2 - m1) * v2 + 2 * m1 * v1) / (m1 + m2);
-                squares[i].vx = v1p;
-                squares[j].vx = v2p;
-            }
+            // Sample at texel centres
+            float x = BOX_LEFT + (i + 0.5f) * (BOX_RIGHT - BOX_LEFT) / OBSTACLE_SDF_WIDTH;
+            float y = BOX_BOTTOM + (j + 0.5f) * (BOX_TOP - BOX_BOTTOM) / OBSTACLE_SDF_HEIGHT;
+            obstacleSdf[j * OBSTACLE_SDF_WIDTH + i] = fluidObstacleSignedDistance(yellowSim, x, y);
         }
     }
 }
 
-// Newton's Cradle initialization function
-void initNewtonsCradle()
+// Register the kernels with serial and threaded variants, each benchmarked
+// on a problem built for the size asked about
+void registerTunedKernels()
 {
-    float startX = -0.24f; // Center the 5 pendulums properly
-    for (int i = 0; i < NUM_PENDULUMS; i++)
-    {
-        pendulums[i].x = startX + i * PENDULUM_SPACING;
-        pendulums[i].y = BOX_TOP - 0.15f; // Anchor point inside the box, not at the very top
-        pendulums[i].angle = 0.0f;
-        pendulums[i].angularVel = 0.0f;
-        pendulums[i].length = PENDULUM_LENGTH * 0.8f; // Adjusted scaling for longer strings
-        pendulums[i].mass = PENDULUM_MASS;
-        pendulums[i].radius = PENDULUM_RADIUS;
-        pendulums[i].color = glm::vec3(0.0f, 1.0f, 0.0f); // Green color
-        pendulums[i].isDragging = false;
-    }
+    nbodyKernel = registerTunedKernel("nbody", {"serial", "threaded"}, {1000, 5000, 20000, 100000}, [](int variant, int size)
+                                      {
+        // Uniformly scattered bodies; the tree is built once, forces are timed
+        std::shared_ptr<BallSim> sim = std::make_shared<BallSim>();
+        sim->balls.resize(size);
+        for (int i = 0; i < size; i++)
+        {
+            float draws[4];
+            counterRngFloats(CounterRngKey{0, 0}, i, 0, draws);
+            sim->balls[i] = Ball{BOX_LEFT + draws[0] * (BOX_RIGHT - BOX_LEFT), BOX_BOTTOM + draws[1] * (BOX_TOP - BOX_BOTTOM), 0.0f, 0.0f, 0.001f, glm::vec3(1.0f)};
+        }
+        setBallGravity(*sim, true, nbodyOpeningAngle);
+        sim->gravityParams.gravity = NBODY_TOTAL_GM / size;
+        sim->gravityParams.threads = variant == KERNEL_SERIAL ? 1 : 0;
+        buildBarnesHutTree(sim->tree, sim->balls);
+        return std::function<void()>([sim]() { computeBarnesHutForces(sim->tree, sim->balls, sim->gravityParams); }); });
+
+    stableFluidKernel = registerTunedKernel("stable-fluid", {"serial", "threaded"}, {128, 256, 512, 1024}, [](int variant, int size)
+                                            {
+        std::shared_ptr<StableFluid> fluid(new StableFluid(), [](StableFluid *f)
+                                           {
+            destroyStableFluid(*f);
+            delete f; });
+        initStableFluid(*fluid, size, BOX_LEFT, BOX_BOTTOM, BOX_RIGHT, BOX_TOP, variant == KERNEL_SERIAL ? 1 : 0);
+        return std::function<void()>([fluid]() { updateStableFluid(*fluid, 0.01f); }); });
 }
 
-// Newton's Cradle update function
-void updateNewtonsCradle()
+// Enter N-body mode with the force kernel tuned for the body count
+void startNbody()
 {
-    // Apply damping to all pendulums
-    for (int i = 0; i < NUM_PENDULUMS; i++)
-    {
-        pendulums[i].angularVel *= DAMPING;
-    }
-
-    // Update pendulum physics
-    for (int i = 0; i < NUM_PENDULUMS; i++)
-    {
-        // Simple pendulum physics
-        pendulums[i].angularVel -= GRAVITY * sin(pendulums[i].angle) / pendulums[i].length;
-        pendulums[i].angle += pendulums[i].angularVel;
-    }
+    setBallGravity(redSim, true, nbodyOpeningAngle);
+    redSim.gravityParams.threads = selectTunedVariant(nbodyKernel, (int)redSim.balls.size()) == KERNEL_SERIAL ? 1 : 0;
+}
 
-    // Check collisions between adjacent pendulums
-    for (int i = 0; i < NUM_PENDULUMS - 1; i++)
+// Apply one UI command to the simulation state
+void applyCommand(const Command &command)
+{
+    switch (command.type)
     {
-        float bob1X = pendulums[i].x + pendulums[i].length * sin(pendulums[i].angle);
-        float bob1Y = pendulums[i].y - pendulums[i].length * cos(pendulums[i].angle);
-        float bob2X = pendulums[i + 1].x + pendulums[i + 1].length * sin(pendulums[i + 1].angle);
-        float bob2Y = pendulums[i + 1].y - pendulums[i + 1].length * cos(pendulums[i + 1].angle);
+    case CommandType::SET_SCREEN:
+        currentScreen = (Screen)command.value;
+        break;
+    case CommandType::SET_BALL_COUNT:
+        initBalls(redSim, command.value, (unsigned int)simulationStep); // Seeded by step so replays match
+        break;
+    case CommandType::SET_MASS_RATIO:
+        initSquareMasses(blueSim, command.x);
+        resetSquares(blueSim);
+        break;
+    case CommandType::RESET_CRADLE:
+        resetNewtonsCradle(greenSim);
+        break;
+    case CommandType::PULL_PENDULUM:
+        // Check if clicking on any pendulum to pull it and all balls to its left back
+        for (int i = 0; i < NUM_PENDULUMS; i++)
+        {
+            float bobX = greenSim.pendulums[i].x + greenSim.pendulums[i].length * sin(greenSim.pendulums[i].angle);
+            float bobY = greenSim.pendulums[i].y - greenSim.pendulums[i].length * cos(greenSim.pendulums[i].angle);
 
-        float dx = bob2X - bob1X;
-        float dy = bob2Y - bob1Y;
-        float distance = sqrt(dx * dx + dy * dy);
+            float clickDistance = sqrt((command.x - bobX) * (command.x - bobX) +
+                                       (command.y - bobY) * (command.y - bobY));
 
-        // Only handle collision if balls are overlapping and moving toward each other
-        if (distance < COLLISION_DISTANCE && distance > 0.001f)
-        {
-            // Calculate velocities of bobs
-            float vel1X = pendulums[i].angularVel * pendulums[i].length * cos(pendulums[i].angle);
-            float vel1Y = -pendulums[i].angularVel * pendulums[i].length * sin(pendulums[i].angle);
-            float vel2X = pendulums[i + 1].angularVel * pendulums[i + 1].length * cos(pendulums[i + 1].angle);
-            float vel2Y = -pendulums[i + 1].angularVel * pendulums[i + 1].length * sin(pendulums[i + 1].angle);
-
-            // Relative velocity along collision normal
-            float normalX = dx / distance;
-            float normalY = dy / distance;
-            float relVelX = vel2X - vel1X;
-            float relVelY = vel2Y - vel1Y;
-            float relVelAlongNormal = relVelX * normalX + relVelY * normalY;
-
-            // Only apply collision if balls are moving toward each other
-            if (relVelAlongNormal < 0)
+            if (clickDistance < greenSim.pendulums[i].radius * 2.0f)
             {
-                // Elastic collision - swap angular velocities
-                float tempVel = pendulums[i].angularVel;
-                pendulums[i].angularVel = pendulums[i + 1].angularVel;
-                pendulums[i + 1].angularVel = tempVel;
-
-                // Immediately separate balls by adjusting their positions
-                // This prevents multiple collisions in the same frame
-                float overlap = COLLISION_DISTANCE - distance;
-                float separationX = overlap * normalX * 0.6f; // Slightly more separation
-                float separationY = overlap * normalY * 0.6f;
-
-                // Calculate new positions that maintain pendulum constraints
-                float newBob1X = bob1X - separationX;
-                float newBob1Y = bob1Y - separationY;
-                float newBob2X = bob2X + separationX;
-                float newBob2Y = bob2Y + separationY;
-
-                // Convert back to angles while maintaining pendulum constraints
-                float newAngle1 = asin((newBob1X - pendulums[i].x) / pendulums[i].length);
-                float newAngle2 = asin((newBob2X - pendulums[i + 1].x) / pendulums[i + 1].length);
-
-                // Apply the new angles
-                pendulums[i].angle = newAngle1;
-                pendulums[i + 1].angle = newAngle2;
+                // Pull back this pendulum and all pendulums to its left
+                pullBackPendulums(greenSim, i + 1);
+                break; // Exit the loop after finding the clicked ball
             }
         }
-    }
-}
-
-// Function to reset Newton's Cradle
-void resetNewtonsCradle()
-{
-    for (int i = 0; i < NUM_PENDULUMS; i++)
+        break;
+    case CommandType::SET_SHAPE:
+        yellowSim.shape = (ObstacleShape)command.value;
+        invalidateRetainedScene(uiScene);
+        break;
+    case CommandType::TOGGLE_PAUSE:
+        paused = !paused;
+        sceneDirty = true;
+        return;
+    case CommandType::TOGGLE_GRAVITY:
     {
-        pendulums[i].angle = 0.0f;
-        pendulums[i].angularVel = 0.0f;
+        // Leaving N-body mode drops back to a count the contact solver handles
+        bool enable = !redSim.gravity;
+        initBalls(redSim, enable ? nbodyCount : MAX_BALLS, (unsigned int)simulationStep);
+        if (enable)
+            startNbody();
+        break;
     }
-}
-
-// Fluid demo function prototypes
-void initFluidDemo();
-void updateFluidDemo();
-void spawnFluidParticle();
-
-// Shape collision detection function prototypes
-bool checkBallCollision(float x, float y, float radius);
-bool checkTriangleCollision(float x, float y, float radius);
-bool checkAirfoilCollision(float x, float y, float radius);
-
-// Fluid demo functions
-void initFluidDemo()
-{
-    NUM_FLUID_PARTICLES = 0;
-    streamSpeed = 0.01f; // Fast speed by default
-    obstacleX = 0.0f;
-    obstacleY = 0.0f;
-    obstacleRadius = 0.15f;
-
-    // Initialize all particles as inactive
-    for (int i = 0; i < MAX_FLUID_PARTICLES; i++)
+    case CommandType::ADJUST_ANGLE_OF_ATTACK:
     {
-        fluidParticles[i].active = false;
+        float limit = glm::radians(AIRFOIL_MAX_ANGLE_DEGREES);
+        yellowSim.airfoil.angleOfAttack = std::min(std::max(yellowSim.airfoil.angleOfAttack + command.x, -limit), limit);
+        invalidateRetainedScene(uiScene);
+        break;
     }
+    case CommandType::SET_FLOW_LINES:
+        flowLineMode = (FlowLineMode)command.value;
+        clearFlowLines(flowLines);
+        break;
+    }
+    sceneDirty = true;
+    telemetryRestart = true;
 }
 
-void spawnFluidParticle()
+// Drain queued commands at a step boundary. While replaying, recorded commands
+// are applied at the step they were originally applied at and live input is ignored.
+void applyPendingCommands()
 {
-    // Find an inactive particle
-    for (int i = 0; i < MAX_FLUID_PARTICLES; i++)
+    double now = glfwGetTime();
+    Command command;
+    while (commandQueue.pop(command))
     {
-        if (!fluidParticles[i].active)
+        if (!replayCommands.empty())
+            continue;
+
+        applyCommand(command);
+        recordInputApplied(command.issuedAt, now);
+
+        if (inputRecordFile)
         {
-            // Spawn on the left edge with some random vertical position
-            fluidParticles[i].x = BOX_LEFT + 0.05f;
-            fluidParticles[i].y = BOX_BOTTOM + 0.1f + (float)rand() / RAND_MAX * (BOX_TOP - BOX_BOTTOM - 0.2f);
-            fluidParticles[i].vx = streamSpeed; // Always move right
-            fluidParticles[i].vy = 0.0f;        // No vertical velocity initially
-            fluidParticles[i].radius = 0.008f;
-            fluidParticles[i].color = glm::vec3(1.0f, 1.0f, 0.0f); // Yellow particles
-            fluidParticles[i].active = true;
-            NUM_FLUID_PARTICLES++;
-            break;
+            fprintf(inputRecordFile, "%llu %d %d %.9g %.9g\n", simulationStep, (int)command.type, command.value, command.x, command.y);
         }
     }
+
+    while (replayIndex < replayCommands.size() && replayCommands[replayIndex].first <= simulationStep)
+    {
+        applyCommand(replayCommands[replayIndex].second);
+        replayIndex++;
+    }
 }
 
-void updateFluidDemo()
+// Load a recording written by --record-input
+bool loadInputRecording(const char *path)
 {
-    // Continuously spawn new particles to keep the stream full
-    int activeCount = 0;
-    for (int i = 0; i < MAX_FLUID_PARTICLES; i++)
+    FILE *file = fopen(path, "r");
+    if (!file)
     {
-        if (fluidParticles[i].active)
-            activeCount++;
+        std::cerr << "Failed to open input recording " << path << std::endl;
+        return false;
     }
-    // Try to keep the stream full
-    int particlesToSpawn = MAX_FLUID_PARTICLES - activeCount;
-    for (int i = 0; i < particlesToSpawn; i++)
+    unsigned long long step;
+    int type, value;
+    float x, y;
+    while (fscanf(file, "%llu %d %d %f %f", &step, &type, &value, &x, &y) == 5)
     {
-        spawnFluidParticle();
+        Command command = {(CommandType)type, value, x, y, 0.0};
+        replayCommands.push_back(std::make_pair(step, command));
     }
-
-    // Update all active particles
-    for (int i = 0; i < MAX_FLUID_PARTICLES; i++)
-    {
-        if (!fluidParticles[i].active)
-            continue;
-        FluidParticle &p = fluidParticles[i];
-        // Update position
-        p.x += p.vx;
-        p.y += p.vy;
-        // Check collision with obstacle based on current shape
-        bool collision = false;
-        switch (currentShape)
-        {
-        case ObstacleShape::BALL:
-            collision = checkBallCollision(p.x, p.y, p.radius);
-            break;
-        case ObstacleShape::TRIANGLE:
-            collision = checkTriangleCollision(p.x, p.y, p.radius);
-            break;
-        case ObstacleShape::AIRFOIL:
-            collision = checkAirfoilCollision(p.x, p.y, p.radius);
-            break;
-        }
-        if (collision)
-        {
-            float dx = p.x - obstacleX;
-            float dy = p.y - obstacleY;
-            float distance = sqrt(dx * dx + dy * dy);
-            if (distance > 0.001f)
-            {
-                float pushDistance = obstacleRadius + p.radius + 0.01f;
-                p.x = obstacleX + (dx / distance) * pushDistance;
-                p.y = obstacleY + (dy / distance) * pushDistance;
-                float flowForce = streamSpeed * 0.5f;
-                float normalX = dx / distance;
-                float normalY = dy / distance;
-                p.vx += normalY * flowForce;
-                p.vy -= normalX * flowForce;
-                if (p.vx < streamSpeed * 0.5f)
-                {
-                    p.vx = streamSpeed * 0.5f;
-                }
-            }
-        }
-        // Check collision with box walls - particles flow through, not bounce
-        if (p.x - p.radius <= BOX_LEFT)
-        {
-            p.x = BOX_LEFT + p.radius;
-            p.vx = streamSpeed;
-        }
-        if (p.y - p.radius <= BOX_BOTTOM)
-        {
-            p.y = BOX_BOTTOM + p.radius;
-            p.vy = 0.0f;
-        }
-        if (p.y + p.radius >= BOX_TOP)
-        {
-            p.y = BOX_TOP - p.radius;
-            p.vy = 0.0f;
-        }
-        // Remove particles that reach or pass the right edge
-        if (p.x - p.radius >= BOX_RIGHT)
-        {
-            p.active = false;
-            NUM_FLUID_PARTICLES--;
-        }
-        // Add small amount of damping to prevent excessive turbulence
-        p.vx *= 0.998f;
-        p.vy *= 0.998f;
-        if (streamSpeed > 0.007f)
-        {
-            p.vx += ((float)rand() / RAND_MAX - 0.5f) * 0.0003f;
-            p.vy += ((float)rand() / RAND_MAX - 0.5f) * 0.0003f;
-        }
-    }
-}
-
-// Shape collision detection functions
-bool checkBallCollision(float x, float y, float radius)
-{
-    float dx = x - obstacleX;
-    float dy = y - obstacleY;
-    float distance = sqrt(dx * dx + dy * dy);
-    return distance < obstacleRadius + radius;
+    fclose(file);
+    return true;
 }
 
-bool checkTriangleCollision(float x, float y, float radius)
+int main(int argc, char **argv)
 {
-    // Triangle vertices (equilateral triangle pointing right) - same as rendering
-    float size = obstacleRadius * 2.0f; // Side length
-    float h = size * sqrt(3.0f) / 2.0f; // Height
-    float v1x = obstacleX - size / 2.0f, v1y = obstacleY - h / 3.0f;
-    float v2x = obstacleX + size / 2.0f, v2y = obstacleY - h / 3.0f;
-    float v3x = obstacleX, v3y = obstacleY + 2.0f * h / 3.0f;
-
-    // First check if point is inside triangle (including radius)
-    // Use barycentric coordinates
-    float denominator = ((v2y - v3y) * (v1x - v3x) + (v3x - v2x) * (v1y - v3y));
-    if (abs(denominator) < 0.0001f)
-        return false; // Degenerate triangle
-
-    float w1 = ((v2y - v3y) * (x - v3x) + (v3x - v2x) * (y - v3y)) / denominator;
-    float w2 = ((v3y - v1y) * (x - v3x) + (v1x - v3x) * (y - v3y)) / denominator;
-    float w3 = 1.0f - w1 - w2;
-
-    // Check if point is inside triangle (with some tolerance for radius)
-    if (w1 >= -0.1f && w2 >= -0.1f && w3 >= -0.1f)
+    // Command line options
+    const char *telemetryPath = NULL;
+    const char *profilePath = NULL;
+    const char *memoryReportPath = NULL;
+    bool vsync = true;
+    const char *capturePath = NULL;
+    int captureFps = 60;
+    bool nbodyStart = false;
+    bool retuneKernels = false;
+
+    // SIMD kernels are picked before anything runs, sweeps included; --isa caps the instruction set
+    SimdIsa isaLimit = SimdIsa::AVX512;
+    for (int i = 1; i + 1 < argc; i++)
     {
-        return true;
+        if (strcmp(argv[i], "--isa") == 0 && !parseSimdIsa(argv[i + 1], isaLimit))
+            std::cerr << "Unknown instruction set " << argv[i + 1] << ", expected baseline, avx2 or avx512" << std::endl;
     }
+    initSimdKernels(isaLimit);
 
-    // Also check distance to edges for particles near the boundary
-    float minDist = 1000.0f;
-
-    // Edge 1: v1 to v2
-    float edge1x = v2x - v1x, edge1y = v2y - v1y;
-    float edge1Len = sqrt(edge1x * edge1x + edge1y * edge1y);
-    if (edge1Len > 0.0001f)
+    for (int i = 1; i < argc; i++)
     {
-        edge1x /= edge1Len;
-        edge1y /= edge1Len;
-        float proj1 = (x - v1x) * edge1x + (y - v1y) * edge1y;
-        if (proj1 >= -radius && proj1 <= edge1Len + radius)
+        if (strcmp(argv[i], "--sweep") == 0)
+            return runSweep(argc, argv); // Headless, no window
+        else if (strcmp(argv[i], "--telemetry") == 0 && i + 1 < argc)
+            telemetryPath = argv[++i];
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+            profilePath = argv[++i];
+        else if (strcmp(argv[i], "--memory-report") == 0 && i + 1 < argc)
+            memoryReportPath = argv[++i];
+        else if (strcmp(argv[i], "--gpu-fluid") == 0)
+            useGpuFluid = true;
+        else if (strcmp(argv[i], "--stable-fluid") == 0)
         {
-            float dist1 = abs((x - v1x) * edge1y - (y - v1y) * edge1x);
-            minDist = std::min(minDist, dist1);
+            useStableFluid = true;
+            if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0]))
+                stableFluidWidth = std::max(8, atoi(argv[++i]));
         }
-    }
-
-    // Edge 2: v2 to v3
-    float edge2x = v3x - v2x, edge2y = v3y - v2y;
-    float edge2Len = sqrt(edge2x * edge2x + edge2y * edge2y);
-    if (edge2Len > 0.0001f)
-    {
-        edge2x /= edge2Len;
-        edge2y /= edge2Len;
-        float proj2 = (x - v2x) * edge2x + (y - v2y) * edge2y;
-        if (proj2 >= -radius && proj2 <= edge2Len + radius)
+        else if (strcmp(argv[i], "--naca") == 0 && i + 1 < argc)
+            nacaDesignation = argv[++i];
+        else if (strcmp(argv[i], "--obstacle") == 0 && i + 1 < argc)
+            obstaclePath = argv[++i];
+        else if (strcmp(argv[i], "--obstacles") == 0 && i + 1 < argc)
+            obstacleLayoutPath = argv[++i];
+        else if (strcmp(argv[i], "--angle-of-attack") == 0 && i + 1 < argc)
+            angleOfAttackDegrees = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--flow-lines") == 0 && i + 1 < argc)
+            flowLineParams.seeds = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--low-latency") == 0)
+            lowLatency = true;
+        else if (strcmp(argv[i], "--no-vsync") == 0)
+            vsync = false;
+        else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+            capturePath = argv[++i];
+        else if (strcmp(argv[i], "--capture-fps") == 0 && i + 1 < argc)
+            captureFps = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--nbody") == 0 && i + 1 < argc)
         {
-            float dist2 = abs((x - v2x) * edge2y - (y - v2y) * edge2x);
-            minDist = std::min(minDist, dist2);
+            nbodyStart = true;
+            nbodyCount = std::max(1, atoi(argv[++i]));
         }
-    }
-
-    // Edge 3: v3 to v1
-    float edge3x = v1x - v3x, edge3y = v1y - v3y;
-    float edge3Len = sqrt(edge3x * edge3x + edge3y * edge3y);
-    if (edge3Len > 0.0001f)
-    {
-        edge3x /= edge3Len;
-        edge3y /= edge3Len;
-        float proj3 = (x - v3x) * edge3x + (y - v3y) * edge3y;
-        if (proj3 >= -radius && proj3 <= edge3Len + radius)
+        else if (strcmp(argv[i], "--nbody-theta") == 0 && i + 1 < argc)
+            nbodyOpeningAngle = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--record-input") == 0 && i + 1 < argc)
+            inputRecordFile = fopen(argv[++i], "w");
+        else if (strcmp(argv[i], "--replay-input") == 0 && i + 1 < argc)
         {
-            float dist3 = abs((x - v3x) * edge3y - (y - v3y) * edge3x);
-            minDist = std::min(minDist, dist3);
+            if (!loadInputRecording(argv[++i]))
+                return -1;
         }
-    }
-
-    return minDist < radius;
-}
-
-bool checkAirfoilCollision(float x, float y, float radius)
-{
-    // Use the same NACA formula as the rendering
-    float chord = obstacleRadius * 2.0f;
-    float maxThickness = obstacleRadius * 0.8f;
-    float dx = x - obstacleX;
-
-    // Check if particle is within the airfoil's chord length
-    if (dx >= -chord * 0.5f && dx <= chord * 0.5f)
-    {
-        // Convert to normalized coordinates (0 to 1)
-        float xc = (dx + chord * 0.5f) / chord;
-
-        // NACA 00xx thickness formula (same as rendering)
-        float yt = 5.0f * maxThickness * (0.2969f * sqrt(xc) - 0.1260f * xc - 0.3516f * xc * xc + 0.2843f * xc * xc * xc - 0.1015f * xc * xc * xc * xc);
-
-        // Check if particle is within the airfoil thickness (including radius)
-        float dy = y - obstacleY;
-        if (abs(dy) <= yt + radius)
+        else if (strcmp(argv[i], "--isa") == 0 && i + 1 < argc)
+            i++; // Handled above
+        else if (strcmp(argv[i], "--tune") == 0)
+            retuneKernels = true;
+        else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc)
         {
-            return true;
+            if (!overrideTunedKernel(argv[++i]))
+                std::cerr << "Expected --kernel name=variant, got " << argv[i] << std::endl;
         }
     }
 
-    return false;
-}
+    // Cached kernel choices for this machine; missing ones are benchmarked when first needed
+    loadKernelTuning(KERNEL_TUNING_PATH);
+    registerTunedKernels();
+    if (retuneKernels)
+        calibrateTunedKernels();
 
-int main()
-{
     // Initialize GLFW
     if (!glfwInit())
     {
@@ -1228,6 +1091,8 @@ int main()
     glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
     glfwSetCursorPosCallback(window, mouseCallback);
     glfwSetMouseButtonCallback(window, mouseButtonCallback);
+    glfwSetKeyCallback(window, keyCallback);
+    glfwSetWindowRefreshCallback(window, windowRefreshCallback);
 
     // Initialize GLAD
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
@@ -1240,234 +1105,270 @@ int main()
     // Set initial viewport
     glViewport(0, 0, windowWidth, windowHeight);
 
-    // Build and compile our shader program
-    // Vertex shader
-    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-
-    // Check for vertex shader compile errors
-    int success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n"
-                  << infoLog << std::endl;
-    }
+    // Presentation: vsync unless disabled, and latency timestamps
+    glfwSwapInterval(vsync ? 1 : 0);
+    initLatencyTracker();
 
-    // Fragment shader
-    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
+    // Video capture of every presented frame (--capture)
+    if (capturePath && !initFrameCapture(capturePath, windowWidth, windowHeight, captureFps))
+        capturePath = NULL;
 
-    // Check for fragment shader compile errors
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success)
+    // Reserve vertex scratch memory
+    if (!initFrameArena(frameArena, FRAME_ARENA_CAPACITY))
     {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n"
-                  << infoLog << std::endl;
+        glfwTerminate();
+        return -1;
     }
 
-    // Link shaders
-    unsigned int shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
+    // Build and compile our shader program (reusing a cached binary when possible)
+    initShaderCache("shader_cache", (GLADloadproc)glfwGetProcAddress);
+    unsigned int shaderProgram = buildShaderProgram("main", vertexShaderSource, fragmentShaderSource);
 
-    // Check for linking errors
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success)
+    // Everything drawn with this program goes through one batched vertex
+    // buffer. Both matrices are constant, so they are set once here rather
+    // than every frame.
+    initDrawBatch(drawBatch, shaderProgram, frameArena);
+    glUseProgram(shaderProgram);
+    glm::mat4 projection = glm::ortho(-1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f);
+    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+    glm::mat4 model = glm::mat4(1.0f);
+    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
+
+    // Static UI lives in the retained scene; built on the first frame
+    initRetainedScene(uiScene, UI_ITEM_COUNT);
+
+    // Initialize balls
+    initBalls(redSim, 5, 0);
+    if (nbodyStart)
     {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n"
-                  << infoLog << std::endl;
+        initBalls(redSim, nbodyCount, 0);
+        startNbody();
     }
 
-    // Delete shaders as they're linked into our program now and no longer necessary
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    // Initialize squares with equal mass
+    initSquareMasses(blueSim, 1.0f);
+    resetSquares(blueSim);
 
-    // Create vertex data for buttons (6 vertices per button, 6 floats per vertex)
-    float buttonVertices[NUM_BUTTONS * 6 * 6]; // 6 vertices * 6 floats per vertex * num buttons
-    int vertexIndex = 0;
+    // Initialize Newton's Cradle
+    initNewtonsCradle(greenSim);
 
-    for (int i = 0; i < NUM_BUTTONS; i++)
+    // Initialize Fluid Demo
+    initFluidDemo(yellowSim, 0);
+    if (nacaDesignation && !parseNacaDesignation(nacaDesignation, yellowSim.airfoil))
+        std::cerr << "Invalid NACA designation " << nacaDesignation << ", using 0040" << std::endl;
+    yellowSim.airfoil.angleOfAttack = glm::radians(angleOfAttackDegrees);
+    if (obstaclePath)
     {
-        createRectangle(buttons[i].x, buttons[i].y, buttons[i].width, buttons[i].height, buttons[i].color, buttonVertices, vertexIndex);
+        if (loadObstaclePolygon(obstaclePath, obstaclePolygon))
+        {
+            yellowSim.polygon = &obstaclePolygon;
+            yellowSim.shape = ObstacleShape::POLYGON;
+        }
+        else
+            std::cerr << "Could not load obstacle " << obstaclePath << std::endl;
     }
-
-    // Back button vertex data
-    float backButtonVertices[6 * 6];
-    int backVertexIndex = 0;
-    createRectangle(backButton.x, backButton.y, backButton.width, backButton.height, backButton.color, backButtonVertices, backVertexIndex);
-
-    // Box walls vertex data (4 walls)
-    float boxVertices[4 * 6 * 6]; // 4 walls * 6 vertices * 6 floats per vertex
-    int boxVertexIndex = 0;
-
-    // Top wall
-    createRectangle(BOX_LEFT, BOX_TOP - 0.02f, BOX_RIGHT - BOX_LEFT, 0.02f, glm::vec3(1.0f, 1.0f, 1.0f), boxVertices, boxVertexIndex);
-    // Bottom wall
-    createRectangle(BOX_LEFT, BOX_BOTTOM, BOX_RIGHT - BOX_LEFT, 0.02f, glm::vec3(1.0f, 1.0f, 1.0f), boxVertices, boxVertexIndex);
-    // Left wall
-    createRectangle(BOX_LEFT, BOX_BOTTOM, 0.02f, BOX_TOP - BOX_BOTTOM, glm::vec3(1.0f, 1.0f, 1.0f), boxVertices, boxVertexIndex);
-    // Right wall
-    createRectangle(BOX_RIGHT - 0.02f, BOX_BOTTOM, 0.02f, BOX_TOP - BOX_BOTTOM, glm::vec3(1.0f, 1.0f, 1.0f), boxVertices, boxVertexIndex);
-
-    // Ball vertex data (will be updated each frame)
-    float ballVertices[MAX_BALLS * 32 * 3 * 6]; // MAX_BALLS * 32 segments * 3 vertices * 6 floats per vertex
-    int ballVertexIndex = 0;
-    for (int i = 0; i < NUM_BALLS; i++)
+    if (obstacleLayoutPath && !loadObstacleLayout(obstacleLayoutPath, yellowSim.obstacles, layoutPolygons))
     {
-        createCircle(balls[i].x, balls[i].y, balls[i].radius, balls[i].color, ballVertices, ballVertexIndex);
+        std::cerr << "Could not load obstacle layout " << obstacleLayoutPath << std::endl;
+        yellowSim.obstacles.clear();
     }
 
-    // Square vertex data (will be updated each frame)
-    float squareVertices[NUM_SQUARES * 6 * 6]; // NUM_SQUARES * 6 vertices * 6 floats per vertex
-    int squareVertexIndex = 0;
-    for (int i = 0; i < NUM_SQUARES; i++)
+    // Optional GPU fluid backend, falls back to the CPU update if unavailable.
+    // Distance fields are rebuilt when the obstacle geometry's version moves on.
+    unsigned int gpuSdfVersion = 0;
+    if (useGpuFluid)
     {
-        createSquareVertices(squares[i].x, squares[i].y, squares[i].size, squares[i].color, squareVertices, squareVertexIndex);
+        if (initGpuFluid(gpuFluid, MAX_FLUID_PARTICLES))
+        {
+            buildObstacleSdf();
+            uploadGpuFluidSdf(gpuFluid, obstacleSdf, OBSTACLE_SDF_WIDTH, OBSTACLE_SDF_HEIGHT, BOX_LEFT, BOX_BOTTOM, BOX_RIGHT, BOX_TOP);
+            gpuSdfVersion = yellowSim.obstacleVersion;
+            std::cout << "Using GPU fluid backend (" << glGetString(GL_RENDERER) << ")" << std::endl;
+        }
+        else
+        {
+            std::cerr << "GPU fluid backend unavailable, using CPU update" << std::endl;
+            useGpuFluid = false;
+        }
     }
+    GpuFluidParams gpuFluidParams = {BOX_LEFT, BOX_RIGHT, BOX_BOTTOM, BOX_TOP, yellowSim.streamSpeed, yellowSim.obstacleX, yellowSim.obstacleY, 0.008f};
 
-    // Create pendulum string vertex data
-    float pendulumStringVertices[NUM_PENDULUMS * 6 * 6]; // NUM_PENDULUMS * 6 vertices * 6 floats per vertex
-    int pendulumStringVertexIndex = 0;
-    for (int i = 0; i < NUM_PENDULUMS; i++)
+    // Optional grid solver for the CPU update
+    unsigned int stableFluidVersion = 0;
+    if (useStableFluid && !useGpuFluid)
     {
-        createPendulumString(pendulums[i].x, pendulums[i].y, pendulums[i].x + pendulums[i].length * sin(pendulums[i].angle), pendulums[i].y - pendulums[i].length * cos(pendulums[i].angle), pendulums[i].color, pendulumStringVertices, pendulumStringVertexIndex);
+        int threads = selectTunedVariant(stableFluidKernel, stableFluidWidth) == KERNEL_SERIAL ? 1 : 0;
+        initStableFluid(stableFluid, stableFluidWidth, BOX_LEFT, BOX_BOTTOM, BOX_RIGHT, BOX_TOP, threads);
+        buildObstacleSdf();
+        setStableFluidObstacle(stableFluid, obstacleSdf, OBSTACLE_SDF_WIDTH, OBSTACLE_SDF_HEIGHT, BOX_LEFT, BOX_BOTTOM, BOX_RIGHT, BOX_TOP);
+        stableFluidVersion = yellowSim.obstacleVersion;
+        std::cout << "Using " << stableFluid.width << "x" << stableFluid.height << " stable-fluids grid" << std::endl;
+        flowLineParams.stepSize = FLOW_LINE_STEP_CELLS * stableFluid.cellSize;
+        initFlowLines(flowLines, flowLineParams, BOX_LEFT, BOX_BOTTOM, BOX_RIGHT, BOX_TOP);
+    }
+    else
+    {
+        useStableFluid = false;
     }
 
-    // Vertex Buffer Object (VBO) and Vertex Array Object (VAO) for main menu buttons
-    unsigned int VBO, VAO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(buttonVertices), buttonVertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-
-    // VBO/VAO for back button
-    unsigned int backVBO, backVAO;
-    glGenVertexArrays(1, &backVAO);
-    glGenBuffers(1, &backVBO);
-    glBindVertexArray(backVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, backVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(backButtonVertices), backButtonVertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-
-    // VBO/VAO for box walls
-    unsigned int boxVBO, boxVAO;
-    glGenVertexArrays(1, &boxVAO);
-    glGenBuffers(1, &boxVBO);
-    glBindVertexArray(boxVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, boxVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(boxVertices), boxVertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-
-    // VBO/VAO for ball (dynamic)
-    unsigned int ballVBO, ballVAO;
-    glGenVertexArrays(1, &ballVAO);
-    glGenBuffers(1, &ballVBO);
-    glBindVertexArray(ballVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, ballVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(ballVertices), ballVertices, GL_DYNAMIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-
-    // VBO/VAO for square (dynamic)
-    unsigned int squareVBO, squareVAO;
-    glGenVertexArrays(1, &squareVAO);
-    glGenBuffers(1, &squareVBO);
-    glBindVertexArray(squareVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, squareVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(squareVertices), squareVertices, GL_DYNAMIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-
-    // VBO/VAO for pendulum string
-    unsigned int pendulumStringVBO, pendulumStringVAO;
-    glGenVertexArrays(1, &pendulumStringVAO);
-    glGenBuffers(1, &pendulumStringVBO);
-    glBindVertexArray(pendulumStringVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, pendulumStringVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(pendulumStringVertices), pendulumStringVertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-
-    // Get uniform locations
-    unsigned int modelLoc = glGetUniformLocation(shaderProgram, "model");
-    unsigned int projectionLoc = glGetUniformLocation(shaderProgram, "projection");
-
-    // Initialize balls
-    initBalls(5);
-
-    // Initialize squares with equal mass
-    initSquareMasses(1.0f);
-    resetSquares();
+    // Zone timeline for --profile (debug builds only)
+    if (profilePath)
+    {
+        profilerSetThreadName("main");
+        startProfiler();
+    }
 
-    // Initialize Newton's Cradle
-    initNewtonsCradle();
+    // Fixed-size demo state lives for the whole run
+    memoryAllocated(MEMORY_SQUARES, sizeof(blueSim));
+    memoryAllocated(MEMORY_CRADLE, sizeof(greenSim));
+    memoryAllocated(MEMORY_FLUID_PARTICLES, sizeof(yellowSim.particles));
+    memoryAllocated(MEMORY_OBSTACLES, sizeof(obstacleSdf));
 
-    // Initialize Fluid Demo
-    initFluidDemo();
+    // Conservation monitors drain on their own thread
+    initTelemetry(telemetryPath);
 
     // Render loop
     while (!glfwWindowShouldClose(window))
     {
-        // Input
-        processInput(window);
+        PROFILE_ZONE("Frame");
 
-        // Update physics
-        if (currentScreen == Screen::RED_DEMO)
+        // Release last frame's vertex scratch memory
+        resetFrameArena(frameArena);
+        beginRenderStats();
+
+        // Input. In low-latency mode events are polled here, just before the
+        // step, rather than after the previous swap.
+        PROFILE_BEGIN("Input");
+        if (lowLatency)
+            glfwPollEvents();
+        processInput(window);
+        pollLatencyQueries();
+        PROFILE_END();
+
+        // Step boundary: apply queued UI commands before stepping
+        PROFILE_BEGIN("Commands");
+        applyPendingCommands();
+        PROFILE_END();
+
+        // Update physics, noting whether anything visible changed
+        bool changed = sceneDirty;
+        sceneDirty = false;
+        bool stepping = !paused && currentScreen != Screen::MAIN_MENU;
+        if (stepping)
+            simulationStep++;
+        PROFILE_BEGIN("Update");
+        if (paused)
+        {
+            // Nothing moves while paused
+        }
+        else if (currentScreen == Screen::RED_DEMO)
         {
-            updateBall();
+            changed |= updateBall(redSim);
+            recordTelemetry((int)currentScreen, simulationStep, telemetryRestart, redSim.stats);
         }
         else if (currentScreen == Screen::BLUE_DEMO)
         {
-            updateSquare();
+            changed |= updateSquare(blueSim);
+            recordTelemetry((int)currentScreen, simulationStep, telemetryRestart, blueSim.stats);
         }
         else if (currentScreen == Screen::GREEN_DEMO)
         {
-            updateNewtonsCradle();
+            changed |= updateNewtonsCradle(greenSim);
+            recordTelemetry((int)currentScreen, simulationStep, telemetryRestart, greenSim.stats);
         }
         else if (currentScreen == Screen::YELLOW_DEMO)
         {
-            updateFluidDemo();
+            if (useGpuFluid)
+            {
+                // Rebuild the distance field only when the obstacle changes
+                updateFluidObstacle(yellowSim);
+                if (gpuSdfVersion != yellowSim.obstacleVersion)
+                {
+                    buildObstacleSdf();
+                    uploadGpuFluidSdf(gpuFluid, obstacleSdf, OBSTACLE_SDF_WIDTH, OBSTACLE_SDF_HEIGHT, BOX_LEFT, BOX_BOTTOM, BOX_RIGHT, BOX_TOP);
+                    gpuSdfVersion = yellowSim.obstacleVersion;
+                }
+                gpuFluidParams.streamSpeed = yellowSim.streamSpeed;
+                gpuFluidParams.obstacleX = yellowSim.obstacleX;
+                gpuFluidParams.obstacleY = yellowSim.obstacleY;
+                updateGpuFluid(gpuFluid, gpuFluidParams);
+                changed = true;
+            }
+            else if (useStableFluid)
+            {
+                updateFluidObstacle(yellowSim);
+                if (stableFluidVersion != yellowSim.obstacleVersion)
+                {
+                    buildObstacleSdf();
+                    setStableFluidObstacle(stableFluid, obstacleSdf, OBSTACLE_SDF_WIDTH, OBSTACLE_SDF_HEIGHT, BOX_LEFT, BOX_BOTTOM, BOX_RIGHT, BOX_TOP);
+                    stableFluidVersion = yellowSim.obstacleVersion;
+                }
+                updateStableFluid(stableFluid, yellowSim.streamSpeed);
+                if (flowLineMode == FlowLineMode::STREAMLINES)
+                    traceStreamlines(flowLines, stableFluid, flowLineParams, yellowSim.streamSpeed);
+                else if (flowLineMode == FlowLineMode::STREAKLINES)
+                    advanceStreaklines(flowLines, stableFluid, flowLineParams);
+                changed |= updateFluidDemo(yellowSim, &stableFluid);
+                recordTelemetry((int)currentScreen, simulationStep, telemetryRestart, yellowSim.stats);
+            }
+            else
+            {
+                changed |= updateFluidDemo(yellowSim);
+                recordTelemetry((int)currentScreen, simulationStep, telemetryRestart, yellowSim.stats);
+            }
+        }
+        PROFILE_END();
+        if (stepping)
+            telemetryRestart = false;
+
+        // HUD in the window title, refreshed a few times per second. Memory is
+        // shown on every screen; conservation only for demos that record telemetry.
+        if (glfwGetTime() - hudTime >= HUD_INTERVAL)
+        {
+            hudTime = glfwGetTime();
+            if (currentScreen == Screen::MAIN_MENU)
+                conservationHud[0] = '\0';
+#if PHYSICS_TELEMETRY
+            if (stepping)
+            {
+                TelemetrySnapshot hud = telemetrySnapshot((int)currentScreen);
+                conservationHud[0] = '\0';
+                if (hud.valid)
+                    snprintf(conservationHud, sizeof(conservationHud), " | E %.4g (drift %+.3f%%) | p (%.3g, %.3g) drift (%.2g, %.2g) | penetration %.3g",
+                             hud.latest.stats.kinetic + hud.latest.stats.potential, hud.energyDrift * 100.0f,
+                             hud.latest.stats.momentumX, hud.latest.stats.momentumY, hud.momentumDriftX, hud.momentumDriftY,
+                             hud.maxPenetration);
+            }
+#endif
+            char memory[320];
+            formatMemorySummary(memory, sizeof(memory));
+            char title[640];
+            snprintf(title, sizeof(title), "Physics Demo Suite%s | mem %s", conservationHud, memory);
+            glfwSetWindowTitle(window, title);
+        }
+
+        // Skip clear, draw and swap when the last presented frame is still valid.
+        // Block until input on static screens; a running demo that has settled
+        // keeps stepping, but only a few times per second. While capturing
+        // every frame is drawn so the video keeps a steady frame rate.
+        bool replayPending = replayIndex < replayCommands.size();
+        if (!changed && !replayPending && !capturePath)
+        {
+            if (!stepping)
+                glfwWaitEvents();
+            else
+                glfwWaitEventsTimeout(IDLE_WAIT_TIMEOUT);
+            continue;
         }
 
         // Render
+        PROFILE_BEGIN("Render");
+        if (uiScene.dirty)
+        {
+            buildUiScene();
+            setDrawBatchScene(drawBatch, uiScene);
+        }
+        beginDrawBatch(drawBatch);
         if (currentScreen == Screen::MAIN_MENU)
         {
             // Set clear color (black background)
@@ -1475,13 +1376,7 @@ int main()
             glClear(GL_COLOR_BUFFER_BIT);
 
             // Draw the buttons
-            glUseProgram(shaderProgram);
-            glm::mat4 projection = glm::ortho(-1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f);
-            glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-            glm::mat4 model = glm::mat4(1.0f);
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-            glBindVertexArray(VAO);
-            glDrawArrays(GL_TRIANGLES, 0, NUM_BUTTONS * 6); // 6 vertices per button
+            batchSceneItem(drawBatch, UI_MENU_BUTTONS);
         }
         else if (currentScreen == Screen::RED_DEMO)
         {
@@ -1489,54 +1384,41 @@ int main()
             glClearColor(0.0f, 0.0f, 0.0f, 1.0f); // Black background
             glClear(GL_COLOR_BUFFER_BIT);
 
-            glUseProgram(shaderProgram);
-            glm::mat4 projection = glm::ortho(-1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f);
-            glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-            glm::mat4 model = glm::mat4(1.0f);
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-
             // Draw box walls
-            glBindVertexArray(boxVAO);
-            glDrawArrays(GL_TRIANGLES, 0, 4 * 6); // 4 walls * 6 vertices
+            batchSceneItem(drawBatch, UI_BOX_WALLS);
 
             // Draw ball count buttons
-            float ballCountButtonVertices[NUM_BALL_COUNT_BUTTONS * 6 * 6];
-            int bcVertexIndex = 0;
-            for (int i = 0; i < NUM_BALL_COUNT_BUTTONS; i++)
+            batchSceneItem(drawBatch, UI_BALL_COUNT_BUTTONS);
+
+            // Update and draw all balls; N-body mode draws one point per body
+            if (redSim.gravity)
             {
-                glm::vec3 color = glm::vec3(0.3f, 0.3f, 0.3f);
-                createRectangle(ballCountButtons[i].x, ballCountButtons[i].y, ballCountButtons[i].width, ballCountButtons[i].height, color, ballCountButtonVertices, bcVertexIndex);
+                float *bodyVertices = beginBatchItem(drawBatch, (int)redSim.balls.size());
+                int bodyVertexIndex = 0;
+                for (const Ball &b : redSim.balls)
+                {
+                    bodyVertices[bodyVertexIndex++] = b.x;
+                    bodyVertices[bodyVertexIndex++] = b.y;
+                    bodyVertices[bodyVertexIndex++] = 0.0f;
+                    bodyVertices[bodyVertexIndex++] = b.color.r;
+                    bodyVertices[bodyVertexIndex++] = b.color.g;
+                    bodyVertices[bodyVertexIndex++] = b.color.b;
+                }
+                endBatchItem(drawBatch, GL_POINTS, bodyVertexIndex);
             }
-            unsigned int bcVBO, bcVAO;
-            glGenVertexArrays(1, &bcVAO);
-            glGenBuffers(1, &bcVBO);
-            glBindVertexArray(bcVAO);
-            glBindBuffer(GL_ARRAY_BUFFER, bcVBO);
-            glBufferData(GL_ARRAY_BUFFER, sizeof(ballCountButtonVertices), ballCountButtonVertices, GL_STATIC_DRAW);
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
-            glEnableVertexAttribArray(0);
-            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
-            glEnableVertexAttribArray(1);
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
-            glBindVertexArray(bcVAO);
-            glDrawArrays(GL_TRIANGLES, 0, NUM_BALL_COUNT_BUTTONS * 6);
-            glDeleteVertexArrays(1, &bcVAO);
-            glDeleteBuffers(1, &bcVBO);
-
-            // Update and draw all balls
-            ballVertexIndex = 0;
-            for (int i = 0; i < NUM_BALLS; i++)
+            else
             {
-                createCircle(balls[i].x, balls[i].y, balls[i].radius, balls[i].color, ballVertices, ballVertexIndex);
+                float *ballVertices = beginBatchItem(drawBatch, (int)redSim.balls.size() * CIRCLE_MAX_SEGMENTS * 3);
+                int ballVertexIndex = 0;
+                for (int i = 0; i < (int)redSim.balls.size(); i++)
+                {
+                    createCircle(redSim.balls[i].x, redSim.balls[i].y, redSim.balls[i].radius, redSim.balls[i].color, ballVertices, ballVertexIndex);
+                }
+                endBatchItem(drawBatch, GL_TRIANGLES, ballVertexIndex);
             }
-            glBindVertexArray(ballVAO);
-            glBindBuffer(GL_ARRAY_BUFFER, ballVBO);
-            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(ballVertices), ballVertices);
-            glDrawArrays(GL_TRIANGLES, 0, NUM_BALLS * 32 * 3); // NUM_BALLS * 32 segments * 3 vertices
 
             // Draw back button
-            glBindVertexArray(backVAO);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+            batchSceneItem(drawBatch, UI_BACK_BUTTON);
         }
         else if (currentScreen == Screen::BLUE_DEMO)
         {
@@ -1544,361 +1426,151 @@ int main()
             glClearColor(0.0f, 0.0f, 0.0f, 1.0f); // Black background
             glClear(GL_COLOR_BUFFER_BIT);
 
-            glUseProgram(shaderProgram);
-            glm::mat4 projection = glm::ortho(-1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f);
-            glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-            glm::mat4 model = glm::mat4(1.0f);
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-
             // Draw box walls
-            glBindVertexArray(boxVAO);
-            glDrawArrays(GL_TRIANGLES, 0, 4 * 6); // 4 walls * 6 vertices
+            batchSceneItem(drawBatch, UI_BOX_WALLS);
 
             // Draw mass buttons
-            float massButtonVertices[NUM_MASS_BUTTONS * 6 * 6];
-            int mbVertexIndex = 0;
-            for (int i = 0; i < NUM_MASS_BUTTONS; i++)
-            {
-                glm::vec3 color = glm::vec3(0.3f, 0.3f, 0.3f);
-                createRectangle(massButtons[i].x, massButtons[i].y, massButtons[i].width, massButtons[i].height, color, massButtonVertices, mbVertexIndex);
-            }
-            unsigned int mbVBO, mbVAO;
-            glGenVertexArrays(1, &mbVAO);
-            glGenBuffers(1, &mbVBO);
-            glBindVertexArray(mbVAO);
-            glBindBuffer(GL_ARRAY_BUFFER, mbVBO);
-            glBufferData(GL_ARRAY_BUFFER, sizeof(massButtonVertices), massButtonVertices, GL_STATIC_DRAW);
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
-            glEnableVertexAttribArray(0);
-            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
-            glEnableVertexAttribArray(1);
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
-            glBindVertexArray(mbVAO);
-            glDrawArrays(GL_TRIANGLES, 0, NUM_MASS_BUTTONS * 6);
-            glDeleteVertexArrays(1, &mbVAO);
-            glDeleteBuffers(1, &mbVBO);
+            batchSceneItem(drawBatch, UI_MASS_BUTTONS);
 
             // Update and draw all squares
-            squareVertexIndex = 0;
+            float *squareVertices = beginBatchItem(drawBatch, NUM_SQUARES * 6);
+            int squareVertexIndex = 0;
             for (int i = 0; i < NUM_SQUARES; i++)
             {
-                createSquareVertices(squares[i].x, squares[i].y, squares[i].size, squares[i].color, squareVertices, squareVertexIndex);
+                createSquareVertices(blueSim.squares[i].x, blueSim.squares[i].y, blueSim.squares[i].size, blueSim.squares[i].color, squareVertices, squareVertexIndex);
             }
-            glBindVertexArray(squareVAO);
-            glBindBuffer(GL_ARRAY_BUFFER, squareVBO);
-            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(squareVertices), squareVertices);
-            glDrawArrays(GL_TRIANGLES, 0, NUM_SQUARES * 6); // NUM_SQUARES * 6 vertices for squares
+            endBatchItem(drawBatch, GL_TRIANGLES, squareVertexIndex);
 
             // Draw back button
-            glBindVertexArray(backVAO);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+            batchSceneItem(drawBatch, UI_BACK_BUTTON);
         }
-        else
+        else if (currentScreen == Screen::GREEN_DEMO)
         {
-            // Other demo screens
-            glm::vec3 demoColor;
-            const char *demoName;
-            // Declare all variables needed for GREEN_DEMO rendering here to avoid C++ jump-to-case errors
-            float stringVertices[NUM_PENDULUMS * 2 * 6];
+            // Newton's Cradle demo
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f); // Black background
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            // Draw pendulum strings as lines. They go first so the remaining
+            // triangles form a single run; nothing else overlaps them except
+            // the bobs, which are drawn on top either way.
+            float *stringVertices = beginBatchItem(drawBatch, NUM_PENDULUMS * 2);
             int stringVertexIndex = 0;
-            float pendulumBobVertices[NUM_PENDULUMS * 32 * 3 * 6];
-            int pendulumBobVertexIndex = 0;
-            unsigned int pbVBO = 0, pbVAO = 0, strVBO = 0, strVAO = 0;
-            glm::mat4 projection;
-            glm::mat4 model;
+            for (int i = 0; i < NUM_PENDULUMS; i++)
+            {
+                float anchorX = greenSim.pendulums[i].x;
+                float anchorY = greenSim.pendulums[i].y;
+                float bobX = greenSim.pendulums[i].x + greenSim.pendulums[i].length * sin(greenSim.pendulums[i].angle);
+                float bobY = greenSim.pendulums[i].y - greenSim.pendulums[i].length * cos(greenSim.pendulums[i].angle);
+                glm::vec3 color = glm::vec3(1.0f, 1.0f, 1.0f); // White string
+                pushVertex(stringVertices, stringVertexIndex, anchorX, anchorY, color);
+                pushVertex(stringVertices, stringVertexIndex, bobX, bobY, color);
+            }
+            endBatchItem(drawBatch, GL_LINES, stringVertexIndex);
 
-            switch (currentScreen)
+            // Draw box walls
+            batchSceneItem(drawBatch, UI_BOX_WALLS);
+
+            // Draw pendulum bobs as green balls
+            float *pendulumBobVertices = beginBatchItem(drawBatch, NUM_PENDULUMS * CIRCLE_MAX_SEGMENTS * 3);
+            int pendulumBobVertexIndex = 0;
+            for (int i = 0; i < NUM_PENDULUMS; i++)
             {
-            case Screen::GREEN_DEMO:
+                float bobX = greenSim.pendulums[i].x + greenSim.pendulums[i].length * sin(greenSim.pendulums[i].angle);
+                float bobY = greenSim.pendulums[i].y - greenSim.pendulums[i].length * cos(greenSim.pendulums[i].angle);
+                createCircle(bobX, bobY, greenSim.pendulums[i].radius, glm::vec3(0.0f, 1.0f, 0.0f), pendulumBobVertices, pendulumBobVertexIndex);
+            }
+            endBatchItem(drawBatch, GL_TRIANGLES, pendulumBobVertexIndex);
+
+            // Draw back button
+            batchSceneItem(drawBatch, UI_BACK_BUTTON);
+
+            // Draw reset button
+            batchSceneItem(drawBatch, UI_RESET_BUTTON);
+        }
+        else if (currentScreen == Screen::YELLOW_DEMO)
+        {
+            // Fluid Flow demo
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f); // Black background
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            // Vorticity of the grid flow, averaged over blocks: red counter-clockwise, blue clockwise
+            if (useStableFluid)
             {
-                // Newton's Cradle demo
-                glClearColor(0.0f, 0.0f, 0.0f, 1.0f); // Black background
-                glClear(GL_COLOR_BUFFER_BIT);
-
-                glUseProgram(shaderProgram);
-                projection = glm::ortho(-1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f);
-                glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-                model = glm::mat4(1.0f);
-                glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-
-                // Draw box walls (reuse boxVAO)
-                glBindVertexArray(boxVAO);
-                glDrawArrays(GL_TRIANGLES, 0, 4 * 6); // 4 walls * 6 vertices
-
-                // Draw pendulum strings as lines
-                stringVertexIndex = 0;
-                for (int i = 0; i < NUM_PENDULUMS; i++)
-                {
-                    float anchorX = pendulums[i].x;
-                    float anchorY = pendulums[i].y;
-                    float bobX = pendulums[i].x + pendulums[i].length * sin(pendulums[i].angle);
-                    float bobY = pendulums[i].y - pendulums[i].length * cos(pendulums[i].angle);
-                    glm::vec3 color = glm::vec3(1.0f, 1.0f, 1.0f); // White string
-                    // Anchor point
-                    stringVertices[stringVertexIndex++] = anchorX;
-                    stringVertices[stringVertexIndex++] = anchorY;
-                    stringVertices[stringVertexIndex++] = 0.0f;
-                    stringVertices[stringVertexIndex++] = color.r;
-                    stringVertices[stringVertexIndex++] = color.g;
-                    stringVertices[stringVertexIndex++] = color.b;
-                    // Bob point
-                    stringVertices[stringVertexIndex++] = bobX;
-                    stringVertices[stringVertexIndex++] = bobY;
-                    stringVertices[stringVertexIndex++] = 0.0f;
-                    stringVertices[stringVertexIndex++] = color.r;
-                    stringVertices[stringVertexIndex++] = color.g;
-                    stringVertices[stringVertexIndex++] = color.b;
-                }
-                glGenVertexArrays(1, &strVAO);
-                glGenBuffers(1, &strVBO);
-                glBindVertexArray(strVAO);
-                glBindBuffer(GL_ARRAY_BUFFER, strVBO);
-                glBufferData(GL_ARRAY_BUFFER, sizeof(stringVertices), stringVertices, GL_STATIC_DRAW);
-                glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
-                glEnableVertexAttribArray(0);
-                glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
-                glEnableVertexAttribArray(1);
-                glBindBuffer(GL_ARRAY_BUFFER, 0);
-                glBindVertexArray(strVAO);
-                glDrawArrays(GL_LINES, 0, NUM_PENDULUMS * 2);
-                glDeleteVertexArrays(1, &strVAO);
-                glDeleteBuffers(1, &strVBO);
-
-                // Draw pendulum bobs as green balls
-                pendulumBobVertexIndex = 0;
-                for (int i = 0; i < NUM_PENDULUMS; i++)
+                int blocksX = stableFluid.width / STABLE_FLUID_OVERLAY_BLOCK;
+                int blocksY = stableFluid.height / STABLE_FLUID_OVERLAY_BLOCK;
+                float blockSize = stableFluid.cellSize * STABLE_FLUID_OVERLAY_BLOCK;
+                float *overlayVertices = beginBatchItem(drawBatch, blocksX * blocksY * 6);
+                int overlayIndex = 0;
+                for (int by = 0; by < blocksY; by++)
                 {
-                    float bobX = pendulums[i].x + pendulums[i].length * sin(pendulums[i].angle);
-                    float bobY = pendulums[i].y - pendulums[i].length * cos(pendulums[i].angle);
-                    createCircle(bobX, bobY, pendulums[i].radius, glm::vec3(0.0f, 1.0f, 0.0f), pendulumBobVertices, pendulumBobVertexIndex);
+                    for (int bx = 0; bx < blocksX; bx++)
+                    {
+                        float sum = 0.0f;
+                        for (int j = by * STABLE_FLUID_OVERLAY_BLOCK; j < (by + 1) * STABLE_FLUID_OVERLAY_BLOCK; j++)
+                            for (int i = bx * STABLE_FLUID_OVERLAY_BLOCK; i < (bx + 1) * STABLE_FLUID_OVERLAY_BLOCK; i++)
+                                sum += stableFluid.vorticity[j * stableFluid.width + i];
+                        float vorticity = sum / (STABLE_FLUID_OVERLAY_BLOCK * STABLE_FLUID_OVERLAY_BLOCK);
+                        float intensity = std::min(std::fabs(vorticity) / STABLE_FLUID_VORTICITY_SCALE, 1.0f) * 0.6f;
+                        if (intensity < 0.02f)
+                            continue;
+                        glm::vec3 color = vorticity > 0.0f ? glm::vec3(intensity, 0.0f, 0.0f) : glm::vec3(0.0f, 0.0f, intensity);
+                        createRectangle(stableFluid.minX + bx * blockSize, stableFluid.minY + by * blockSize, blockSize, blockSize, color, overlayVertices, overlayIndex);
+                    }
                 }
-                glGenVertexArrays(1, &pbVAO);
-                glGenBuffers(1, &pbVBO);
-                glBindVertexArray(pbVAO);
-                glBindBuffer(GL_ARRAY_BUFFER, pbVBO);
-                glBufferData(GL_ARRAY_BUFFER, sizeof(pendulumBobVertices), pendulumBobVertices, GL_STATIC_DRAW);
-                glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
-                glEnableVertexAttribArray(0);
-                glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
-                glEnableVertexAttribArray(1);
-                glBindBuffer(GL_ARRAY_BUFFER, 0);
-                glBindVertexArray(pbVAO);
-                glDrawArrays(GL_TRIANGLES, 0, NUM_PENDULUMS * 32 * 3);
-                glDeleteVertexArrays(1, &pbVAO);
-                glDeleteBuffers(1, &pbVBO);
-
-                // Draw back button
-                glBindVertexArray(backVAO);
-                glDrawArrays(GL_TRIANGLES, 0, 6);
-
-                // Draw reset button
-                float resetButtonVertices[6 * 6];
-                int resetVertexIndex = 0;
-                createRectangle(resetButton.x, resetButton.y, resetButton.width, resetButton.height, glm::vec3(0.3f, 0.3f, 0.3f), resetButtonVertices, resetVertexIndex);
-                unsigned int resetVBO, resetVAO;
-                glGenVertexArrays(1, &resetVAO);
-                glGenBuffers(1, &resetVBO);
-                glBindVertexArray(resetVAO);
-                glBindBuffer(GL_ARRAY_BUFFER, resetVBO);
-                glBufferData(GL_ARRAY_BUFFER, sizeof(resetButtonVertices), resetButtonVertices, GL_STATIC_DRAW);
-                glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
-                glEnableVertexAttribArray(0);
-                glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
-                glEnableVertexAttribArray(1);
-                glBindBuffer(GL_ARRAY_BUFFER, 0);
-                glBindVertexArray(resetVAO);
-                glDrawArrays(GL_TRIANGLES, 0, 6);
-                glDeleteVertexArrays(1, &resetVAO);
-                glDeleteBuffers(1, &resetVBO);
-                break;
+                endBatchItem(drawBatch, GL_TRIANGLES, overlayIndex);
             }
-            case Screen::YELLOW_DEMO:
+
+            // Draw box walls
+            batchSceneItem(drawBatch, UI_BOX_WALLS);
+
+            // Draw shape buttons
+            batchSceneItem(drawBatch, UI_SHAPE_BUTTONS);
+
+            // Draw obstacle based on current shape
+            batchSceneItem(drawBatch, UI_OBSTACLE);
+
+            // Flow lines: one item holding a line strip per seed, uploaded in one go
+            if (flowLineMode != FlowLineMode::NONE)
             {
-                // Fluid Flow demo
-                glClearColor(0.0f, 0.0f, 0.0f, 1.0f); // Black background
-                glClear(GL_COLOR_BUFFER_BIT);
-
-                glUseProgram(shaderProgram);
-                glm::mat4 projection = glm::ortho(-1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f);
-                glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-                glm::mat4 model = glm::mat4(1.0f);
-                glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-
-                // Draw box walls (reuse boxVAO)
-                glBindVertexArray(boxVAO);
-                glDrawArrays(GL_TRIANGLES, 0, 4 * 6); // 4 walls * 6 vertices
-
-                // Draw shape buttons
-                float shapeButtonVertices[NUM_SHAPE_BUTTONS * 6 * 6];
-                int shbVertexIndex = 0;
-                for (int i = 0; i < NUM_SHAPE_BUTTONS; i++)
+                glm::vec3 lineColor = flowLineMode == FlowLineMode::STREAMLINES ? glm::vec3(0.3f, 0.55f, 0.7f) : glm::vec3(0.7f, 0.6f, 0.2f);
+                int *lineCounts = frameArenaAlloc<int>(frameArena, flowLines.seedCount);
+                int totalPoints = 0;
+                for (int s = 0; s < flowLines.seedCount; s++)
                 {
-                    glm::vec3 color = glm::vec3(0.4f, 0.4f, 0.4f);
-                    createRectangle(shapeButtons[i].x, shapeButtons[i].y, shapeButtons[i].width, shapeButtons[i].height, color, shapeButtonVertices, shbVertexIndex);
+                    lineCounts[s] = flowLines.counts[s] >= 2 ? flowLines.counts[s] : 0;
+                    totalPoints += lineCounts[s];
                 }
-                unsigned int shbVBO, shbVAO;
-                glGenVertexArrays(1, &shbVAO);
-                glGenBuffers(1, &shbVBO);
-                glBindVertexArray(shbVAO);
-                glBindBuffer(GL_ARRAY_BUFFER, shbVBO);
-                glBufferData(GL_ARRAY_BUFFER, sizeof(shapeButtonVertices), shapeButtonVertices, GL_STATIC_DRAW);
-                glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
-                glEnableVertexAttribArray(0);
-                glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
-                glEnableVertexAttribArray(1);
-                glBindBuffer(GL_ARRAY_BUFFER, 0);
-                glBindVertexArray(shbVAO);
-                glDrawArrays(GL_TRIANGLES, 0, NUM_SHAPE_BUTTONS * 6);
-                glDeleteVertexArrays(1, &shbVAO);
-                glDeleteBuffers(1, &shbVBO);
-
-                // Draw obstacle based on current shape
-                switch (currentShape)
+                float *lineVertices = beginBatchItem(drawBatch, totalPoints);
+                int lineVertexIndex = 0;
+                for (int s = 0; s < flowLines.seedCount; s++)
                 {
-                case ObstacleShape::BALL:
-                {
-                    // Draw circle
-                    float obstacleVertices[32 * 3 * 6];
-                    int obstacleVertexIndex = 0;
-                    createCircle(obstacleX, obstacleY, obstacleRadius, glm::vec3(0.8f, 0.8f, 0.8f), obstacleVertices, obstacleVertexIndex);
-                    unsigned int obsVBO, obsVAO;
-                    glGenVertexArrays(1, &obsVAO);
-                    glGenBuffers(1, &obsVBO);
-                    glBindVertexArray(obsVAO);
-                    glBindBuffer(GL_ARRAY_BUFFER, obsVBO);
-                    glBufferData(GL_ARRAY_BUFFER, sizeof(obstacleVertices), obstacleVertices, GL_STATIC_DRAW);
-                    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
-                    glEnableVertexAttribArray(0);
-                    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
-                    glEnableVertexAttribArray(1);
-                    glBindBuffer(GL_ARRAY_BUFFER, 0);
-                    glBindVertexArray(obsVAO);
-                    glDrawArrays(GL_TRIANGLES, 0, 32 * 3);
-                    glDeleteVertexArrays(1, &obsVAO);
-                    glDeleteBuffers(1, &obsVBO);
-                    break;
-                }
-                case ObstacleShape::TRIANGLE:
-                {
-                    // Draw equilateral triangle sized to fit in a circle of radius obstacleRadius
-                    float size = obstacleRadius * 2.0f; // Side length
-                    float h = size * sqrt(3.0f) / 2.0f; // Height
-                    float v1x = obstacleX - size / 2.0f, v1y = obstacleY - h / 3.0f;
-                    float v2x = obstacleX + size / 2.0f, v2y = obstacleY - h / 3.0f;
-                    float v3x = obstacleX, v3y = obstacleY + 2.0f * h / 3.0f;
-                    float triangleVertices[3 * 6];
-                    int triVertexIndex = 0;
-                    // Draw as a filled triangle
-                    // Vertex 1
-                    triangleVertices[triVertexIndex++] = v1x;
-                    triangleVertices[triVertexIndex++] = v1y;
-                    triangleVertices[triVertexIndex++] = 0.0f;
-                    triangleVertices[triVertexIndex++] = 0.8f;
-                    triangleVertices[triVertexIndex++] = 0.8f;
-                    triangleVertices[triVertexIndex++] = 0.8f;
-                    // Vertex 2
-                    triangleVertices[triVertexIndex++] = v2x;
-                    triangleVertices[triVertexIndex++] = v2y;
-                    triangleVertices[triVertexIndex++] = 0.0f;
-                    triangleVertices[triVertexIndex++] = 0.8f;
-                    triangleVertices[triVertexIndex++] = 0.8f;
-                    triangleVertices[triVertexIndex++] = 0.8f;
-                    // Vertex 3
-                    triangleVertices[triVertexIndex++] = v3x;
-                    triangleVertices[triVertexIndex++] = v3y;
-                    triangleVertices[triVertexIndex++] = 0.0f;
-                    triangleVertices[triVertexIndex++] = 0.8f;
-                    triangleVertices[triVertexIndex++] = 0.8f;
-                    triangleVertices[triVertexIndex++] = 0.8f;
-                    unsigned int triVBO, triVAO;
-                    glGenVertexArrays(1, &triVAO);
-                    glGenBuffers(1, &triVBO);
-                    glBindVertexArray(triVAO);
-                    glBindBuffer(GL_ARRAY_BUFFER, triVBO);
-                    glBufferData(GL_ARRAY_BUFFER, sizeof(triangleVertices), triangleVertices, GL_STATIC_DRAW);
-                    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
-                    glEnableVertexAttribArray(0);
-                    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
-                    glEnableVertexAttribArray(1);
-                    glBindBuffer(GL_ARRAY_BUFFER, 0);
-                    glBindVertexArray(triVAO);
-                    glDrawArrays(GL_TRIANGLES, 0, 3);
-                    glDeleteVertexArrays(1, &triVAO);
-                    glDeleteBuffers(1, &triVBO);
-                    break;
-                }
-                case ObstacleShape::AIRFOIL:
-                {
-                    // Draw a smooth, centered airfoil (NACA 00xx symmetric)
-                    const int N = 40; // Number of points per surface
-                    float chord = obstacleRadius * 2.0f;
-                    float maxThickness = obstacleRadius * 0.8f;
-                    float airfoilVertices[(N * 2) * 6];
-                    int airfoilVertexIndex = 0;
-                    // Generate upper surface (x from -0.5 to 0.5)
-                    for (int i = 0; i < N; ++i)
-                    {
-                        float t = (float)i / (N - 1);
-                        float x = (t - 0.5f) * chord;
-                        float xc = t; // 0 to 1
-                        // NACA 00xx thickness formula
-                        float yt = 5.0f * maxThickness * (0.2969f * sqrt(xc) - 0.1260f * xc - 0.3516f * xc * xc + 0.2843f * xc * xc * xc - 0.1015f * xc * xc * xc * xc);
-                        float vx = obstacleX + x;
-                        float vy = obstacleY + yt;
-                        airfoilVertices[airfoilVertexIndex++] = vx;
-                        airfoilVertices[airfoilVertexIndex++] = vy;
-                        airfoilVertices[airfoilVertexIndex++] = 0.0f;
-                        airfoilVertices[airfoilVertexIndex++] = 0.8f;
-                        airfoilVertices[airfoilVertexIndex++] = 0.8f;
-                        airfoilVertices[airfoilVertexIndex++] = 0.8f;
-                    }
-                    // Generate lower surface (x from 0.5 to -0.5)
-                    for (int i = N - 1; i >= 0; --i)
-                    {
-                        float t = (float)i / (N - 1);
-                        float x = (t - 0.5f) * chord;
-                        float xc = t;
-                        float yt = 5.0f * maxThickness * (0.2969f * sqrt(xc) - 0.1260f * xc - 0.3516f * xc * xc + 0.2843f * xc * xc * xc - 0.1015f * xc * xc * xc * xc);
-                        float vx = obstacleX + x;
-                        float vy = obstacleY - yt;
-                        airfoilVertices[airfoilVertexIndex++] = vx;
-                        airfoilVertices[airfoilVertexIndex++] = vy;
-                        airfoilVertices[airfoilVertexIndex++] = 0.0f;
-                        airfoilVertices[airfoilVertexIndex++] = 0.8f;
-                        airfoilVertices[airfoilVertexIndex++] = 0.8f;
-                        airfoilVertices[airfoilVertexIndex++] = 0.8f;
-                    }
-                    // Draw as a triangle fan
-                    unsigned int airVBO, airVAO;
-                    glGenVertexArrays(1, &airVAO);
-                    glGenBuffers(1, &airVBO);
-                    glBindVertexArray(airVAO);
-                    glBindBuffer(GL_ARRAY_BUFFER, airVBO);
-                    glBufferData(GL_ARRAY_BUFFER, sizeof(airfoilVertices), airfoilVertices, GL_STATIC_DRAW);
-                    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
-                    glEnableVertexAttribArray(0);
-                    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
-                    glEnableVertexAttribArray(1);
-                    glBindBuffer(GL_ARRAY_BUFFER, 0);
-                    glBindVertexArray(airVAO);
-                    glDrawArrays(GL_TRIANGLE_FAN, 0, N * 2);
-                    glDeleteVertexArrays(1, &airVAO);
-                    glDeleteBuffers(1, &airVBO);
-                    break;
-                }
+                    const float *line = &flowLines.points[(size_t)s * flowLines.maxPoints * 2];
+                    for (int p = 0; p < lineCounts[s]; p++)
+                        pushVertex(lineVertices, lineVertexIndex, line[p * 2], line[p * 2 + 1], lineColor);
                 }
+                endBatchItemRuns(drawBatch, GL_LINE_STRIP, lineCounts, flowLines.seedCount);
+            }
 
-                // Draw fluid particles
-                float fluidParticleVertices[MAX_FLUID_PARTICLES * 32 * 3 * 6];
+            // Draw fluid particles
+            if (useGpuFluid)
+            {
+                // Particle state never leaves the GPU; it uses its own shader,
+                // so submit what is queued first
+                flushDrawBatch(drawBatch);
+                drawGpuFluid(gpuFluid, gpuFluidParams, glm::value_ptr(projection), windowHeight);
+            }
+            else
+            {
+                float *fluidParticleVertices = beginBatchItem(drawBatch, MAX_FLUID_PARTICLES * CIRCLE_MAX_SEGMENTS * 3);
                 int fluidVertexIndex = 0;
                 for (int i = 0; i < MAX_FLUID_PARTICLES; i++)
                 {
-                    if (fluidParticles[i].active)
+                    if (yellowSim.particles[i].active)
                     {
                         // Color particles by speed (laminar = blue, turbulent = red)
                         glm::vec3 particleColor;
-                        float speed = sqrt(fluidParticles[i].vx * fluidParticles[i].vx + fluidParticles[i].vy * fluidParticles[i].vy);
-                        if (speed < streamSpeed * 1.5f)
+                        float speed = sqrt(yellowSim.particles[i].vx * yellowSim.particles[i].vx + yellowSim.particles[i].vy * yellowSim.particles[i].vy);
+                        if (speed < yellowSim.streamSpeed * 1.5f)
                         {
                             particleColor = glm::vec3(0.0f, 0.5f, 1.0f); // Blue for laminar
                         }
@@ -1906,73 +1578,76 @@ int main()
                         {
                             particleColor = glm::vec3(1.0f, 0.3f, 0.0f); // Orange/red for turbulent
                         }
-                        createCircle(fluidParticles[i].x, fluidParticles[i].y, fluidParticles[i].radius, particleColor, fluidParticleVertices, fluidVertexIndex);
+                        createCircle(yellowSim.particles[i].x, yellowSim.particles[i].y, yellowSim.particles[i].radius, particleColor, fluidParticleVertices, fluidVertexIndex);
                     }
                 }
-                unsigned int fpVBO, fpVAO;
-                glGenVertexArrays(1, &fpVAO);
-                glGenBuffers(1, &fpVBO);
-                glBindVertexArray(fpVAO);
-                glBindBuffer(GL_ARRAY_BUFFER, fpVBO);
-                glBufferData(GL_ARRAY_BUFFER, sizeof(fluidParticleVertices), fluidParticleVertices, GL_STATIC_DRAW);
-                glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
-                glEnableVertexAttribArray(0);
-                glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
-                glEnableVertexAttribArray(1);
-                glBindBuffer(GL_ARRAY_BUFFER, 0);
-                glBindVertexArray(fpVAO);
-                glDrawArrays(GL_TRIANGLES, 0, fluidVertexIndex / 6);
-                glDeleteVertexArrays(1, &fpVAO);
-                glDeleteBuffers(1, &fpVBO);
-
-                // Draw back button
-                glBindVertexArray(backVAO);
-                glDrawArrays(GL_TRIANGLES, 0, 6);
-                break;
-            }
-            default:
-                demoColor = glm::vec3(0.5f, 0.5f, 0.5f);
-                demoName = "Unknown Demo";
-                break;
+                endBatchItem(drawBatch, GL_TRIANGLES, fluidVertexIndex);
             }
 
-            // Handle other demo screens (default only)
-            if (currentScreen != Screen::GREEN_DEMO && currentScreen != Screen::YELLOW_DEMO)
-            {
-                // Set clear color to demo color
-                glClearColor(demoColor.r, demoColor.g, demoColor.b, 1.0f);
-                glClear(GL_COLOR_BUFFER_BIT);
-
-                // Draw the back button
-                glUseProgram(shaderProgram);
-                projection = glm::ortho(-1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f);
-                glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-                model = glm::mat4(1.0f);
-                glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-                glBindVertexArray(backVAO);
-                glDrawArrays(GL_TRIANGLES, 0, 6);
-            }
+            // Draw back button
+            batchSceneItem(drawBatch, UI_BACK_BUTTON);
         }
+        else
+        {
+            // Unknown screens: grey background and a back button
+            glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            batchSceneItem(drawBatch, UI_BACK_BUTTON);
+        }
+        flushDrawBatch(drawBatch);
+        endRenderStats();
+
+        PROFILE_END();
 
         // Swap buffers and poll IO events
+        // Queue this frame's readback before it is presented
+        captureFrame(windowWidth, windowHeight);
+
+        PROFILE_BEGIN("Swap");
         glfwSwapBuffers(window);
-        glfwPollEvents();
+        markFramePresented();
+        if (lowLatency)
+        {
+            // Keep the swap chain empty: block until the GPU is done with this frame
+            GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            glDeleteSync(fence);
+        }
+        PROFILE_END();
+        if (!lowLatency)
+        {
+            PROFILE_BEGIN("Poll events");
+            glfwPollEvents();
+            PROFILE_END();
+        }
     }
 
+    // Current (still live) and peak usage per subsystem
+    if (memoryReportPath && !writeMemoryReport(memoryReportPath))
+        std::cerr << "Memory report not written" << std::endl;
+
     // Optional: De-allocate all resources once they've outlived their purpose
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteVertexArrays(1, &backVAO);
-    glDeleteBuffers(1, &backVBO);
-    glDeleteVertexArrays(1, &boxVAO);
-    glDeleteBuffers(1, &boxVBO);
-    glDeleteVertexArrays(1, &ballVAO);
-    glDeleteBuffers(1, &ballVBO);
-    glDeleteVertexArrays(1, &squareVAO);
-    glDeleteBuffers(1, &squareVBO);
-    glDeleteVertexArrays(1, &pendulumStringVAO);
-    glDeleteBuffers(1, &pendulumStringVBO);
+    destroyDrawBatch(drawBatch);
     glDeleteProgram(shaderProgram);
+    destroyGpuFluid(gpuFluid);
+    if (useStableFluid)
+        destroyStableFluid(stableFluid);
+
+    // Report scratch memory high-water mark
+    resetFrameArena(frameArena);
+    std::cout << "Frame arena peak usage: " << frameArena.peak / 1024 << " KB of " << frameArena.capacity / (1024 * 1024)
+              << " MB reserved" << (frameArena.hugePages ? " (huge pages)" : "") << std::endl;
+    destroyFrameArena(frameArena);
+    printRenderStats();
+
+    printLatencyReport();
+    destroyLatencyTracker();
+    finishFrameCapture();
+    if (inputRecordFile)
+        fclose(inputRecordFile);
+    shutdownTelemetry();
+    if (profilePath && !writeProfilerTrace(profilePath))
+        std::cerr << "Profiler not written (compiled out in release builds or file error)" << std::endl;
 
     // Clean up
     glfwTerminate();
@@ -0,0 +1,157 @@
+#include "memory_tracker.h"
+
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <map>
+
+struct GlObject
+{
+    size_t bytes;
+    MemoryTag tag;
+};
+
+static const char *const TAG_NAMES[MEMORY_TAG_COUNT] = {
+    "balls", "squares", "cradle", "fluid-particles", "nbody-tree", "square-ensemble", "obstacles", "stable-fluid",
+    "flow-lines", "scene-vertices", "frame-arena", "gl-draw-batch", "gl-gpu-fluid", "gl-capture",
+};
+
+static std::atomic<size_t> currentBytes[MEMORY_TAG_COUNT];
+static std::atomic<size_t> peakBytes[MEMORY_TAG_COUNT];
+
+// Live GL objects by name; buffers and textures have separate name spaces
+static std::map<unsigned int, GlObject> glBuffers, glTextures;
+
+const char *memoryTagName(MemoryTag tag)
+{
+    return TAG_NAMES[tag];
+}
+
+bool memoryTagIsGl(MemoryTag tag)
+{
+    return tag >= MEMORY_GL_DRAW_BATCH;
+}
+
+void memoryAllocated(MemoryTag tag, size_t bytes)
+{
+    size_t now = currentBytes[tag].fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    size_t peak = peakBytes[tag].load(std::memory_order_relaxed);
+    while (now > peak && !peakBytes[tag].compare_exchange_weak(peak, now, std::memory_order_relaxed))
+    {
+    }
+}
+
+void memoryReleased(MemoryTag tag, size_t bytes)
+{
+    currentBytes[tag].fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+MemoryUsage memoryUsage(MemoryTag tag)
+{
+    return MemoryUsage{currentBytes[tag].load(std::memory_order_relaxed), peakBytes[tag].load(std::memory_order_relaxed)};
+}
+
+static void trackGlObject(std::map<unsigned int, GlObject> &objects, unsigned int name, size_t bytes, MemoryTag tag)
+{
+    auto found = objects.find(name);
+    if (found != objects.end())
+        memoryReleased(found->second.tag, found->second.bytes);
+    objects[name] = GlObject{bytes, tag};
+    memoryAllocated(tag, bytes);
+}
+
+static void releaseGlObject(std::map<unsigned int, GlObject> &objects, unsigned int name)
+{
+    auto found = objects.find(name);
+    if (found == objects.end())
+        return;
+    memoryReleased(found->second.tag, found->second.bytes);
+    objects.erase(found);
+}
+
+void trackGlBuffer(unsigned int buffer, size_t bytes, MemoryTag tag)
+{
+    trackGlObject(glBuffers, buffer, bytes, tag);
+}
+
+void trackGlTexture(unsigned int texture, size_t bytes, MemoryTag tag)
+{
+    trackGlObject(glTextures, texture, bytes, tag);
+}
+
+void releaseGlBuffer(unsigned int buffer)
+{
+    releaseGlObject(glBuffers, buffer);
+}
+
+void releaseGlTexture(unsigned int texture)
+{
+    releaseGlObject(glTextures, texture);
+}
+
+// Bytes with a K/M/G suffix in at most a few characters
+static void formatBytes(char *buffer, size_t size, size_t bytes)
+{
+    if (bytes < 1024)
+        snprintf(buffer, size, "%zu", bytes);
+    else if (bytes < 1024 * 1024)
+        snprintf(buffer, size, "%.3gK", bytes / 1024.0);
+    else if (bytes < 1024 * 1024 * 1024)
+        snprintf(buffer, size, "%.3gM", bytes / (1024.0 * 1024.0));
+    else
+        snprintf(buffer, size, "%.3gG", bytes / (1024.0 * 1024.0 * 1024.0));
+}
+
+void formatMemorySummary(char *buffer, size_t size)
+{
+    if (size == 0)
+        return;
+    buffer[0] = '\0';
+    size_t length = 0;
+    for (int t = 0; t < MEMORY_TAG_COUNT && length < size; t++)
+    {
+        MemoryUsage usage = memoryUsage((MemoryTag)t);
+        if (usage.peak == 0)
+            continue;
+        char current[16], peak[16];
+        formatBytes(current, sizeof(current), usage.current);
+        formatBytes(peak, sizeof(peak), usage.peak);
+        int written = snprintf(buffer + length, size - length, "%s%s %s/%s", length ? ", " : "", TAG_NAMES[t], current, peak);
+        if (written < 0)
+            break;
+        length += (size_t)written;
+    }
+}
+
+bool writeMemoryReport(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        std::cerr << "ERROR::MEMORY_TRACKER::FILE_NOT_OPENED " << path << std::endl;
+        return false;
+    }
+
+    fprintf(file, "{\"subsystems\":[\n");
+    for (int t = 0; t < MEMORY_TAG_COUNT; t++)
+    {
+        MemoryUsage usage = memoryUsage((MemoryTag)t);
+        fprintf(file, "%s{\"name\":\"%s\",\"heap\":\"%s\",\"current\":%zu,\"peak\":%zu}", t ? ",\n" : "", TAG_NAMES[t],
+                memoryTagIsGl((MemoryTag)t) ? "gl" : "cpu", usage.current, usage.peak);
+    }
+    fprintf(file, "\n],\"glObjects\":[");
+    bool first = true;
+    const char *kinds[2] = {"buffer", "texture"};
+    const std::map<unsigned int, GlObject> *objects[2] = {&glBuffers, &glTextures};
+    for (int k = 0; k < 2; k++)
+        for (const auto &object : *objects[k])
+        {
+            fprintf(file, "%s{\"kind\":\"%s\",\"name\":%u,\"subsystem\":\"%s\",\"bytes\":%zu}", first ? "\n" : ",\n", kinds[k],
+                    object.first, TAG_NAMES[object.second.tag], object.second.bytes);
+            first = false;
+        }
+    fprintf(file, "\n]}\n");
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
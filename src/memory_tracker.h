@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Memory accounting per subsystem. CPU heaps are counted by tagged allocators
+// (containers declared as TaggedVector<T, tag> report every allocation and
+// free to their tag), the frame arena reports what it hands out each frame,
+// GL buffers and textures are recorded by object when their storage is
+// specified, and fixed-size demo state is registered once with
+// memoryAllocated. Each tag keeps its current and peak bytes; the HUD shows
+// them and writeMemoryReport dumps them as JSON.
+
+enum MemoryTag
+{
+    // CPU
+    MEMORY_BALLS,           // Red demo bodies
+    MEMORY_SQUARES,         // Blue demo state
+    MEMORY_CRADLE,          // Green demo state
+    MEMORY_FLUID_PARTICLES, // Yellow demo particles
+    MEMORY_NBODY,           // Barnes-Hut tree and per-body forces
+    MEMORY_SQUARE_ENSEMBLE, // Batched square runs of the sweeps
+    MEMORY_OBSTACLES,       // Obstacle outlines, edge BVHs and the broadphase
+    MEMORY_STABLE_FLUID,    // Grid fields and the multigrid hierarchy
+    MEMORY_FLOW_LINES,
+    MEMORY_SCENE_VERTICES,  // Retained UI geometry
+    MEMORY_FRAME_ARENA,     // Per-frame vertex scratch, as used by the last complete frame
+    // GL
+    MEMORY_GL_DRAW_BATCH,
+    MEMORY_GL_GPU_FLUID,
+    MEMORY_GL_CAPTURE,
+    MEMORY_TAG_COUNT
+};
+
+struct MemoryUsage
+{
+    size_t current; // Bytes live now
+    size_t peak;    // Most bytes live at once
+};
+
+const char *memoryTagName(MemoryTag tag);
+bool memoryTagIsGl(MemoryTag tag);
+
+// Counters are atomic, so any thread may allocate or free
+void memoryAllocated(MemoryTag tag, size_t bytes);
+void memoryReleased(MemoryTag tag, size_t bytes);
+MemoryUsage memoryUsage(MemoryTag tag);
+
+// Standard allocator that counts its blocks against a tag
+template <typename T, MemoryTag Tag>
+struct TaggedAllocator
+{
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind
+    {
+        typedef TaggedAllocator<U, Tag> other;
+    };
+
+    TaggedAllocator() {}
+    template <typename U>
+    TaggedAllocator(const TaggedAllocator<U, Tag> &) {}
+
+    T *allocate(size_t count)
+    {
+        T *block = std::allocator<T>().allocate(count);
+        memoryAllocated(Tag, count * sizeof(T));
+        return block;
+    }
+
+    void deallocate(T *block, size_t count)
+    {
+        memoryReleased(Tag, count * sizeof(T));
+        std::allocator<T>().deallocate(block, count);
+    }
+};
+
+template <typename T, typename U, MemoryTag Tag>
+bool operator==(const TaggedAllocator<T, Tag> &, const TaggedAllocator<U, Tag> &)
+{
+    return true;
+}
+
+template <typename T, typename U, MemoryTag Tag>
+bool operator!=(const TaggedAllocator<T, Tag> &, const TaggedAllocator<U, Tag> &)
+{
+    return false;
+}
+
+template <typename T, MemoryTag Tag>
+using TaggedVector = std::vector<T, TaggedAllocator<T, Tag>>;
+
+// GL objects, keyed by name. Call after (re)specifying an object's storage;
+// a second call for the same name replaces its size. Releasing an untracked
+// name does nothing. GL thread only.
+void trackGlBuffer(unsigned int buffer, size_t bytes, MemoryTag tag);
+void trackGlTexture(unsigned int texture, size_t bytes, MemoryTag tag);
+void releaseGlBuffer(unsigned int buffer);
+void releaseGlTexture(unsigned int texture);
+
+// Compact "name current/peak" list of the tags that have held any memory,
+// e.g. "balls 2K/2K, stable-fluid 1.2M/1.3M", for the HUD
+void formatMemorySummary(char *buffer, size_t size);
+
+// Current and peak bytes per tag plus every live GL object, as JSON.
+// Returns false if the file cannot be written.
+bool writeMemoryReport(const char *path);
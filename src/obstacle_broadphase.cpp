@@ -0,0 +1,58 @@
+#include "obstacle_broadphase.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+void buildObstacleBroadphase(ObstacleBroadphase &broadphase, const std::vector<float> &bounds, float margin,
+                             float minX, float minY, float maxX, float maxY)
+{
+    PROFILE_ZONE("buildObstacleBroadphase");
+    int count = (int)bounds.size() / 4;
+    broadphase.bounds.assign(bounds.begin(), bounds.end());
+    broadphase.minX = minX;
+    broadphase.minY = minY;
+
+    // Cells about the size of the average obstacle keep the lists short
+    // without binning each obstacle into many cells
+    float extent = 0.0f;
+    for (int i = 0; i < count; i++)
+        extent += std::max(bounds[i * 4 + 2] - bounds[i * 4], bounds[i * 4 + 3] - bounds[i * 4 + 1]) + 2.0f * margin;
+    float width = maxX - minX, height = maxY - minY;
+    float cellSize = count > 0 ? extent / count : std::max(width, height);
+    cellSize = std::max(cellSize, std::max(width, height) / OBSTACLE_BROADPHASE_MAX_CELLS);
+    broadphase.cellSize = cellSize;
+    broadphase.columns = std::max(1, (int)std::ceil(width / cellSize));
+    broadphase.rows = std::max(1, (int)std::ceil(height / cellSize));
+
+    // Counting sort of (cell, obstacle) pairs into the cell lists
+    int cells = broadphase.columns * broadphase.rows;
+    auto cellRange = [&](int i, int &firstColumn, int &firstRow, int &lastColumn, int &lastRow)
+    {
+        firstColumn = std::max(0, (int)std::floor((bounds[i * 4] - margin - minX) / cellSize));
+        firstRow = std::max(0, (int)std::floor((bounds[i * 4 + 1] - margin - minY) / cellSize));
+        lastColumn = std::min(broadphase.columns - 1, (int)std::floor((bounds[i * 4 + 2] + margin - minX) / cellSize));
+        lastRow = std::min(broadphase.rows - 1, (int)std::floor((bounds[i * 4 + 3] + margin - minY) / cellSize));
+    };
+    broadphase.cellStart.assign(cells + 1, 0);
+    for (int i = 0; i < count; i++)
+    {
+        int firstColumn, firstRow, lastColumn, lastRow;
+        cellRange(i, firstColumn, firstRow, lastColumn, lastRow);
+        for (int row = firstRow; row <= lastRow; row++)
+            for (int column = firstColumn; column <= lastColumn; column++)
+                broadphase.cellStart[row * broadphase.columns + column + 1]++;
+    }
+    for (int cell = 0; cell < cells; cell++)
+        broadphase.cellStart[cell + 1] += broadphase.cellStart[cell];
+    broadphase.items.resize(broadphase.cellStart[cells]);
+    std::vector<int> fill(broadphase.cellStart.begin(), broadphase.cellStart.end() - 1);
+    for (int i = 0; i < count; i++)
+    {
+        int firstColumn, firstRow, lastColumn, lastRow;
+        cellRange(i, firstColumn, firstRow, lastColumn, lastRow);
+        for (int row = firstRow; row <= lastRow; row++)
+            for (int column = firstColumn; column <= lastColumn; column++)
+                broadphase.items[fill[row * broadphase.columns + column]++] = i;
+    }
+}
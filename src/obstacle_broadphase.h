@@ -0,0 +1,54 @@
+#pragma once
+
+#include "memory_tracker.h"
+
+#include <cstddef>
+#include <vector>
+
+// Broadphase for wind tunnels with many obstacles: a uniform grid over the
+// box where each cell lists the obstacles whose bounding boxes overlap it.
+// A particle looks up its cell and only runs the exact test against those,
+// so the cost per particle follows the local obstacle density rather than
+// the total count. Rebuilt only when an obstacle moves or changes shape.
+
+// Most cells along either axis
+const int OBSTACLE_BROADPHASE_MAX_CELLS = 64;
+
+struct ObstacleBroadphase
+{
+    float minX, minY, cellSize;
+    int columns, rows;
+    TaggedVector<float, MEMORY_OBSTACLES> bounds;  // minX, minY, maxX, maxY per obstacle
+    TaggedVector<int, MEMORY_OBSTACLES> cellStart; // Offsets into items per cell, plus one past the end
+    TaggedVector<int, MEMORY_OBSTACLES> items;     // Obstacle indices, grouped by cell
+};
+
+// Bin count boxes (minX, minY, maxX, maxY each) over the region; boxes are
+// padded by margin when binned so queries within margin of a box still see it
+void buildObstacleBroadphase(ObstacleBroadphase &broadphase, const std::vector<float> &bounds, float margin,
+                             float minX, float minY, float maxX, float maxY);
+
+// Obstacles whose padded boxes overlap the cell containing (x, y); points
+// outside the region use the nearest cell
+inline int queryObstacleBroadphase(const ObstacleBroadphase &broadphase, float x, float y, const int *&items)
+{
+    if (broadphase.cellStart.empty())
+    {
+        items = NULL;
+        return 0;
+    }
+    int column = (int)((x - broadphase.minX) / broadphase.cellSize);
+    int row = (int)((y - broadphase.minY) / broadphase.cellSize);
+    column = column < 0 ? 0 : (column >= broadphase.columns ? broadphase.columns - 1 : column);
+    row = row < 0 ? 0 : (row >= broadphase.rows ? broadphase.rows - 1 : row);
+    int cell = row * broadphase.columns + column;
+    items = broadphase.items.data() + broadphase.cellStart[cell];
+    return broadphase.cellStart[cell + 1] - broadphase.cellStart[cell];
+}
+
+// Whether a disk overlaps obstacle i's exact (unpadded) box
+inline bool obstacleBroadphaseOverlaps(const ObstacleBroadphase &broadphase, int i, float x, float y, float radius)
+{
+    const float *box = &broadphase.bounds[i * 4];
+    return x + radius >= box[0] && y + radius >= box[1] && x - radius <= box[2] && y - radius <= box[3];
+}
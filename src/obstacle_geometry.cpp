@@ -0,0 +1,548 @@
+#include "obstacle_geometry.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+const float OBSTACLE_PI = 3.14159265358979f;
+
+// Line segments per flattened SVG curve
+const int SVG_CURVE_SEGMENTS = 8;
+
+// Close the ring being read if it has at least three points, dropping a
+// repeated first point at the end
+static void closeRing(ObstaclePolygon &polygon, size_t ringStart)
+{
+    size_t count = polygon.points.size() / 2 - ringStart;
+    if (count >= 2 && polygon.points[ringStart * 2] == polygon.points[polygon.points.size() - 2] &&
+        polygon.points[ringStart * 2 + 1] == polygon.points.back())
+    {
+        polygon.points.resize(polygon.points.size() - 2);
+        count--;
+    }
+    if (count < 3)
+        polygon.points.resize(ringStart * 2);
+    else
+        polygon.ringEnds.push_back((int)(polygon.points.size() / 2));
+}
+
+// Append the rings of one SVG path's d attribute; y is flipped to point up
+static bool parseSvgPath(const std::string &data, ObstaclePolygon &polygon)
+{
+    size_t pos = 0, ringStart = polygon.points.size() / 2;
+    char command = 0;
+    float x = 0.0f, y = 0.0f, startX = 0.0f, startY = 0.0f;
+    float controlX = 0.0f, controlY = 0.0f; // Last cubic control point, for S
+    auto addPoint = [&](float px, float py) {
+        polygon.points.push_back(px);
+        polygon.points.push_back(-py);
+    };
+    auto number = [&](float &value) {
+        while (pos < data.size() && (isspace((unsigned char)data[pos]) || data[pos] == ','))
+            pos++;
+        const char *start = data.c_str() + pos;
+        char *end;
+        value = strtof(start, &end);
+        pos += end - start;
+        return end != start;
+    };
+
+    for (;;)
+    {
+        while (pos < data.size() && (isspace((unsigned char)data[pos]) || data[pos] == ','))
+            pos++;
+        if (pos >= data.size())
+            break;
+        if (isalpha((unsigned char)data[pos]))
+            command = data[pos++];
+        else if (command == 0)
+            return false;
+
+        bool relative = islower((unsigned char)command) != 0;
+        float baseX = relative ? x : 0.0f, baseY = relative ? y : 0.0f;
+        char type = (char)toupper((unsigned char)command);
+        float a, b, c, d, e, f;
+        if (type == 'Z')
+        {
+            closeRing(polygon, ringStart);
+            ringStart = polygon.points.size() / 2;
+            x = startX;
+            y = startY;
+            command = 0;
+            continue;
+        }
+        if (type == 'M')
+        {
+            if (!number(a) || !number(b))
+                return false;
+            closeRing(polygon, ringStart);
+            ringStart = polygon.points.size() / 2;
+            x = startX = baseX + a;
+            y = startY = baseY + b;
+            addPoint(x, y);
+            command = relative ? 'l' : 'L'; // Further pairs are line segments
+        }
+        else if (type == 'L')
+        {
+            if (!number(a) || !number(b))
+                return false;
+            x = baseX + a;
+            y = baseY + b;
+            addPoint(x, y);
+        }
+        else if (type == 'H' || type == 'V')
+        {
+            if (!number(a))
+                return false;
+            if (type == 'H')
+                x = baseX + a;
+            else
+                y = baseY + a;
+            addPoint(x, y);
+        }
+        else if (type == 'C' || type == 'S' || type == 'Q')
+        {
+            // Control points, then flatten the Bezier at even parameter steps
+            float x1, y1, x2, y2;
+            if (type == 'S')
+            {
+                if (!number(c) || !number(d) || !number(e) || !number(f))
+                    return false;
+                x1 = 2.0f * x - controlX;
+                y1 = 2.0f * y - controlY;
+                x2 = baseX + c;
+                y2 = baseY + d;
+            }
+            else if (type == 'C')
+            {
+                if (!number(a) || !number(b) || !number(c) || !number(d) || !number(e) || !number(f))
+                    return false;
+                x1 = baseX + a;
+                y1 = baseY + b;
+                x2 = baseX + c;
+                y2 = baseY + d;
+            }
+            else
+            {
+                if (!number(a) || !number(b) || !number(e) || !number(f))
+                    return false;
+                // Quadratic as the equivalent cubic
+                float qx = baseX + a, qy = baseY + b;
+                float endX = baseX + e, endY = baseY + f;
+                x1 = x + 2.0f / 3.0f * (qx - x);
+                y1 = y + 2.0f / 3.0f * (qy - y);
+                x2 = endX + 2.0f / 3.0f * (qx - endX);
+                y2 = endY + 2.0f / 3.0f * (qy - endY);
+            }
+            float x3 = baseX + e, y3 = baseY + f;
+            for (int i = 1; i <= SVG_CURVE_SEGMENTS; i++)
+            {
+                float t = (float)i / SVG_CURVE_SEGMENTS, u = 1.0f - t;
+                addPoint(u * u * u * x + 3.0f * u * u * t * x1 + 3.0f * u * t * t * x2 + t * t * t * x3,
+                         u * u * u * y + 3.0f * u * u * t * y1 + 3.0f * u * t * t * y2 + t * t * t * y3);
+            }
+            controlX = x2;
+            controlY = y2;
+            x = x3;
+            y = y3;
+            continue;
+        }
+        else
+        {
+            std::cerr << "Unsupported SVG path command " << command << std::endl;
+            return false;
+        }
+        controlX = x;
+        controlY = y;
+    }
+    closeRing(polygon, ringStart);
+    return true;
+}
+
+bool loadObstaclePolygon(const char *path, ObstaclePolygon &polygon)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << "Could not open obstacle file " << path << std::endl;
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string text = buffer.str();
+    polygon.points.clear();
+    polygon.ringEnds.clear();
+
+    if (text.find("<svg") != std::string::npos || text.find("<path") != std::string::npos)
+    {
+        // Every d="..." attribute of the file's paths
+        for (size_t pos = text.find("d=\""); pos != std::string::npos; pos = text.find("d=\"", pos + 1))
+        {
+            if (pos == 0 || !isspace((unsigned char)text[pos - 1]))
+                continue;
+            size_t start = pos + 3, end = text.find('"', start);
+            if (end == std::string::npos || !parseSvgPath(text.substr(start, end - start), polygon))
+            {
+                std::cerr << "Could not parse SVG path data in " << path << std::endl;
+                return false;
+            }
+        }
+    }
+    else
+    {
+        std::istringstream lines(text);
+        std::string line;
+        size_t ringStart = 0;
+        while (std::getline(lines, line))
+        {
+            size_t comment = line.find('#');
+            if (comment != std::string::npos)
+                line.resize(comment);
+            float x, y;
+            if (sscanf(line.c_str(), "%f %f", &x, &y) == 2)
+            {
+                polygon.points.push_back(x);
+                polygon.points.push_back(y);
+            }
+            else if (line.find_first_not_of(" \t\r") == std::string::npos && comment == std::string::npos)
+            {
+                closeRing(polygon, ringStart);
+                ringStart = polygon.points.size() / 2;
+            }
+        }
+        closeRing(polygon, ringStart);
+    }
+
+    if (polygon.ringEnds.empty())
+    {
+        std::cerr << "No closed outline with at least three points in " << path << std::endl;
+        return false;
+    }
+
+    // Centre the bounding box on the origin and make its longer side 2 units
+    float minX = polygon.points[0], maxX = minX, minY = polygon.points[1], maxY = minY;
+    for (size_t i = 0; i < polygon.points.size(); i += 2)
+    {
+        minX = std::min(minX, polygon.points[i]);
+        maxX = std::max(maxX, polygon.points[i]);
+        minY = std::min(minY, polygon.points[i + 1]);
+        maxY = std::max(maxY, polygon.points[i + 1]);
+    }
+    float scale = 2.0f / std::max(std::max(maxX - minX, maxY - minY), 1e-6f);
+    float centreX = 0.5f * (minX + maxX), centreY = 0.5f * (minY + maxY);
+    for (size_t i = 0; i < polygon.points.size(); i += 2)
+    {
+        polygon.points[i] = (polygon.points[i] - centreX) * scale;
+        polygon.points[i + 1] = (polygon.points[i + 1] - centreY) * scale;
+    }
+    return true;
+}
+
+bool loadObstacleLayout(const char *path, TaggedVector<ObstacleInstance, MEMORY_OBSTACLES> &obstacles, std::deque<ObstaclePolygon> &polygons)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << "Could not open obstacle layout " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    for (int lineNumber = 1; std::getline(file, line); lineNumber++)
+    {
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.resize(comment);
+        std::istringstream fields(line);
+        std::string type;
+        if (!(fields >> type))
+            continue;
+
+        ObstacleInstance obstacle = {};
+        obstacle.airfoil = {0.0f, 0.0f, 0.12f, 0.0f}; // NACA 0012
+        if (!(fields >> obstacle.x >> obstacle.y >> obstacle.radius) || obstacle.radius <= 0.0f)
+        {
+            std::cerr << "Expected X Y R on line " << lineNumber << " of " << path << std::endl;
+            return false;
+        }
+        if (type == "ball")
+            obstacle.shape = ObstacleShape::BALL;
+        else if (type == "triangle")
+            obstacle.shape = ObstacleShape::TRIANGLE;
+        else if (type == "airfoil")
+        {
+            obstacle.shape = ObstacleShape::AIRFOIL;
+            std::string digits;
+            float degrees = 0.0f;
+            if (fields >> digits && !parseNacaDesignation(digits.c_str(), obstacle.airfoil))
+            {
+                std::cerr << "Invalid NACA designation " << digits << " on line " << lineNumber << " of " << path << std::endl;
+                return false;
+            }
+            fields >> degrees;
+            obstacle.airfoil.angleOfAttack = degrees * OBSTACLE_PI / 180.0f;
+        }
+        else if (type == "polygon")
+        {
+            std::string outline;
+            polygons.emplace_back();
+            if (!(fields >> outline) || !loadObstaclePolygon(outline.c_str(), polygons.back()))
+            {
+                polygons.pop_back();
+                std::cerr << "Missing or unreadable outline on line " << lineNumber << " of " << path << std::endl;
+                return false;
+            }
+            obstacle.shape = ObstacleShape::POLYGON;
+            obstacle.polygon = &polygons.back();
+        }
+        else
+        {
+            std::cerr << "Unknown obstacle type " << type << " on line " << lineNumber << " of " << path << std::endl;
+            return false;
+        }
+        obstacle.geometry.built = false;
+        obstacle.geometry.version = 0;
+        obstacles.push_back(obstacle);
+    }
+    return true;
+}
+
+bool parseNacaDesignation(const char *digits, AirfoilParams &params)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        if (digits[i] < '0' || digits[i] > '9')
+            return false;
+    }
+    if (digits[4] != '\0')
+        return false;
+    params.camber = (digits[0] - '0') / 100.0f;
+    params.camberPosition = (digits[1] - '0') / 10.0f;
+    params.thickness = ((digits[2] - '0') * 10 + (digits[3] - '0')) / 100.0f;
+    return true;
+}
+
+// Upper and lower surface points of a unit-chord NACA 4-digit section at xc
+static void airfoilSurfaces(const AirfoilParams &params, float xc, float &upperX, float &upperY, float &lowerX, float &lowerY)
+{
+    // Half thickness
+    float yt = 5.0f * params.thickness * (0.2969f * sqrt(xc) - 0.1260f * xc - 0.3516f * xc * xc + 0.2843f * xc * xc * xc - 0.1015f * xc * xc * xc * xc);
+
+    // Mean camber line and its slope; no camber without a position for it
+    float yc = 0.0f, slope = 0.0f;
+    float m = params.camber, p = params.camberPosition;
+    if (m > 0.0f && p > 0.0f && p < 1.0f)
+    {
+        if (xc < p)
+        {
+            yc = m / (p * p) * (2.0f * p * xc - xc * xc);
+            slope = 2.0f * m / (p * p) * (p - xc);
+        }
+        else
+        {
+            yc = m / ((1.0f - p) * (1.0f - p)) * (1.0f - 2.0f * p + 2.0f * p * xc - xc * xc);
+            slope = 2.0f * m / ((1.0f - p) * (1.0f - p)) * (p - xc);
+        }
+    }
+
+    // Thickness is laid off perpendicular to the camber line
+    float theta = atan(slope);
+    upperX = xc - yt * sin(theta);
+    upperY = yc + yt * cos(theta);
+    lowerX = xc + yt * sin(theta);
+    lowerY = yc - yt * cos(theta);
+}
+
+// Ear clipping of one ring into triangles (x/y triples). O(n^2), which is
+// fine once per shape change even for thousands of points.
+static void triangulateRing(const float *points, int count, TaggedVector<float, MEMORY_OBSTACLES> &triangles)
+{
+    // Work counter-clockwise
+    float area = 0.0f;
+    for (int i = 0, j = count - 1; i < count; j = i++)
+        area += points[j * 2] * points[i * 2 + 1] - points[i * 2] * points[j * 2 + 1];
+    std::vector<int> ring(count);
+    for (int i = 0; i < count; i++)
+        ring[i] = area >= 0.0f ? i : count - 1 - i;
+
+    auto cross = [&](int a, int b, int c) {
+        return (points[b * 2] - points[a * 2]) * (points[c * 2 + 1] - points[a * 2 + 1]) -
+               (points[b * 2 + 1] - points[a * 2 + 1]) * (points[c * 2] - points[a * 2]);
+    };
+    auto emit = [&](int a, int b, int c) {
+        triangles.insert(triangles.end(), {points[a * 2], points[a * 2 + 1], points[b * 2], points[b * 2 + 1], points[c * 2], points[c * 2 + 1]});
+    };
+
+    // A convex corner is an ear if no other remaining point lies in it; give
+    // up after a full pass without one (self-intersecting input)
+    int i = 0, misses = 0;
+    while (ring.size() > 3 && misses < (int)ring.size())
+    {
+        int n = (int)ring.size();
+        int prev = ring[(i + n - 1) % n], current = ring[i % n], next = ring[(i + 1) % n];
+        bool ear = cross(prev, current, next) > 0.0f;
+        for (int k = 0; ear && k < n; k++)
+        {
+            int p = ring[k];
+            if (p == prev || p == current || p == next)
+                continue;
+            if (cross(prev, current, p) >= 0.0f && cross(current, next, p) >= 0.0f && cross(next, prev, p) >= 0.0f)
+                ear = false;
+        }
+        if (ear)
+        {
+            emit(prev, current, next);
+            ring.erase(ring.begin() + i % n);
+            misses = 0;
+        }
+        else
+        {
+            i++;
+            misses++;
+        }
+        i %= (int)ring.size();
+    }
+    if (ring.size() == 3)
+        emit(ring[0], ring[1], ring[2]);
+}
+
+bool updateObstacleGeometry(ObstacleGeometry &geometry, ObstacleShape shape, float x, float y, float radius,
+                            const AirfoilParams &airfoil, const ObstaclePolygon *polygon)
+{
+    if (shape == ObstacleShape::POLYGON && !polygon)
+        shape = ObstacleShape::BALL;
+    if (geometry.built && geometry.shape == shape && geometry.x == x && geometry.y == y && geometry.radius == radius &&
+        (shape != ObstacleShape::AIRFOIL ||
+         (geometry.airfoil.camber == airfoil.camber && geometry.airfoil.camberPosition == airfoil.camberPosition &&
+          geometry.airfoil.thickness == airfoil.thickness && geometry.airfoil.angleOfAttack == airfoil.angleOfAttack)) &&
+        (shape != ObstacleShape::POLYGON || geometry.polygon == polygon))
+        return false;
+
+    PROFILE_ZONE("updateObstacleGeometry");
+    geometry.built = true;
+    geometry.shape = shape;
+    geometry.x = x;
+    geometry.y = y;
+    geometry.radius = radius;
+    geometry.airfoil = airfoil;
+    geometry.polygon = polygon;
+    geometry.version++;
+    geometry.outline.clear();
+    geometry.ringEnds.clear();
+    geometry.triangles.clear();
+
+    switch (shape)
+    {
+    case ObstacleShape::BALL:
+        break;
+    case ObstacleShape::TRIANGLE:
+    {
+        // Equilateral triangle pointing up, sized to fit in a circle of radius
+        float size = radius * 2.0f;
+        float h = size * sqrt(3.0f) / 2.0f;
+        geometry.outline = {x - size / 2.0f, y - h / 3.0f,
+                            x + size / 2.0f, y - h / 3.0f,
+                            x, y + 2.0f * h / 3.0f};
+        geometry.triangles = geometry.outline;
+        break;
+    }
+    case ObstacleShape::AIRFOIL:
+    {
+        // Chord centred on (x, y), rotated nose up by the angle of attack
+        const int N = AIRFOIL_SURFACE_POINTS;
+        float chord = radius * 2.0f;
+        float c = cos(airfoil.angleOfAttack), s = sin(airfoil.angleOfAttack);
+        geometry.outline.resize(N * 2 * 2);
+        for (int i = 0; i < N; i++)
+        {
+            float xc = 0.5f * (1.0f - cos(OBSTACLE_PI * i / (N - 1)));
+            float upperX, upperY, lowerX, lowerY;
+            airfoilSurfaces(airfoil, xc, upperX, upperY, lowerX, lowerY);
+            float ux = (upperX - 0.5f) * chord, uy = upperY * chord;
+            float lx = (lowerX - 0.5f) * chord, ly = lowerY * chord;
+            int lower = 2 * N - 1 - i;
+            geometry.outline[i * 2] = x + ux * c + uy * s;
+            geometry.outline[i * 2 + 1] = y - ux * s + uy * c;
+            geometry.outline[lower * 2] = x + lx * c + ly * s;
+            geometry.outline[lower * 2 + 1] = y - lx * s + ly * c;
+        }
+
+        // The surfaces share stations, so the section is a strip of quads
+        // between them; unlike a fan from the nose this stays inside cambered
+        // profiles with a concave lower surface
+        const float *o = geometry.outline.data();
+        for (int i = 0; i + 1 < N; i++)
+        {
+            int upper = i, lower = 2 * N - 1 - i;
+            geometry.triangles.insert(geometry.triangles.end(),
+                                      {o[upper * 2], o[upper * 2 + 1], o[(upper + 1) * 2], o[(upper + 1) * 2 + 1], o[(lower - 1) * 2], o[(lower - 1) * 2 + 1],
+                                       o[upper * 2], o[upper * 2 + 1], o[(lower - 1) * 2], o[(lower - 1) * 2 + 1], o[lower * 2], o[lower * 2 + 1]});
+        }
+        break;
+    }
+    case ObstacleShape::POLYGON:
+    {
+        geometry.outline.resize(polygon->points.size());
+        for (size_t i = 0; i < polygon->points.size(); i += 2)
+        {
+            geometry.outline[i] = x + polygon->points[i] * radius;
+            geometry.outline[i + 1] = y + polygon->points[i + 1] * radius;
+        }
+        geometry.ringEnds = polygon->ringEnds;
+        for (size_t r = 0, start = 0; r < geometry.ringEnds.size(); start = geometry.ringEnds[r++])
+            triangulateRing(&geometry.outline[start * 2], geometry.ringEnds[r] - (int)start, geometry.triangles);
+        break;
+    }
+    }
+    if (!geometry.outline.empty() && geometry.ringEnds.empty())
+        geometry.ringEnds.push_back((int)geometry.outline.size() / 2);
+    buildEdgeBvh(geometry.bvh, geometry.outline, geometry.ringEnds);
+
+    if (geometry.outline.empty())
+    {
+        geometry.minX = x - radius;
+        geometry.maxX = x + radius;
+        geometry.minY = y - radius;
+        geometry.maxY = y + radius;
+    }
+    else
+    {
+        geometry.minX = geometry.maxX = geometry.outline[0];
+        geometry.minY = geometry.maxY = geometry.outline[1];
+        for (size_t i = 0; i < geometry.outline.size(); i += 2)
+        {
+            geometry.minX = std::min(geometry.minX, geometry.outline[i]);
+            geometry.maxX = std::max(geometry.maxX, geometry.outline[i]);
+            geometry.minY = std::min(geometry.minY, geometry.outline[i + 1]);
+            geometry.maxY = std::max(geometry.maxY, geometry.outline[i + 1]);
+        }
+    }
+    return true;
+}
+
+float obstacleSignedDistance(const ObstacleGeometry &geometry, float x, float y)
+{
+    if (geometry.outline.empty())
+        return sqrt((x - geometry.x) * (x - geometry.x) + (y - geometry.y) * (y - geometry.y)) - geometry.radius;
+    return edgeBvhSignedDistance(geometry.bvh, x, y);
+}
+
+float obstacleClosestPoint(const ObstacleGeometry &geometry, float x, float y, float &closestX, float &closestY)
+{
+    if (geometry.outline.empty())
+    {
+        float dx = x - geometry.x, dy = y - geometry.y;
+        float distance = std::max(std::sqrt(dx * dx + dy * dy), 1e-6f);
+        closestX = geometry.x + dx / distance * geometry.radius;
+        closestY = geometry.y + dy / distance * geometry.radius;
+        return distance - geometry.radius;
+    }
+    float distance = edgeBvhClosestPoint(geometry.bvh, x, y, closestX, closestY);
+    return edgeBvhInside(geometry.bvh, x, y) ? -distance : distance;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "edge_bvh.h"
+
+#include <deque>
+#include <vector>
+
+// Wind tunnel obstacle outlines, tessellated once per change of shape or
+// parameters and shared by collision, rendering and the distance field.
+// Distance queries go through a BVH over the outline's edges, so imported
+// polygons with thousands of edges cost about as much as the built-in shapes.
+
+// Shape types for aerodynamics demo
+enum class ObstacleShape
+{
+    BALL,
+    TRIANGLE,
+    AIRFOIL,
+    POLYGON // Imported outline
+};
+
+// NACA 4-digit airfoil, as fractions of the chord
+struct AirfoilParams
+{
+    float camber;         // Maximum camber (first digit / 100)
+    float camberPosition; // Chordwise position of the maximum camber (second digit / 10)
+    float thickness;      // Maximum thickness (last two digits / 100)
+    float angleOfAttack;  // Radians, positive nose up
+};
+
+// Imported obstacle, normalised so its bounding box is centred on the origin
+// with the longer side 2 units long
+struct ObstaclePolygon
+{
+    TaggedVector<float, MEMORY_OBSTACLES> points; // x/y pairs
+    TaggedVector<int, MEMORY_OBSTACLES> ringEnds; // One past the last point of each closed ring
+};
+
+// Points per airfoil surface; stations are cosine spaced to resolve the nose
+const int AIRFOIL_SURFACE_POINTS = 48;
+
+struct ObstacleGeometry
+{
+    // What the outline was built for
+    bool built;
+    ObstacleShape shape;
+    float x, y, radius;
+    AirfoilParams airfoil;
+    const ObstaclePolygon *polygon;
+
+    unsigned int version;                            // Incremented on every rebuild
+    TaggedVector<float, MEMORY_OBSTACLES> outline;   // Closed rings as x/y pairs; empty for the ball
+    TaggedVector<int, MEMORY_OBSTACLES> ringEnds;    // One past the last point of each ring
+    TaggedVector<float, MEMORY_OBSTACLES> triangles; // Filled interior as x/y triples, for rendering
+    EdgeBvh bvh;                                     // Over the outline's edges
+    float minX, minY, maxX, maxY;                    // Bounds of the obstacle
+};
+
+// One obstacle of a wind tunnel layout, placed and sized on its own
+struct ObstacleInstance
+{
+    ObstacleShape shape;
+    float x, y, radius;
+    AirfoilParams airfoil;
+    const ObstaclePolygon *polygon;
+    ObstacleGeometry geometry;
+};
+
+// Read an obstacle from a polyline file (one "x y" pair per line, blank lines
+// between rings, # comments) or from the path data of an SVG file (M, L, H,
+// V, C, S, Q and Z commands; curves are flattened). Rings must not overlap.
+bool loadObstaclePolygon(const char *path, ObstaclePolygon &polygon);
+
+// Read a layout with one obstacle per line (# comments):
+//   ball X Y R
+//   triangle X Y R
+//   airfoil X Y R [NACA [DEGREES]]
+//   polygon X Y R FILE
+// Outlines are loaded into polygons, which must outlive the obstacles.
+bool loadObstacleLayout(const char *path, TaggedVector<ObstacleInstance, MEMORY_OBSTACLES> &obstacles, std::deque<ObstaclePolygon> &polygons);
+
+// Parse a designation such as "2412"; returns false unless it is four digits
+bool parseNacaDesignation(const char *digits, AirfoilParams &params);
+
+// Rebuild the outline if any input differs from the last build; returns whether it did.
+// Airfoils span a chord of 2 * radius centred on (x, y). Their outline is the
+// upper surface from the leading edge to the trailing edge followed by the
+// lower surface back again, with the two surfaces at the same stations.
+// Polygons are scaled by radius and centred on (x, y); without one loaded the
+// POLYGON shape falls back to the ball.
+bool updateObstacleGeometry(ObstacleGeometry &geometry, ObstacleShape shape, float x, float y, float radius,
+                            const AirfoilParams &airfoil, const ObstaclePolygon *polygon);
+
+// Signed distance to the obstacle (negative inside)
+float obstacleSignedDistance(const ObstacleGeometry &geometry, float x, float y);
+
+// Nearest point on the obstacle's boundary; returns the signed distance to it
+float obstacleClosestPoint(const ObstacleGeometry &geometry, float x, float y, float &closestX, float &closestY);
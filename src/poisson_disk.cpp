@@ -0,0 +1,269 @@
+#include "poisson_disk.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <thread>
+
+// Directions tried around each active disk before it is retired
+const int POISSON_ATTEMPTS = 16;
+
+// Candidates are placed just outside contact with their parent; the small gap
+// keeps float rounding from producing touching disks
+const float POISSON_GAP = 1e-3f;
+
+// Fraction of the region a maximal set covers, counted as count disks of the
+// requested mean radius (measured 0.65 to 0.75 depending on the spread)
+const float POISSON_FILL = 0.6f;
+
+// Tile edge in grid cells (grown if the search reach needs it)
+const int POISSON_TILE_CELLS = 64;
+
+const float POISSON_PI = 3.14159265358979f;
+
+// Uniform float in [0, 1) from the low-quality but fast minstd generator
+static inline float randomUnit(std::minstd_rand &rng)
+{
+    return (float)(rng() - 1) * (1.0f / 2147483646.0f);
+}
+
+struct PoissonGrid
+{
+    float minX, minY, maxX, maxY;
+    float minRadius, maxRadius;
+    float cellSize, inverseCell;
+    int width, height;             // Cells covering the region
+    int padding;                   // Empty cells around the region so lookups need no bounds checks
+    int stride;                    // width + 2 * padding
+    std::vector<DiskSample> cells; // At most one disk per cell; radius 0 when empty
+    std::vector<int> offsets;      // Neighbour cells that can hold an overlapping disk, nearest first
+    int band;                      // Cells around a tile whose disks can seed candidates in it
+    int tileCells;
+    float directionX[POISSON_ATTEMPTS], directionY[POISSON_ATTEMPTS]; // Candidate directions
+};
+
+float poissonDiskRadius(float width, float height, int count, float packingFraction, float radiusSpread)
+{
+    // E[r^2] for r uniform in R * [1 - s, 1 + s] is R^2 (1 + s^2 / 3)
+    float meanSquare = 1.0f + radiusSpread * radiusSpread / 3.0f;
+    return std::sqrt(packingFraction * width * height / (count * POISSON_PI * meanSquare));
+}
+
+static inline DiskSample &gridCell(PoissonGrid &grid, int cx, int cy)
+{
+    return grid.cells[(size_t)(cy + grid.padding) * grid.stride + cx + grid.padding];
+}
+
+static bool fitsInGrid(const PoissonGrid &grid, float x, float y, float radius, int cx, int cy)
+{
+    const DiskSample *centre = &grid.cells[(size_t)(cy + grid.padding) * grid.stride + cx + grid.padding];
+    for (int offset : grid.offsets)
+    {
+        const DiskSample &other = centre[offset];
+        if (other.radius == 0.0f)
+            continue;
+        float dx = x - other.x, dy = y - other.y;
+        float minDistance = radius + other.radius;
+        if (dx * dx + dy * dy < minDistance * minDistance)
+            return false;
+    }
+    return true;
+}
+
+// Bridson sampling restricted to one tile; reads disks around the tile, writes only inside it
+static void sampleTile(PoissonGrid &grid, int tileX, int tileY, unsigned int seed)
+{
+    int x0 = tileX * grid.tileCells, y0 = tileY * grid.tileCells;
+    int x1 = std::min(x0 + grid.tileCells, grid.width), y1 = std::min(y0 + grid.tileCells, grid.height);
+    std::minstd_rand rng(seed);
+    float radiusRange = grid.maxRadius - grid.minRadius;
+
+    // Attempt to add a disk, returning whether it was placed
+    std::vector<DiskSample> active;
+    auto tryPlace = [&](float x, float y, float radius) {
+        if (x - radius < grid.minX || x + radius > grid.maxX || y - radius < grid.minY || y + radius > grid.maxY)
+            return false;
+        int cx = (int)((x - grid.minX) * grid.inverseCell);
+        int cy = (int)((y - grid.minY) * grid.inverseCell);
+        if (cx < x0 || cx >= x1 || cy < y0 || cy >= y1)
+            return false;
+        if (!fitsInGrid(grid, x, y, radius, cx, cy))
+            return false;
+        DiskSample disk = {x, y, radius};
+        gridCell(grid, cx, cy) = disk;
+        active.push_back(disk);
+        return true;
+    };
+
+    // Grow from the disks that neighbouring tiles already placed near the border
+    for (int cy = std::max(y0 - grid.band, 0); cy < std::min(y1 + grid.band, grid.height); cy++)
+    {
+        for (int cx = std::max(x0 - grid.band, 0); cx < std::min(x1 + grid.band, grid.width); cx++)
+        {
+            if (cx >= x0 && cx < x1 && cy >= y0 && cy < y1)
+                continue;
+            const DiskSample &disk = gridCell(grid, cx, cy);
+            if (disk.radius > 0.0f)
+                active.push_back(disk);
+        }
+    }
+
+    // Otherwise start from a random dart
+    float tileMinX = grid.minX + x0 * grid.cellSize, tileMinY = grid.minY + y0 * grid.cellSize;
+    float tileWidth = (x1 - x0) * grid.cellSize, tileHeight = (y1 - y0) * grid.cellSize;
+    for (int attempt = 0; active.empty() && attempt < POISSON_ATTEMPTS; attempt++)
+    {
+        float radius = grid.minRadius + radiusRange * randomUnit(rng);
+        tryPlace(tileMinX + tileWidth * randomUnit(rng), tileMinY + tileHeight * randomUnit(rng), radius);
+    }
+
+    // Candidates sit just outside contact with the parent at evenly spaced
+    // angles from a random start. One sweep around the parent tries every
+    // direction, so a parent is visited once and then retired.
+    while (!active.empty())
+    {
+        size_t pick = std::min((size_t)(randomUnit(rng) * active.size()), active.size() - 1);
+        DiskSample parent = active[pick];
+        active[pick] = active.back();
+        active.pop_back();
+
+        // Rotate the fixed directions by a random start angle
+        float start = 2.0f * POISSON_PI * randomUnit(rng);
+        float startCos = std::cos(start), startSin = std::sin(start);
+        for (int attempt = 0; attempt < POISSON_ATTEMPTS; attempt++)
+        {
+            float radius = radiusRange > 0.0f ? grid.minRadius + radiusRange * randomUnit(rng) : grid.minRadius;
+            float distance = (parent.radius + radius) * (1.0f + POISSON_GAP);
+            float dirX = grid.directionX[attempt] * startCos - grid.directionY[attempt] * startSin;
+            float dirY = grid.directionX[attempt] * startSin + grid.directionY[attempt] * startCos;
+            tryPlace(parent.x + distance * dirX, parent.y + distance * dirY, radius);
+        }
+    }
+}
+
+// Maximal set of disks with radii scaled by inflate, in grid order
+static std::vector<DiskSample> sampleMaximalSet(const PoissonDiskParams &params, float inflate)
+{
+    PoissonGrid grid;
+    grid.minX = params.minX;
+    grid.minY = params.minY;
+    grid.maxX = params.maxX;
+    grid.maxY = params.maxY;
+    float width = params.maxX - params.minX, height = params.maxY - params.minY;
+    grid.minRadius = inflate * params.radius * (1.0f - params.radiusSpread);
+    grid.maxRadius = inflate * params.radius * (1.0f + params.radiusSpread);
+
+    // Disk centres are at least 2 * minRadius apart, so a cell whose diagonal
+    // is that long holds at most one
+    grid.cellSize = grid.minRadius * std::sqrt(2.0f);
+    grid.inverseCell = 1.0f / grid.cellSize;
+    grid.width = std::max(1, (int)std::ceil(width * grid.inverseCell));
+    grid.height = std::max(1, (int)std::ceil(height * grid.inverseCell));
+
+    // Overlap is possible within 2 * maxRadius; keep the cells whose nearest
+    // points are closer than that, nearest first so most rejections are quick
+    int reach = (int)std::ceil(2.0f * grid.maxRadius * grid.inverseCell);
+    float reachSq = 4.0f * grid.maxRadius * grid.maxRadius * grid.inverseCell * grid.inverseCell;
+    grid.padding = reach;
+    grid.stride = grid.width + 2 * reach;
+    grid.cells.assign((size_t)grid.stride * (grid.height + 2 * reach), DiskSample{0.0f, 0.0f, 0.0f});
+    std::vector<std::pair<int, int>> neighbours; // (squared cell distance, offset)
+    for (int dy = -reach; dy <= reach; dy++)
+    {
+        for (int dx = -reach; dx <= reach; dx++)
+        {
+            float gx = (float)std::max(std::abs(dx) - 1, 0), gy = (float)std::max(std::abs(dy) - 1, 0);
+            if (gx * gx + gy * gy < reachSq)
+                neighbours.push_back(std::make_pair(dx * dx + dy * dy, dy * grid.stride + dx));
+        }
+    }
+    std::sort(neighbours.begin(), neighbours.end());
+    for (const std::pair<int, int> &neighbour : neighbours)
+        grid.offsets.push_back(neighbour.second);
+    for (int i = 0; i < POISSON_ATTEMPTS; i++)
+    {
+        grid.directionX[i] = std::cos(2.0f * POISSON_PI * i / POISSON_ATTEMPTS);
+        grid.directionY[i] = std::sin(2.0f * POISSON_PI * i / POISSON_ATTEMPTS);
+    }
+    grid.band = (int)std::ceil(2.0f * grid.maxRadius * (1.0f + POISSON_GAP) * grid.inverseCell) + 1;
+    grid.tileCells = std::max(POISSON_TILE_CELLS, std::max(reach, grid.band) + 1);
+
+    int tilesX = (grid.width + grid.tileCells - 1) / grid.tileCells;
+    int tilesY = (grid.height + grid.tileCells - 1) / grid.tileCells;
+    int threadCount = params.threads > 0 ? params.threads : (int)std::max(1u, std::thread::hardware_concurrency());
+
+    // Tiles of one phase share no cells within reach of each other
+    for (int phase = 0; phase < 4; phase++)
+    {
+        std::vector<int> tiles;
+        for (int ty = phase / 2; ty < tilesY; ty += 2)
+            for (int tx = phase % 2; tx < tilesX; tx += 2)
+                tiles.push_back(ty * tilesX + tx);
+
+        std::atomic<size_t> nextTile(0);
+        auto worker = [&]() {
+            for (size_t t = nextTile++; t < tiles.size(); t = nextTile++)
+            {
+                int tile = tiles[t];
+                sampleTile(grid, tile % tilesX, tile / tilesX, params.seed * 2654435761u + (unsigned int)tile * 40503u + 1u);
+            }
+        };
+        int workers = std::min(threadCount, (int)tiles.size());
+        std::vector<std::thread> threads;
+        for (int i = 1; i < workers; i++)
+            threads.emplace_back(worker);
+        worker();
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+
+    std::vector<DiskSample> disks;
+    for (int cy = 0; cy < grid.height; cy++)
+    {
+        for (int cx = 0; cx < grid.width; cx++)
+        {
+            const DiskSample &disk = gridCell(grid, cx, cy);
+            if (disk.radius > 0.0f)
+                disks.push_back(DiskSample{disk.x, disk.y, disk.radius / inflate});
+        }
+    }
+    return disks;
+}
+
+std::vector<DiskSample> poissonDiskSample(const PoissonDiskParams &params)
+{
+    PROFILE_ZONE("poissonDiskSample");
+
+    // When fewer disks are wanted than a maximal set would hold, sample with
+    // inflated radii so that it holds just over count. That leaves even gaps
+    // between the disks and skips sampling disks that would only be dropped.
+    // Small counts lose more to the walls, so deflate until enough fit.
+    float inflate = 1.0f;
+    if (params.count > 0)
+    {
+        float fill = params.radius / poissonDiskRadius(params.maxX - params.minX, params.maxY - params.minY,
+                                                       params.count, 1.0f, params.radiusSpread);
+        fill *= fill;
+        if (fill < POISSON_FILL)
+            inflate = std::sqrt(POISSON_FILL / fill);
+    }
+    std::vector<DiskSample> disks = sampleMaximalSet(params, inflate);
+    while (inflate > 1.0f && disks.size() < (size_t)params.count)
+    {
+        inflate = std::max(1.0f, inflate * 0.9f);
+        disks = sampleMaximalSet(params, inflate);
+    }
+
+    // Uniform random subset (or order) by a partial Fisher-Yates shuffle
+    std::minstd_rand rng(params.seed);
+    size_t wanted = params.count > 0 ? std::min((size_t)params.count, disks.size()) : disks.size();
+    for (size_t i = 0; i < wanted && i + 1 < disks.size(); i++)
+    {
+        size_t j = i + rng() % (disks.size() - i);
+        std::swap(disks[i], disks[j]);
+    }
+    disks.resize(wanted);
+    return disks;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+
+// Poisson-disk placement of non-overlapping disks (Bridson's algorithm). A
+// background grid with at most one disk per cell answers the overlap tests.
+// The region is split into tiles that are sampled in four checkerboard
+// phases; tiles of one phase are at least a tile apart, so they run in
+// parallel without locking, and each tile has its own generator, so the
+// result does not depend on the thread count.
+
+struct DiskSample
+{
+    float x, y, radius;
+};
+
+struct PoissonDiskParams
+{
+    float minX, minY, maxX, maxY; // Region the disks must lie in, whole disk inside
+    float radius;                 // Mean radius
+    float radiusSpread;           // Radii uniform in radius * [1 - spread, 1 + spread], spread < 1
+    int count;                    // Disks wanted, drawn uniformly from the maximal set; 0 = all of them
+    unsigned int seed;
+    int threads;                  // 0 = one per hardware thread
+};
+
+// Mean radius at which count disks with the given spread cover packingFraction
+// of a width x height region
+float poissonDiskRadius(float width, float height, int count, float packingFraction, float radiusSpread);
+
+// Disks in random order. Fewer than params.count come back if they do not fit;
+// a maximal set covers roughly 0.65 of the region. Counts well below that are
+// sampled with proportionally larger spacing, so the disks spread over the
+// whole region with even gaps.
+std::vector<DiskSample> poissonDiskSample(const PoissonDiskParams &params);
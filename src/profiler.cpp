@@ -0,0 +1,171 @@
+#include "profiler.h"
+
+#if PHYSICS_PROFILER
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PROFILER_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILER_RDTSC 1
+#endif
+
+// Events kept per thread; beyond this a thread's further zones are dropped
+const size_t PROFILER_MAX_EVENTS_PER_THREAD = 1 << 20;
+
+struct ProfileEvent
+{
+    const char *name; // NULL for end events
+    unsigned long long ticks;
+    char phase; // 'B' or 'E'
+};
+
+struct ProfileThreadBuffer
+{
+    std::vector<ProfileEvent> events;
+    std::string name;
+    int tid;
+    int skipDepth; // Open zones whose begin was dropped
+    size_t dropped;
+};
+
+std::atomic<bool> profilerActive(false);
+
+// Buffers are owned here so they outlive their threads for export
+static std::mutex profilerMutex;
+static std::vector<std::unique_ptr<ProfileThreadBuffer>> profilerBuffers;
+static thread_local ProfileThreadBuffer *threadBuffer = nullptr;
+
+// Clock calibration: ticks at start and the matching steady_clock time
+static unsigned long long startTicks;
+static std::chrono::steady_clock::time_point startTime;
+
+static inline unsigned long long profilerTicks()
+{
+#ifdef PROFILER_RDTSC
+    return __rdtsc();
+#else
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+}
+
+static ProfileThreadBuffer *currentBuffer()
+{
+    if (!threadBuffer)
+    {
+        std::unique_ptr<ProfileThreadBuffer> buffer(new ProfileThreadBuffer());
+        buffer->events.reserve(1 << 14);
+        buffer->skipDepth = 0;
+        buffer->dropped = 0;
+        std::lock_guard<std::mutex> lock(profilerMutex);
+        buffer->tid = (int)profilerBuffers.size() + 1;
+        buffer->name = "thread " + std::to_string(buffer->tid);
+        threadBuffer = buffer.get();
+        profilerBuffers.push_back(std::move(buffer));
+    }
+    return threadBuffer;
+}
+
+void profilerRecord(const char *name, char phase)
+{
+    unsigned long long ticks = profilerTicks();
+    ProfileThreadBuffer *buffer = currentBuffer();
+    if (phase == 'B')
+    {
+        // Keep room for the end events of zones already open
+        if (buffer->skipDepth > 0 || buffer->events.size() >= PROFILER_MAX_EVENTS_PER_THREAD - 256)
+        {
+            buffer->skipDepth++;
+            buffer->dropped++;
+            return;
+        }
+    }
+    else if (buffer->skipDepth > 0)
+    {
+        buffer->skipDepth--;
+        return;
+    }
+    buffer->events.push_back({name, ticks, phase});
+}
+
+void startProfiler()
+{
+    startTime = std::chrono::steady_clock::now();
+    startTicks = profilerTicks();
+    profilerActive = true;
+}
+
+void profilerSetThreadName(const char *name)
+{
+    ProfileThreadBuffer *buffer = currentBuffer();
+    std::lock_guard<std::mutex> lock(profilerMutex);
+    buffer->name = name;
+}
+
+bool writeProfilerTrace(const char *path)
+{
+    profilerActive = false;
+    unsigned long long endTicks = profilerTicks();
+    double elapsedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+    double ticksPerUs = elapsedUs > 0.0 ? (endTicks - startTicks) / elapsedUs : 1000.0;
+
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        std::cerr << "ERROR::PROFILER::FILE_NOT_OPENED " << path << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(profilerMutex);
+    size_t eventCount = 0, dropped = 0;
+    bool first = true;
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (const std::unique_ptr<ProfileThreadBuffer> &buffer : profilerBuffers)
+    {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", buffer->tid, buffer->name.c_str());
+        first = false;
+
+        // Zones still open when recording stopped are closed at the end
+        int depth = 0;
+        for (const ProfileEvent &event : buffer->events)
+        {
+            double ts = (event.ticks - startTicks) / ticksPerUs;
+            if (event.phase == 'B')
+            {
+                fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}", event.name, ts, buffer->tid);
+                depth++;
+            }
+            else
+            {
+                fprintf(file, ",\n{\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}", ts, buffer->tid);
+                depth--;
+            }
+        }
+        for (; depth > 0; depth--)
+            fprintf(file, ",\n{\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}", elapsedUs, buffer->tid);
+
+        eventCount += buffer->events.size();
+        dropped += buffer->dropped;
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    std::cout << "Profiler: wrote " << eventCount << " events from " << profilerBuffers.size() << " threads to " << path;
+    if (dropped > 0)
+        std::cout << " (" << dropped << " zones dropped, buffers full)";
+    std::cout << std::endl;
+    return true;
+}
+
+#endif
@@ -0,0 +1,77 @@
+#pragma once
+
+// Scoped-zone profiler. Zones are recorded as begin/end events into a
+// thread-local buffer per thread (no locking on the hot path) with RDTSC
+// timestamps where available, steady_clock elsewhere, and written out as
+// Chrome trace-event JSON that opens in Perfetto (ui.perfetto.dev) or
+// chrome://tracing.
+//
+//   PROFILE_ZONE("updateBall");      // until the end of the enclosing scope
+//   PROFILE_BEGIN("Render"); ... PROFILE_END();
+//
+// Compiled out completely when NDEBUG is defined (release builds) unless
+// PHYSICS_PROFILER=1 is defined explicitly; zones then expand to nothing.
+
+#ifndef PHYSICS_PROFILER
+#ifdef NDEBUG
+#define PHYSICS_PROFILER 0
+#else
+#define PHYSICS_PROFILER 1
+#endif
+#endif
+
+#if PHYSICS_PROFILER
+
+#include <atomic>
+
+extern std::atomic<bool> profilerActive;
+
+void profilerRecord(const char *name, char phase);
+
+inline void profilerBegin(const char *name)
+{
+    if (profilerActive.load(std::memory_order_relaxed))
+        profilerRecord(name, 'B');
+}
+
+inline void profilerEnd()
+{
+    if (profilerActive.load(std::memory_order_relaxed))
+        profilerRecord(nullptr, 'E');
+}
+
+struct ProfileZone
+{
+    explicit ProfileZone(const char *name) { profilerBegin(name); }
+    ~ProfileZone() { profilerEnd(); }
+    ProfileZone(const ProfileZone &) = delete;
+    ProfileZone &operator=(const ProfileZone &) = delete;
+};
+
+// Start recording on all threads; zones before this are ignored
+void startProfiler();
+
+// Label the calling thread in the trace
+void profilerSetThreadName(const char *name);
+
+// Stop recording and write everything recorded so far. Call once the threads
+// that recorded have finished. Returns false if the file cannot be written.
+bool writeProfilerTrace(const char *path);
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_BEGIN(name) profilerBegin(name)
+#define PROFILE_END() profilerEnd()
+
+#else
+
+inline void startProfiler() {}
+inline void profilerSetThreadName(const char *) {}
+inline bool writeProfilerTrace(const char *) { return false; }
+
+#define PROFILE_ZONE(name)
+#define PROFILE_BEGIN(name)
+#define PROFILE_END()
+
+#endif
@@ -0,0 +1,43 @@
+#include "retained_scene.h"
+
+#include <glad/glad.h>
+
+void initRetainedScene(RetainedScene &scene, int itemCount)
+{
+    scene.vertices.clear();
+    scene.ranges.assign(itemCount, SceneRange{GL_TRIANGLES, 0, 0});
+    scene.itemStart = 0;
+    scene.dirty = true;
+    scene.builds = 0;
+}
+
+void invalidateRetainedScene(RetainedScene &scene)
+{
+    scene.dirty = true;
+}
+
+void beginRetainedScene(RetainedScene &scene)
+{
+    scene.vertices.clear();
+    for (SceneRange &range : scene.ranges)
+        range.count = 0;
+}
+
+float *beginSceneItem(RetainedScene &scene, int maxVertices)
+{
+    scene.itemStart = scene.vertices.size();
+    scene.vertices.resize(scene.itemStart + maxVertices * 6);
+    return &scene.vertices[scene.itemStart];
+}
+
+void endSceneItem(RetainedScene &scene, int item, unsigned int mode, int floatsWritten)
+{
+    scene.vertices.resize(scene.itemStart + floatsWritten);
+    scene.ranges[item] = SceneRange{mode, (int)(scene.itemStart / 6), floatsWritten / 6};
+}
+
+void endRetainedScene(RetainedScene &scene)
+{
+    scene.dirty = false;
+    scene.builds++;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "memory_tracker.h"
+
+#include <cstddef>
+#include <vector>
+
+// Retained geometry for static UI (buttons, box walls, the obstacle). Every
+// item is built once into a CPU vertex list that the draw batch keeps at the
+// front of its vertex buffer; frames then only reference ranges of it. Items
+// are rebuilt together, and only after the scene is invalidated (window
+// resize, obstacle shape change).
+
+struct SceneRange
+{
+    unsigned int mode; // GL primitive type
+    int first;         // First vertex within the scene
+    int count;
+};
+
+struct RetainedScene
+{
+    TaggedVector<float, MEMORY_SCENE_VERTICES> vertices; // Position + colour, 6 floats per vertex
+    std::vector<SceneRange> ranges; // Indexed by the caller's item ids
+    size_t itemStart; // Float offset of the item being built
+    bool dirty;
+    int builds; // Rebuilds so far
+};
+
+void initRetainedScene(RetainedScene &scene, int itemCount);
+void invalidateRetainedScene(RetainedScene &scene);
+
+// Rebuild: clear the scene, then for each item reserve room for maxVertices,
+// write them through the returned pointer and close the item with the number
+// of floats written. endRetainedScene marks the scene clean; hand it to
+// setDrawBatchScene afterwards to upload it.
+void beginRetainedScene(RetainedScene &scene);
+float *beginSceneItem(RetainedScene &scene, int maxVertices);
+void endSceneItem(RetainedScene &scene, int item, unsigned int mode, int floatsWritten);
+void endRetainedScene(RetainedScene &scene);
@@ -0,0 +1,256 @@
+#include "shader_cache.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Program binary tokens (GL 4.1), not in the 3.3 headers
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+typedef void(APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void(APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void(APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+
+static GetProgramBinaryProc getProgramBinary = NULL;
+static ProgramBinaryProc programBinary = NULL;
+static ProgramParameteriProc programParameteri = NULL;
+static std::string cacheDirectory;
+static std::string driverString;
+
+// Cache file header
+static const uint32_t CACHE_MAGIC = 0x42534450; // "PDSB"
+struct CacheHeader
+{
+    uint32_t magic;
+    uint32_t format;
+    uint32_t length;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static double millisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// 64-bit FNV-1a, chained over several strings
+static uint64_t hashString(uint64_t hash, const char *text)
+{
+    for (const unsigned char *c = (const unsigned char *)text; *c; c++)
+    {
+        hash ^= *c;
+        hash *= 1099511628211ull;
+    }
+    // Separator so "ab"+"c" and "a"+"bc" differ
+    hash ^= 0xff;
+    hash *= 1099511628211ull;
+    return hash;
+}
+
+static bool hasExtension(const char *name)
+{
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int i = 0; i < count; i++)
+    {
+        const char *extension = (const char *)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+void initShaderCache(const char *directory, GLADloadproc loadProc)
+{
+    cacheDirectory = directory;
+    driverString = std::string((const char *)glGetString(GL_VENDOR)) + "|" +
+                   (const char *)glGetString(GL_RENDERER) + "|" +
+                   (const char *)glGetString(GL_VERSION);
+
+    int major = 0, minor = 0, formats = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    bool supported = major > 4 || (major == 4 && minor >= 1) || hasExtension("GL_ARB_get_program_binary");
+    if (supported)
+    {
+        getProgramBinary = (GetProgramBinaryProc)loadProc("glGetProgramBinary");
+        programBinary = (ProgramBinaryProc)loadProc("glProgramBinary");
+        programParameteri = (ProgramParameteriProc)loadProc("glProgramParameteri");
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    }
+    if (!getProgramBinary || !programBinary || !programParameteri || formats <= 0)
+    {
+        getProgramBinary = NULL;
+        programBinary = NULL;
+        programParameteri = NULL;
+        std::cout << "Program binaries not supported by this driver, shaders will be compiled on every launch" << std::endl;
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(cacheDirectory, error);
+}
+
+// Compile a single shader stage, printing the info log on failure
+static unsigned int compileShader(GLenum type, const char *source, const char *name)
+{
+    unsigned int shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    int success;
+    char infoLog[512];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        std::cerr << "ERROR::SHADER::" << name << "::" << (type == GL_VERTEX_SHADER ? "VERTEX" : "FRAGMENT")
+                  << "::COMPILATION_FAILED\n"
+                  << infoLog << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+// Try to create the program from a cached binary
+static unsigned int loadCachedProgram(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return 0;
+
+    CacheHeader header;
+    if (!file.read((char *)&header, sizeof(header)) || header.magic != CACHE_MAGIC || header.length == 0)
+        return 0;
+    std::vector<char> binary(header.length);
+    if (!file.read(binary.data(), header.length))
+        return 0;
+
+    unsigned int program = glCreateProgram();
+    programBinary(program, header.format, binary.data(), header.length);
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        // Driver update or corrupted file; recompile and overwrite
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+static void storeCachedProgram(unsigned int program, const std::string &path)
+{
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    getProgramBinary(program, length, NULL, &format, binary.data());
+
+    // Write to a temporary file first so a concurrent launch never reads a partial binary
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return;
+        CacheHeader header = {CACHE_MAGIC, format, (uint32_t)length};
+        file.write((const char *)&header, sizeof(header));
+        file.write(binary.data(), length);
+        if (!file)
+            return;
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+}
+
+unsigned int buildShaderProgram(const char *name, const char *vertexSource, const char *fragmentSource,
+                                const char *const *feedbackVaryings, int feedbackVaryingCount)
+{
+    // Cache key: every input that affects the linked program
+    std::string path;
+    if (programBinary)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        hash = hashString(hash, driverString.c_str());
+        hash = hashString(hash, vertexSource);
+        hash = hashString(hash, fragmentSource ? fragmentSource : "");
+        for (int i = 0; i < feedbackVaryingCount; i++)
+            hash = hashString(hash, feedbackVaryings[i]);
+
+        char key[17];
+        snprintf(key, sizeof(key), "%016llx", (unsigned long long)hash);
+        path = cacheDirectory + "/" + name + "-" + key + ".bin";
+
+        Clock::time_point loadStart = Clock::now();
+        unsigned int program = loadCachedProgram(path);
+        if (program)
+        {
+            std::cout << "Shader program '" << name << "': loaded from cache in " << millisecondsSince(loadStart) << " ms" << std::endl;
+            return program;
+        }
+    }
+
+    // Cache miss: compile from source
+    Clock::time_point compileStart = Clock::now();
+    unsigned int vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource, name);
+    unsigned int fragmentShader = fragmentSource ? compileShader(GL_FRAGMENT_SHADER, fragmentSource, name) : 0;
+    double compileTime = millisecondsSince(compileStart);
+    if (!vertexShader || (fragmentSource && !fragmentShader))
+    {
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        return 0;
+    }
+
+    Clock::time_point linkStart = Clock::now();
+    unsigned int program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    if (fragmentShader)
+        glAttachShader(program, fragmentShader);
+    if (feedbackVaryingCount > 0)
+        glTransformFeedbackVaryings(program, feedbackVaryingCount, feedbackVaryings, GL_INTERLEAVED_ATTRIBS);
+    if (programParameteri)
+        programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(program);
+
+    // Shaders are linked into the program and no longer necessary
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    int success;
+    char infoLog[512];
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
+        std::cerr << "ERROR::SHADER::" << name << "::LINKING_FAILED\n"
+                  << infoLog << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+    double linkTime = millisecondsSince(linkStart);
+
+    if (programBinary)
+        storeCachedProgram(program, path);
+
+    std::cout << "Shader program '" << name << "': compiled in " << compileTime << " ms, linked in " << linkTime << " ms" << std::endl;
+    return program;
+}
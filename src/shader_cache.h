@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <glad/glad.h>
+
+// Shader program manager with an on-disk program binary cache. Linked
+// programs are saved with glGetProgramBinary, keyed by a hash of their sources
+// and the driver's vendor/renderer/version strings, and reloaded with
+// glProgramBinary on the next launch. Any cache miss or rejected binary falls
+// back to compiling from source. Compile, link and load times are logged per
+// program.
+
+// Resolve the program binary entry points (GL 4.1 / ARB_get_program_binary;
+// not part of the 3.3 loader) and pick the cache directory. Without driver
+// support every program is simply compiled.
+void initShaderCache(const char *directory, GLADloadproc loadProc);
+
+// Build (or load from cache) a program from a vertex and optional fragment
+// shader. Transform feedback varyings, if any, are captured interleaved.
+// Returns 0 if compilation or linking fails.
+unsigned int buildShaderProgram(const char *name, const char *vertexSource, const char *fragmentSource,
+                                const char *const *feedbackVaryings = NULL, int feedbackVaryingCount = 0);
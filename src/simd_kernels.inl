@@ -0,0 +1,216 @@
+// SIMD kernels, included once per instruction set by the simd_kernels_*.cpp
+// units with SIMD_KERNELS_TABLE naming the table they define. Everything here
+// must have internal linkage apart from that table (see cpu_dispatch.h).
+
+#include "cpu_dispatch.h"
+#include "simd_lane.h"
+
+#if defined(__AVX512F__)
+#define SIMD_KERNELS_NAME "AVX-512"
+#elif defined(__AVX2__)
+#define SIMD_KERNELS_NAME "AVX2"
+#elif defined(__AVX__)
+#define SIMD_KERNELS_NAME "AVX"
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_KERNELS_NAME "SSE2"
+#else
+#define SIMD_KERNELS_NAME "scalar"
+#endif
+
+static void gravityList(const float *lx, const float *ly, const float *lm, int count, float bodyX, float bodyY,
+                        float softeningSq, float sums[3])
+{
+    Lane x = splat(bodyX), y = splat(bodyY), soft = splat(softeningSq), one = splat(1.0f);
+    Lane ax = splat(0.0f), ay = splat(0.0f), phi = splat(0.0f);
+    for (int k = 0; k < count; k += LANES)
+    {
+        Lane dx = sub(load(lx + k), x), dy = sub(load(ly + k), y);
+        Lane inverse = div(one, root(add(add(mul(dx, dx), mul(dy, dy)), soft)));
+        Lane weighted = mul(load(lm + k), inverse);
+        Lane cubed = mul(weighted, mul(inverse, inverse));
+        ax = add(ax, mul(cubed, dx));
+        ay = add(ay, mul(cubed, dy));
+        phi = add(phi, weighted);
+    }
+    float sumX[LANES], sumY[LANES], sumPhi[LANES];
+    store(sumX, ax);
+    store(sumY, ay);
+    store(sumPhi, phi);
+    sums[0] = sums[1] = sums[2] = 0.0f;
+    for (int l = 0; l < LANES; l++)
+    {
+        sums[0] += sumX[l];
+        sums[1] += sumY[l];
+        sums[2] += sumPhi[l];
+    }
+}
+
+static void jacobiRow(const float *x, const float *b, const float *invDiag, float *out, int width, int s, float weight)
+{
+    Lane w = splat(weight);
+    int i = 0;
+    for (; i + LANES <= width; i += LANES)
+    {
+        Lane sum = add(add(load(x + i - 1), load(x + i + 1)), add(load(x + i - s), load(x + i + s)));
+        Lane target = mul(sub(sum, load(b + i)), load(invDiag + i));
+        Lane current = load(x + i);
+        store(out + i, add(current, mul(w, sub(target, current))));
+    }
+    for (; i < width; i++)
+    {
+        float target = (x[i - 1] + x[i + 1] + x[i - s] + x[i + s] - b[i]) * invDiag[i];
+        out[i] = x[i] + weight * (target - x[i]);
+    }
+}
+
+static void residualRow(const float *x, const float *b, const float *diag, const float *fluidMask, float *out, int width, int s)
+{
+    int i = 0;
+    for (; i + LANES <= width; i += LANES)
+    {
+        Lane sum = add(add(load(x + i - 1), load(x + i + 1)), add(load(x + i - s), load(x + i + s)));
+        Lane applied = sub(sum, mul(load(diag + i), load(x + i)));
+        store(out + i, mul(sub(load(b + i), applied), load(fluidMask + i)));
+    }
+    for (; i < width; i++)
+        out[i] = (b[i] - (x[i - 1] + x[i + 1] + x[i - s] + x[i + s] - diag[i] * x[i])) * fluidMask[i];
+}
+
+static void divergenceRow(const float *u, const float *vBottom, const float *vTop, const float *fluidMask, float *out, int width,
+                          float cellSize)
+{
+    Lane h = splat(cellSize);
+    int i = 0;
+    for (; i + LANES <= width; i += LANES)
+    {
+        Lane flux = add(sub(load(u + i + 1), load(u + i)), sub(load(vTop + i), load(vBottom + i)));
+        store(out + i, mul(mul(flux, h), load(fluidMask + i)));
+    }
+    for (; i < width; i++)
+        out[i] = (u[i + 1] - u[i] + vTop[i] - vBottom[i]) * cellSize * fluidMask[i];
+}
+
+static void gradientRow(const float *p, const float *pBelow, const float *open, float *velocity, int count, float inverseH)
+{
+    Lane scale = splat(inverseH);
+    int i = 0;
+    for (; i + LANES <= count; i += LANES)
+    {
+        Lane gradient = mul(sub(load(p + i), load(pBelow + i)), scale);
+        store(velocity + i, sub(load(velocity + i), mul(gradient, load(open + i))));
+    }
+    for (; i < count; i++)
+        velocity[i] -= (p[i] - pBelow[i]) * inverseH * open[i];
+}
+
+// Lane blocks interleaved per ensemble step; a single block is one long
+// dependency chain per step, so interleaving several keeps the FP pipelines busy
+static const int ENSEMBLE_BLOCKS = 4;
+
+// Wall bounce for one square, as in updateSquare
+static inline void bounce(Lane &x, Lane &v, Lane half, Lane left, Lane right, Lane minusOne)
+{
+    Mask hitLeft = lessEqual(sub(x, half), left);
+    Mask hitRight = lessEqual(right, add(x, half));
+    v = select(either(hitLeft, hitRight), mul(v, minusOne), v);
+    x = select(hitLeft, add(left, half), x);
+    x = select(lessEqual(right, add(x, half)), sub(right, half), x);
+}
+
+// The ensemble must match updateSquare bit for bit, so no multiply-add may be
+// fused here even where the target has FMA
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+static void squareEnsembleSteps(const EnsembleArrays &arrays, int firstStep, int steps, int interval, float size, float leftWall,
+                                float rightWall)
+{
+    const Lane half = splat(size * 0.5f);
+    const Lane minDistance = splat(size * 0.5f + size * 0.5f);
+    const Lane minSeparation = splat(0.001f);
+    const Lane left = splat(leftWall);
+    const Lane right = splat(rightWall);
+    const Lane zero = splat(0.0f);
+    const Lane one = splat(1.0f);
+    const Lane minusOne = splat(-1.0f);
+    const Lane two = splat(2.0f);
+    const Lane oneHalf = splat(0.5f);
+
+    // Each group of blocks stays in registers for the whole run
+    for (int base = 0; base < arrays.padded; base += LANES * ENSEMBLE_BLOCKS)
+    {
+        Lane x0[ENSEMBLE_BLOCKS], x1[ENSEMBLE_BLOCKS], v0[ENSEMBLE_BLOCKS], v1[ENSEMBLE_BLOCKS];
+        Lane m0[ENSEMBLE_BLOCKS], m1[ENSEMBLE_BLOCKS], collisions[ENSEMBLE_BLOCKS];
+        Lane totalMass[ENSEMBLE_BLOCKS], twoM0[ENSEMBLE_BLOCKS], twoM1[ENSEMBLE_BLOCKS];
+        for (int b = 0; b < ENSEMBLE_BLOCKS; b++)
+        {
+            int lane = base + b * LANES;
+            x0[b] = load(arrays.x0 + lane);
+            x1[b] = load(arrays.x1 + lane);
+            v0[b] = load(arrays.v0 + lane);
+            v1[b] = load(arrays.v1 + lane);
+            m0[b] = load(arrays.m0 + lane);
+            m1[b] = load(arrays.m1 + lane);
+            collisions[b] = load(arrays.collisions + lane);
+            totalMass[b] = add(m0[b], m1[b]);
+            twoM0[b] = mul(two, m0[b]);
+            twoM1[b] = mul(two, m1[b]);
+        }
+
+        for (int step = firstStep + 1; step <= firstStep + steps; step++)
+        {
+            for (int b = 0; b < ENSEMBLE_BLOCKS; b++)
+            {
+                x0[b] = add(x0[b], v0[b]);
+                x1[b] = add(x1[b], v1[b]);
+                bounce(x0[b], v0[b], half, left, right, minusOne);
+                bounce(x1[b], v1[b], half, left, right, minusOne);
+
+                // Square-square collision, only for lanes that overlap and approach
+                Lane dx = sub(x1[b], x0[b]);
+                Lane distance = absolute(dx);
+                Mask hit = both(both(less(distance, minDistance), less(minSeparation, distance)),
+                                less(mul(sub(v1[b], v0[b]), dx), zero));
+
+                Lane separation = mul(mul(sub(minDistance, distance), oneHalf), select(less(zero, dx), one, minusOne));
+                x0[b] = select(hit, sub(x0[b], separation), x0[b]);
+                x1[b] = select(hit, add(x1[b], separation), x1[b]);
+
+                Lane v0p = div(add(mul(sub(m0[b], m1[b]), v0[b]), mul(twoM1[b], v1[b])), totalMass[b]);
+                Lane v1p = div(add(mul(sub(m1[b], m0[b]), v1[b]), mul(twoM0[b], v0[b])), totalMass[b]);
+                v0[b] = select(hit, v0p, v0[b]);
+                v1[b] = select(hit, v1p, v1[b]);
+                collisions[b] = add(collisions[b], select(hit, one, zero));
+            }
+
+            if (interval > 0 && step % interval == 0)
+            {
+                for (int b = 0; b < ENSEMBLE_BLOCKS; b++)
+                {
+                    size_t sample = (size_t)(step / interval) * arrays.padded + base + b * LANES;
+                    store(arrays.momentumHistory + sample, add(mul(m0[b], v0[b]), mul(m1[b], v1[b])));
+                    store(arrays.energyHistory + sample,
+                          add(mul(mul(mul(oneHalf, m0[b]), v0[b]), v0[b]), mul(mul(mul(oneHalf, m1[b]), v1[b]), v1[b])));
+                }
+            }
+        }
+
+        for (int b = 0; b < ENSEMBLE_BLOCKS; b++)
+        {
+            int lane = base + b * LANES;
+            store(arrays.x0 + lane, x0[b]);
+            store(arrays.x1 + lane, x1[b]);
+            store(arrays.v0 + lane, v0[b]);
+            store(arrays.v1 + lane, v1[b]);
+            store(arrays.collisions + lane, collisions[b]);
+        }
+    }
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+extern const SimdKernels SIMD_KERNELS_TABLE;
+const SimdKernels SIMD_KERNELS_TABLE = {SIMD_KERNELS_NAME, LANES, gravityList, jacobiRow, residualRow, divergenceRow, gradientRow,
+                                        squareEnsembleSteps};
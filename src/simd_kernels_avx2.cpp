@@ -0,0 +1,3 @@
+// AVX2 build of the SIMD kernels, only called on CPUs that report AVX2 and FMA
+#define SIMD_KERNELS_TABLE simdKernelsAvx2
+#include "simd_kernels.inl"
@@ -0,0 +1,3 @@
+// AVX-512 build of the SIMD kernels, only called on CPUs that report AVX-512F
+#define SIMD_KERNELS_TABLE simdKernelsAvx512
+#include "simd_kernels.inl"
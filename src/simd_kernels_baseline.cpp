@@ -0,0 +1,3 @@
+// Baseline build of the SIMD kernels, with the project's default compiler flags
+#define SIMD_KERNELS_TABLE simdKernelsBaseline
+#include "simd_kernels.inl"
@@ -0,0 +1,85 @@
+#pragma once
+
+// Lane type and the handful of operations the SIMD kernels need: 16 floats
+// per lane with AVX-512, 8 with AVX, 4 with SSE2, else plain scalars. Masks
+// are bit masks with AVX-512, all-ones or all-zeros lanes in the other SIMD
+// builds and plain bools in the scalar one. The operations have internal
+// linkage, so translation units built for different instruction sets (see
+// cpu_dispatch.h) each keep their own.
+#if defined(__AVX512F__)
+#include <immintrin.h>
+typedef __m512 Lane;
+typedef __mmask16 Mask;
+const int LANES = 16;
+static inline Lane load(const float *p) { return _mm512_loadu_ps(p); }
+static inline void store(float *p, Lane a) { _mm512_storeu_ps(p, a); }
+static inline Lane splat(float a) { return _mm512_set1_ps(a); }
+static inline Lane add(Lane a, Lane b) { return _mm512_add_ps(a, b); }
+static inline Lane sub(Lane a, Lane b) { return _mm512_sub_ps(a, b); }
+static inline Lane mul(Lane a, Lane b) { return _mm512_mul_ps(a, b); }
+static inline Lane div(Lane a, Lane b) { return _mm512_div_ps(a, b); }
+static inline Lane root(Lane a) { return _mm512_sqrt_ps(a); }
+static inline Lane absolute(Lane a) { return _mm512_abs_ps(a); }
+static inline Mask less(Lane a, Lane b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+static inline Mask lessEqual(Lane a, Lane b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+static inline Mask both(Mask a, Mask b) { return (Mask)(a & b); }
+static inline Mask either(Mask a, Mask b) { return (Mask)(a | b); }
+static inline Lane select(Mask m, Lane a, Lane b) { return _mm512_mask_blend_ps(m, b, a); }
+#elif defined(__AVX__)
+#include <immintrin.h>
+typedef __m256 Lane;
+typedef __m256 Mask;
+const int LANES = 8;
+static inline Lane load(const float *p) { return _mm256_loadu_ps(p); }
+static inline void store(float *p, Lane a) { _mm256_storeu_ps(p, a); }
+static inline Lane splat(float a) { return _mm256_set1_ps(a); }
+static inline Lane add(Lane a, Lane b) { return _mm256_add_ps(a, b); }
+static inline Lane sub(Lane a, Lane b) { return _mm256_sub_ps(a, b); }
+static inline Lane mul(Lane a, Lane b) { return _mm256_mul_ps(a, b); }
+static inline Lane div(Lane a, Lane b) { return _mm256_div_ps(a, b); }
+static inline Lane root(Lane a) { return _mm256_sqrt_ps(a); }
+static inline Lane absolute(Lane a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+static inline Mask less(Lane a, Lane b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+static inline Mask lessEqual(Lane a, Lane b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+static inline Mask both(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+static inline Mask either(Mask a, Mask b) { return _mm256_or_ps(a, b); }
+static inline Lane select(Mask m, Lane a, Lane b) { return _mm256_or_ps(_mm256_and_ps(m, a), _mm256_andnot_ps(m, b)); }
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+typedef __m128 Lane;
+typedef __m128 Mask;
+const int LANES = 4;
+static inline Lane load(const float *p) { return _mm_loadu_ps(p); }
+static inline void store(float *p, Lane a) { _mm_storeu_ps(p, a); }
+static inline Lane splat(float a) { return _mm_set1_ps(a); }
+static inline Lane add(Lane a, Lane b) { return _mm_add_ps(a, b); }
+static inline Lane sub(Lane a, Lane b) { return _mm_sub_ps(a, b); }
+static inline Lane mul(Lane a, Lane b) { return _mm_mul_ps(a, b); }
+static inline Lane div(Lane a, Lane b) { return _mm_div_ps(a, b); }
+static inline Lane root(Lane a) { return _mm_sqrt_ps(a); }
+static inline Lane absolute(Lane a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+static inline Mask less(Lane a, Lane b) { return _mm_cmplt_ps(a, b); }
+static inline Mask lessEqual(Lane a, Lane b) { return _mm_cmple_ps(a, b); }
+static inline Mask both(Mask a, Mask b) { return _mm_and_ps(a, b); }
+static inline Mask either(Mask a, Mask b) { return _mm_or_ps(a, b); }
+static inline Lane select(Mask m, Lane a, Lane b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+#else
+#include <cmath>
+typedef float Lane;
+typedef bool Mask;
+const int LANES = 1;
+static inline Lane load(const float *p) { return *p; }
+static inline void store(float *p, Lane a) { *p = a; }
+static inline Lane splat(float a) { return a; }
+static inline Lane add(Lane a, Lane b) { return a + b; }
+static inline Lane sub(Lane a, Lane b) { return a - b; }
+static inline Lane mul(Lane a, Lane b) { return a * b; }
+static inline Lane div(Lane a, Lane b) { return a / b; }
+static inline Lane root(Lane a) { return sqrtf(a); }
+static inline Lane absolute(Lane a) { return fabsf(a); }
+static inline Mask less(Lane a, Lane b) { return a < b; }
+static inline Mask lessEqual(Lane a, Lane b) { return a <= b; }
+static inline Mask both(Mask a, Mask b) { return a && b; }
+static inline Mask either(Mask a, Mask b) { return a || b; }
+static inline Lane select(Mask m, Lane a, Lane b) { return m ? a : b; }
+#endif
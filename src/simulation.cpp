@@ -0,0 +1,798 @@
+#include "simulation.h"
+#include "poisson_disk.h"
+#include "profiler.h"
+
+#include <cmath>
+#include <algorithm>
+
+// Streams of the demos' counter-based random draws
+const uint32_t RANDOM_BALL_HEADING = 1;
+const uint32_t RANDOM_FLUID_SPAWN = 2;
+const uint32_t RANDOM_FLUID_JITTER = 3;
+
+// Ball initialization function
+void initBalls(BallSim &sim, int count, unsigned int seed, float packingFraction, float radiusSpread)
+{
+    sim.balls.clear();
+    sim.collisions = 0;
+    sim.stats = ConservationStats();
+    sim.seed = seed;
+    setBallGravity(sim, false);
+    if (count <= 0)
+        return;
+
+    float radius = (count <= 5) ? 0.05f : (count <= 10 ? 0.035f : 0.018f);
+    radius = std::min(radius, poissonDiskRadius(BOX_RIGHT - BOX_LEFT, BOX_TOP - BOX_BOTTOM, count, packingFraction, radiusSpread));
+    PoissonDiskParams params = {BOX_LEFT, BOX_BOTTOM, BOX_RIGHT, BOX_TOP, radius, radiusSpread, count, seed, 0};
+    std::vector<DiskSample> disks = poissonDiskSample(params);
+
+    count = (int)disks.size();
+    sim.balls.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        sim.balls[i].x = disks[i].x;
+        sim.balls[i].y = disks[i].y;
+        float speed = (count <= 5) ? 0.003f : (count <= 10 ? 0.0025f : 0.0015f);
+        float draws[4];
+        counterRngFloats(CounterRngKey{seed, RANDOM_BALL_HEADING}, i, 0, draws);
+        float theta = 2.0f * 3.14159f * draws[0];
+        sim.balls[i].vx = speed * cos(theta);
+        sim.balls[i].vy = speed * sin(theta);
+        sim.balls[i].radius = disks[i].radius;
+        sim.balls[i].color = glm::vec3(1.0f, 0.0f, 0.0f);
+    }
+}
+
+void setBallGravity(BallSim &sim, bool enabled, float openingAngle)
+{
+    sim.gravity = enabled;
+    sim.gravityParams.gravity = 0.0f;
+    sim.gravityParams.softening = NBODY_SOFTENING;
+    sim.gravityParams.openingAngle = openingAngle;
+    sim.gravityParams.threads = 0;
+    sim.stats = ConservationStats();
+}
+
+// Update ball physics, returns whether anything moved
+bool updateBall(BallSim &sim)
+{
+    PROFILE_ZONE("updateBall");
+    bool moved = false;
+    float penetration = 0.0f;
+
+    // N-body mode: kick velocities with the gravity at the current positions
+    // (symplectic Euler; the drift below moves with the new velocities)
+    if (sim.gravity && !sim.balls.empty())
+    {
+        sim.gravityParams.gravity = NBODY_TOTAL_GM / sim.balls.size();
+        buildBarnesHutTree(sim.tree, sim.balls);
+        computeBarnesHutForces(sim.tree, sim.balls, sim.gravityParams);
+        for (int i = 0; i < (int)sim.balls.size(); i++)
+        {
+            sim.balls[i].vx += sim.tree.accelX[i];
+            sim.balls[i].vy += sim.tree.accelY[i];
+        }
+    }
+
+    // Update position for all balls
+    for (int i = 0; i < (int)sim.balls.size(); i++)
+    {
+        if (sim.balls[i].vx != 0.0f || sim.balls[i].vy != 0.0f)
+            moved = true;
+        sim.balls[i].x += sim.balls[i].vx;
+        sim.balls[i].y += sim.balls[i].vy;
+
+        // Check collision with walls
+        if (sim.balls[i].x - sim.balls[i].radius <= BOX_LEFT || sim.balls[i].x + sim.balls[i].radius >= BOX_RIGHT)
+        {
+            sim.balls[i].vx = -sim.balls[i].vx;
+            // Clamp position to prevent sticking
+            if (sim.balls[i].x - sim.balls[i].radius <= BOX_LEFT)
+                sim.balls[i].x = BOX_LEFT + sim.balls[i].radius;
+            if (sim.balls[i].x + sim.balls[i].radius >= BOX_RIGHT)
+                sim.balls[i].x = BOX_RIGHT - sim.balls[i].radius;
+        }
+
+        if (sim.balls[i].y - sim.balls[i].radius <= BOX_BOTTOM || sim.balls[i].y + sim.balls[i].radius >= BOX_TOP)
+        {
+            sim.balls[i].vy = -sim.balls[i].vy;
+            // Clamp position to prevent sticking
+            if (sim.balls[i].y - sim.balls[i].radius <= BOX_BOTTOM)
+                sim.balls[i].y = BOX_BOTTOM + sim.balls[i].radius;
+            if (sim.balls[i].y + sim.balls[i].radius >= BOX_TOP)
+                sim.balls[i].y = BOX_TOP - sim.balls[i].radius;
+        }
+    }
+
+    // Check ball-to-ball collisions (bodies pass through each other in N-body mode)
+    for (int i = 0; i < (int)sim.balls.size() && !sim.gravity; i++)
+    {
+        for (int j = i + 1; j < (int)sim.balls.size(); j++)
+        {
+            float dx = sim.balls[j].x - sim.balls[i].x;
+            float dy = sim.balls[j].y - sim.balls[i].y;
+            float distance = sqrt(dx * dx + dy * dy);
+            float minDistance = sim.balls[i].radius + sim.balls[j].radius;
+
+            if (distance < minDistance)
+            {
+                // Collision detected - separate balls
+                float overlap = minDistance - distance;
+                penetration = std::max(penetration, overlap);
+                float separationX = (dx / distance) * overlap * 0.5f;
+                float separationY = (dy / distance) * overlap * 0.5f;
+
+                sim.balls[i].x -= separationX;
+                sim.balls[i].y -= separationY;
+                sim.balls[j].x += separationX;
+                sim.balls[j].y += separationY;
+
+                // Calculate collision response (elastic collision for equal masses)
+                float nx = dx / distance;
+                float ny = dy / distance;
+
+                // For equal masses, elastic collision simply swaps velocities along the normal
+                float v1n = sim.balls[i].vx * nx + sim.balls[i].vy * ny;
+                float v2n = sim.balls[j].vx * nx + sim.balls[j].vy * ny;
+
+                // Swap normal velocities
+                sim.balls[i].vx = sim.balls[i].vx + (v2n - v1n) * nx;
+                sim.balls[i].vy = sim.balls[i].vy + (v2n - v1n) * ny;
+                sim.balls[j].vx = sim.balls[j].vx + (v1n - v2n) * nx;
+                sim.balls[j].vy = sim.balls[j].vy + (v1n - v2n) * ny;
+                sim.collisions++;
+                moved = true;
+            }
+        }
+    }
+
+#if PHYSICS_TELEMETRY
+    // Equal unit masses
+    ConservationStats stats = {};
+    for (const Ball &b : sim.balls)
+    {
+        stats.kinetic += 0.5f * (b.vx * b.vx + b.vy * b.vy);
+        stats.momentumX += b.vx;
+        stats.momentumY += b.vy;
+    }
+    // Potential at the kick positions, so it lags the kinetic energy by a drift
+    if (sim.gravity)
+    {
+        for (float potential : sim.tree.potential)
+            stats.potential += 0.5f * potential;
+    }
+    stats.penetration = penetration;
+    sim.stats = stats;
+#endif
+    return moved;
+}
+
+// Square mass initialization function
+void initSquareMasses(SquareSim &sim, float massRatio)
+{
+    sim.squares[0].mass = 1.0f;
+    sim.squares[1].mass = massRatio;
+    sim.stats = ConservationStats();
+    sim.collisions = 0;
+}
+
+// Reset blue squares to initial state
+void resetSquares(SquareSim &sim)
+{
+    sim.squares[0].x = 0.0f;
+    sim.squares[0].y = 0.0f;
+    sim.squares[0].vx = 0.004f;
+    sim.squares[0].vy = 0.0f;
+    sim.squares[0].size = 0.1f;
+    sim.squares[0].color = glm::vec3(0.0f, 0.0f, 1.0f);
+
+    sim.squares[1].x = 0.3f;
+    sim.squares[1].y = 0.0f;
+    sim.squares[1].vx = -0.003f;
+    sim.squares[1].vy = 0.0f;
+    sim.squares[1].size = 0.1f;
+    sim.squares[1].color = glm::vec3(0.0f, 0.0f, 1.0f);
+}
+
+// Update square physics, returns whether anything moved
+bool updateSquare(SquareSim &sim)
+{
+    PROFILE_ZONE("updateSquare");
+    bool moved = false;
+    float penetration = 0.0f;
+
+    // Update position for all squares
+    for (int i = 0; i < NUM_SQUARES; i++)
+    {
+        if (sim.squares[i].vx != 0.0f || sim.squares[i].vy != 0.0f)
+            moved = true;
+
+        // Apply small damping to prevent energy buildup
+        sim.squares[i].vx *= 1.0f; // No damping for now
+        sim.squares[i].vy *= 1.0f;
+
+        sim.squares[i].x += sim.squares[i].vx;
+        sim.squares[i].y += sim.squares[i].vy;
+
+        // Check collision with walls
+        if (sim.squares[i].x - sim.squares[i].size * 0.5f <= BOX_LEFT || sim.squares[i].x + sim.squares[i].size * 0.5f >= BOX_RIGHT)
+        {
+            sim.squares[i].vx = -sim.squares[i].vx;
+            // Clamp position to prevent sticking
+            if (sim.squares[i].x - sim.squares[i].size * 0.5f <= BOX_LEFT)
+                sim.squares[i].x = BOX_LEFT + sim.squares[i].size * 0.5f;
+            if (sim.squares[i].x + sim.squares[i].size * 0.5f >= BOX_RIGHT)
+                sim.squares[i].x = BOX_RIGHT - sim.squares[i].size * 0.5f;
+        }
+
+        if (sim.squares[i].y - sim.squares[i].size * 0.5f <= BOX_BOTTOM || sim.squares[i].y + sim.squares[i].size * 0.5f >= BOX_TOP)
+        {
+            sim.squares[i].vy = -sim.squares[i].vy;
+            // Clamp position to prevent sticking
+            if (sim.squares[i].y - sim.squares[i].size * 0.5f <= BOX_BOTTOM)
+                sim.squares[i].y = BOX_BOTTOM + sim.squares[i].size * 0.5f;
+            if (sim.squares[i].y + sim.squares[i].size * 0.5f >= BOX_TOP)
+                sim.squares[i].y = BOX_TOP - sim.squares[i].size * 0.5f;
+        }
+    }
+
+    // Check square-to-square collisions (1D horizontal only)
+    for (int i = 0; i < NUM_SQUARES; i++)
+    {
+        for (int j = i + 1; j < NUM_SQUARES; j++)
+        {
+            float dx = sim.squares[j].x - sim.squares[i].x;
+            float distance = fabs(dx);
+            float minDistance = sim.squares[i].size * 0.5f + sim.squares[j].size * 0.5f;
+
+            if (distance < minDistance && distance > 0.001f)
+            {
+                // Only handle if moving toward each other (1D)
+                if ((sim.squares[j].vx - sim.squares[i].vx) * (sim.squares[j].x - sim.squares[i].x) >= 0)
+                    continue;
+
+                // Separate squares
+                float overlap = minDistance - distance;
+                penetration = std::max(penetration, overlap);
+                float separation = overlap * 0.5f * (dx > 0 ? 1.0f : -1.0f);
+                sim.squares[i].x -= separation;
+                sim.squares[j].x += separation;
+
+                // 1D elastic collision equations for vx
+                float m1 = sim.squares[i].mass;
+                float m2 = sim.squares[j].mass;
+                float v1 = sim.squares[i].vx;
+                float v2 = sim.squares[j].vx;
+                float v1p = ((m1 - m2) * v1 + 2 * m2 * v2) / (m1 + m2);
+                float v2p = ((m2 - m1) * v2 + 2 * m1 * v1) / (m1 + m2);
+                sim.squares[i].vx = v1p;
+                sim.squares[j].vx = v2p;
+                sim.collisions++;
+                moved = true;
+            }
+        }
+    }
+
+#if PHYSICS_TELEMETRY
+    ConservationStats stats = {};
+    for (const Square &s : sim.squares)
+    {
+        stats.kinetic += 0.5f * s.mass * (s.vx * s.vx + s.vy * s.vy);
+        stats.momentumX += s.mass * s.vx;
+        stats.momentumY += s.mass * s.vy;
+    }
+    stats.penetration = penetration;
+    sim.stats = stats;
+#endif
+    return moved;
+}
+
+// Newton's Cradle initialization function
+void initNewtonsCradle(CradleSim &sim)
+{
+    float startX = -0.24f; // Center the 5 pendulums properly
+    for (int i = 0; i < NUM_PENDULUMS; i++)
+    {
+        sim.pendulums[i].x = startX + i * PENDULUM_SPACING;
+        sim.pendulums[i].y = BOX_TOP - 0.15f; // Anchor point inside the box, not at the very top
+        sim.pendulums[i].angle = 0.0f;
+        sim.pendulums[i].angularVel = 0.0f;
+        sim.pendulums[i].length = PENDULUM_LENGTH * 0.8f; // Adjusted scaling for longer strings
+        sim.pendulums[i].mass = PENDULUM_MASS;
+        sim.pendulums[i].radius = PENDULUM_RADIUS;
+        sim.pendulums[i].color = glm::vec3(0.0f, 1.0f, 0.0f); // Green color
+        sim.pendulums[i].isDragging = false;
+    }
+    sim.collisions = 0;
+    sim.stats = ConservationStats();
+}
+
+// Newton's Cradle update function, returns false once the cradle has settled
+bool updateNewtonsCradle(CradleSim &sim)
+{
+    PROFILE_ZONE("updateNewtonsCradle");
+    float penetration = 0.0f;
+
+    // Apply damping to all pendulums
+    for (int i = 0; i < NUM_PENDULUMS; i++)
+    {
+        sim.pendulums[i].angularVel *= DAMPING;
+    }
+
+    // Update pendulum physics
+    for (int i = 0; i < NUM_PENDULUMS; i++)
+    {
+        // Simple pendulum physics
+        sim.pendulums[i].angularVel -= GRAVITY * sin(sim.pendulums[i].angle) / sim.pendulums[i].length;
+        sim.pendulums[i].angle += sim.pendulums[i].angularVel;
+    }
+
+    // Check collisions between adjacent pendulums
+    for (int i = 0; i < NUM_PENDULUMS - 1; i++)
+    {
+        float bob1X = sim.pendulums[i].x + sim.pendulums[i].length * sin(sim.pendulums[i].angle);
+        float bob1Y = sim.pendulums[i].y - sim.pendulums[i].length * cos(sim.pendulums[i].angle);
+        float bob2X = sim.pendulums[i + 1].x + sim.pendulums[i + 1].length * sin(sim.pendulums[i + 1].angle);
+        float bob2Y = sim.pendulums[i + 1].y - sim.pendulums[i + 1].length * cos(sim.pendulums[i + 1].angle);
+
+        float dx = bob2X - bob1X;
+        float dy = bob2Y - bob1Y;
+        float distance = sqrt(dx * dx + dy * dy);
+
+        // Only handle collision if balls are overlapping and moving toward each other
+        if (distance < COLLISION_DISTANCE && distance > 0.001f)
+        {
+            penetration = std::max(penetration, COLLISION_DISTANCE - distance);
+
+            // Calculate velocities of bobs
+            float vel1X = sim.pendulums[i].angularVel * sim.pendulums[i].length * cos(sim.pendulums[i].angle);
+            float vel1Y = -sim.pendulums[i].angularVel * sim.pendulums[i].length * sin(sim.pendulums[i].angle);
+            float vel2X = sim.pendulums[i + 1].angularVel * sim.pendulums[i + 1].length * cos(sim.pendulums[i + 1].angle);
+            float vel2Y = -sim.pendulums[i + 1].angularVel * sim.pendulums[i + 1].length * sin(sim.pendulums[i + 1].angle);
+
+            // Relative velocity along collision normal
+            float normalX = dx / distance;
+            float normalY = dy / distance;
+            float relVelX = vel2X - vel1X;
+            float relVelY = vel2Y - vel1Y;
+            float relVelAlongNormal = relVelX * normalX + relVelY * normalY;
+
+            // Only apply collision if balls are moving toward each other
+            if (relVelAlongNormal < 0)
+            {
+                // Elastic collision - swap angular velocities
+                sim.collisions++;
+                float tempVel = sim.pendulums[i].angularVel;
+                sim.pendulums[i].angularVel = sim.pendulums[i + 1].angularVel;
+                sim.pendulums[i + 1].angularVel = tempVel;
+
+                // Immediately separate balls by adjusting their positions
+                // This prevents multiple collisions in the same frame
+                float overlap = COLLISION_DISTANCE - distance;
+                float separationX = overlap * normalX * 0.6f; // Slightly more separation
+                float separationY = overlap * normalY * 0.6f;
+
+                // Calculate new positions that maintain pendulum constraints
+                float newBob1X = bob1X - separationX;
+                float newBob1Y = bob1Y - separationY;
+                float newBob2X = bob2X + separationX;
+                float newBob2Y = bob2Y + separationY;
+
+                // Convert back to angles while maintaining pendulum constraints
+                float newAngle1 = asin((newBob1X - sim.pendulums[i].x) / sim.pendulums[i].length);
+                float newAngle2 = asin((newBob2X - sim.pendulums[i + 1].x) / sim.pendulums[i + 1].length);
+
+                // Apply the new angles
+                sim.pendulums[i].angle = newAngle1;
+                sim.pendulums[i + 1].angle = newAngle2;
+            }
+        }
+    }
+
+#if PHYSICS_TELEMETRY
+    // Bob velocity is L w (cos a, sin a); height above the rest position is L (1 - cos a)
+    ConservationStats stats = {};
+    for (const Pendulum &p : sim.pendulums)
+    {
+        float speed = p.length * p.angularVel;
+        stats.kinetic += 0.5f * p.mass * speed * speed;
+        stats.potential += p.mass * GRAVITY * p.length * (1.0f - cos(p.angle));
+        stats.momentumX += p.mass * speed * cos(p.angle);
+        stats.momentumY += p.mass * speed * sin(p.angle);
+    }
+    stats.penetration = penetration;
+    sim.stats = stats;
+#endif
+
+    for (int i = 0; i < NUM_PENDULUMS; i++)
+    {
+        if (fabs(sim.pendulums[i].angle) > CRADLE_REST_ANGLE || fabs(sim.pendulums[i].angularVel) > CRADLE_REST_VELOCITY)
+            return true;
+    }
+    return false;
+}
+
+// Function to reset Newton's Cradle
+void resetNewtonsCradle(CradleSim &sim)
+{
+    for (int i = 0; i < NUM_PENDULUMS; i++)
+    {
+        sim.pendulums[i].angle = 0.0f;
+        sim.pendulums[i].angularVel = 0.0f;
+    }
+}
+
+// Pull back the first count pendulums
+void pullBackPendulums(CradleSim &sim, int count)
+{
+    for (int j = 0; j < count && j < NUM_PENDULUMS; j++)
+    {
+        sim.pendulums[j].angle = -0.5f;     // Pull back about 30 degrees
+        sim.pendulums[j].angularVel = 0.0f; // Reset velocity
+    }
+}
+
+// Fluid demo functions
+void initFluidDemo(FluidSim &sim, unsigned int seed)
+{
+    sim.activeCount = 0;
+    sim.streamSpeed = 0.01f; // Fast speed by default
+    sim.obstacleX = 0.0f;
+    sim.obstacleY = 0.0f;
+    sim.obstacleRadius = 0.15f;
+    sim.shape = ObstacleShape::BALL;
+    sim.airfoil = {0.0f, 0.0f, 0.4f, 0.0f}; // NACA 0040
+    sim.polygon = NULL;
+    sim.geometry.built = false;
+    sim.geometry.version = 0;
+    sim.obstacles.clear();
+    sim.broadphase.cellStart.clear();
+    sim.obstacleVersion = 0;
+    sim.seed = seed;
+    sim.step = 0;
+    sim.spawned = 0;
+    sim.exited = 0;
+    sim.stats = ConservationStats();
+
+    // Initialize all particles as inactive
+    for (int i = 0; i < MAX_FLUID_PARTICLES; i++)
+    {
+        sim.particles[i].active = false;
+    }
+}
+
+void spawnFluidParticle(FluidSim &sim)
+{
+    // Find an inactive particle
+    for (int i = 0; i < MAX_FLUID_PARTICLES; i++)
+    {
+        if (!sim.particles[i].active)
+        {
+            // Spawn on the left edge with some random vertical position
+            float draws[4];
+            counterRngFloats(CounterRngKey{sim.seed, RANDOM_FLUID_SPAWN}, sim.spawned++, 0, draws);
+            sim.particles[i].x = BOX_LEFT + 0.05f;
+            sim.particles[i].y = BOX_BOTTOM + 0.1f + draws[0] * (BOX_TOP - BOX_BOTTOM - 0.2f);
+            sim.particles[i].vx = sim.streamSpeed; // Always move right
+            sim.particles[i].vy = 0.0f;        // No vertical velocity initially
+            sim.particles[i].radius = 0.008f;
+            sim.particles[i].color = glm::vec3(1.0f, 1.0f, 0.0f); // Yellow particles
+            sim.particles[i].active = true;
+            sim.activeCount++;
+            break;
+        }
+    }
+}
+
+// Move a colliding particle just outside the obstacle and deflect it along
+// the surface. Without alongNormal it is pushed out to the obstacle's radius
+// from the centre; outlines far from round push out from the nearest
+// boundary point instead.
+static void pushOutOfObstacle(FluidParticle &p, const ObstacleGeometry &geometry, bool alongNormal, float streamSpeed, float &penetration)
+{
+    float originX = geometry.x, originY = geometry.y, surface = geometry.radius;
+    float dx = p.x - originX;
+    float dy = p.y - originY;
+    float distance = sqrt(dx * dx + dy * dy);
+    if (alongNormal)
+    {
+        float signedDistance = obstacleClosestPoint(geometry, p.x, p.y, originX, originY);
+        float side = signedDistance < 0.0f ? -1.0f : 1.0f;
+        dx = (p.x - originX) * side;
+        dy = (p.y - originY) * side;
+        distance = signedDistance;
+        surface = 0.0f;
+        if (fabs(distance) < 0.001f)
+        {
+            // On the boundary: fall back to the direction from the centre
+            dx = p.x - geometry.x;
+            dy = p.y - geometry.y;
+        }
+    }
+    penetration = std::max(penetration, surface + p.radius - distance);
+    float length = sqrt(dx * dx + dy * dy);
+    if (length > 0.001f)
+    {
+        float pushDistance = surface + p.radius + 0.01f;
+        p.x = originX + (dx / length) * pushDistance;
+        p.y = originY + (dy / length) * pushDistance;
+        float flowForce = streamSpeed * 0.5f;
+        float normalX = dx / length;
+        float normalY = dy / length;
+        p.vx += normalY * flowForce;
+        p.vy -= normalX * flowForce;
+        if (p.vx < streamSpeed * 0.5f)
+        {
+            p.vx = streamSpeed * 0.5f;
+        }
+    }
+}
+
+// Fluid update, returns whether any particle is in flight
+bool updateFluidDemo(FluidSim &sim, const StableFluid *field)
+{
+    PROFILE_ZONE("updateFluidDemo");
+    updateFluidObstacle(sim);
+
+    // Continuously spawn new particles to keep the stream full
+    int activeCount = 0;
+    for (int i = 0; i < MAX_FLUID_PARTICLES; i++)
+    {
+        if (sim.particles[i].active)
+            activeCount++;
+    }
+    // Try to keep the stream full
+    int particlesToSpawn = MAX_FLUID_PARTICLES - activeCount;
+    for (int i = 0; i < particlesToSpawn; i++)
+    {
+        spawnFluidParticle(sim);
+    }
+    float penetration = 0.0f;
+
+    // Velocity jitter for every particle slot at once, keyed by slot and step
+    // so it does not depend on the order particles are updated in
+    float jitter[MAX_FLUID_PARTICLES * 4];
+    bool jittered = !field && sim.streamSpeed > 0.007f;
+    if (jittered)
+        counterRngFloatBatch(CounterRngKey{sim.seed, RANDOM_FLUID_JITTER}, 0, MAX_FLUID_PARTICLES, sim.step, jitter);
+    sim.step++;
+
+    // Update all active particles
+    for (int i = 0; i < MAX_FLUID_PARTICLES; i++)
+    {
+        if (!sim.particles[i].active)
+            continue;
+        FluidParticle &p = sim.particles[i];
+        if (field)
+        {
+            // Passive tracer in the grid flow; a step that would enter the
+            // obstacle is dropped and the next sample steers around it
+            sampleStableFluidVelocity(*field, p.x, p.y, p.vx, p.vy);
+            if (!stableFluidSolidAt(*field, p.x + p.vx, p.y + p.vy))
+            {
+                p.x += p.vx;
+                p.y += p.vy;
+            }
+        }
+        else
+        {
+            // Update position
+            p.x += p.vx;
+            p.y += p.vy;
+            // Only obstacles whose bounds the particle overlaps reach the exact
+            // test; index 0 is the main obstacle, the rest are the layout's
+            const int *candidates;
+            int candidateCount = queryObstacleBroadphase(sim.broadphase, p.x, p.y, candidates);
+            for (int c = 0; c < candidateCount; c++)
+            {
+                int o = candidates[c];
+                if (o > 0)
+                {
+                    const ObstacleGeometry &geometry = sim.obstacles[o - 1].geometry;
+                    if (obstacleBroadphaseOverlaps(sim.broadphase, o, p.x, p.y, p.radius) &&
+                        obstacleSignedDistance(geometry, p.x, p.y) < p.radius)
+                        pushOutOfObstacle(p, geometry, !geometry.outline.empty(), sim.streamSpeed, penetration);
+                    continue;
+                }
+
+                // Check collision with obstacle based on current shape
+                bool collision = false;
+                switch (sim.shape)
+                {
+                case ObstacleShape::BALL:
+                    collision = checkBallCollision(sim, p.x, p.y, p.radius);
+                    break;
+                case ObstacleShape::TRIANGLE:
+                    collision = checkTriangleCollision(sim, p.x, p.y, p.radius);
+                    break;
+                case ObstacleShape::AIRFOIL:
+                    collision = checkAirfoilCollision(sim, p.x, p.y, p.radius);
+                    break;
+                case ObstacleShape::POLYGON:
+                    collision = checkPolygonCollision(sim, p.x, p.y, p.radius);
+                    break;
+                }
+                if (collision)
+                    pushOutOfObstacle(p, sim.geometry, sim.geometry.shape == ObstacleShape::POLYGON, sim.streamSpeed, penetration);
+            }
+        }
+        // Check collision with box walls - particles flow through, not bounce
+        if (p.x - p.radius <= BOX_LEFT)
+        {
+            p.x = BOX_LEFT + p.radius;
+            p.vx = sim.streamSpeed;
+        }
+        if (p.y - p.radius <= BOX_BOTTOM)
+        {
+            p.y = BOX_BOTTOM + p.radius;
+            p.vy = 0.0f;
+        }
+        if (p.y + p.radius >= BOX_TOP)
+        {
+            p.y = BOX_TOP - p.radius;
+            p.vy = 0.0f;
+        }
+        // Remove particles that reach or pass the right edge
+        if (p.x - p.radius >= BOX_RIGHT)
+        {
+            p.active = false;
+            sim.activeCount--;
+            sim.exited++;
+        }
+        if (field)
+            continue;
+        // Add small amount of damping to prevent excessive turbulence
+        p.vx *= 0.998f;
+        p.vy *= 0.998f;
+        if (jittered)
+        {
+            p.vx += (jitter[i * 4] - 0.5f) * 0.0003f;
+            p.vy += (jitter[i * 4 + 1] - 0.5f) * 0.0003f;
+        }
+    }
+
+#if PHYSICS_TELEMETRY
+    // Unit-mass particles; penetration is measured against the push-out circle
+    ConservationStats stats = {};
+    for (const FluidParticle &p : sim.particles)
+    {
+        if (!p.active)
+            continue;
+        stats.kinetic += 0.5f * (p.vx * p.vx + p.vy * p.vy);
+        stats.momentumX += p.vx;
+        stats.momentumY += p.vy;
+    }
+    stats.penetration = penetration;
+    sim.stats = stats;
+#endif
+    return sim.activeCount > 0;
+}
+
+// Shape collision detection functions
+bool checkBallCollision(const FluidSim &sim, float x, float y, float radius)
+{
+    float dx = x - sim.obstacleX;
+    float dy = y - sim.obstacleY;
+    float distance = sqrt(dx * dx + dy * dy);
+    return distance < sim.obstacleRadius + radius;
+}
+
+bool checkTriangleCollision(const FluidSim &sim, float x, float y, float radius)
+{
+    // Triangle vertices (equilateral triangle pointing right) - same as rendering
+    float size = sim.obstacleRadius * 2.0f; // Side length
+    float h = size * sqrt(3.0f) / 2.0f; // Height
+    float v1x = sim.obstacleX - size / 2.0f, v1y = sim.obstacleY - h / 3.0f;
+    float v2x = sim.obstacleX + size / 2.0f, v2y = sim.obstacleY - h / 3.0f;
+    float v3x = sim.obstacleX, v3y = sim.obstacleY + 2.0f * h / 3.0f;
+
+    // First check if point is inside triangle (including radius)
+    // Use barycentric coordinates
+    float denominator = ((v2y - v3y) * (v1x - v3x) + (v3x - v2x) * (v1y - v3y));
+    if (fabs(denominator) < 0.0001f)
+        return false; // Degenerate triangle
+
+    float w1 = ((v2y - v3y) * (x - v3x) + (v3x - v2x) * (y - v3y)) / denominator;
+    float w2 = ((v3y - v1y) * (x - v3x) + (v1x - v3x) * (y - v3y)) / denominator;
+    float w3 = 1.0f - w1 - w2;
+
+    // Check if point is inside triangle (with some tolerance for radius)
+    if (w1 >= -0.1f && w2 >= -0.1f && w3 >= -0.1f)
+    {
+        return true;
+    }
+
+    // Also check distance to edges for particles near the boundary
+    float minDist = 1000.0f;
+
+    // Edge 1: v1 to v2
+    float edge1x = v2x - v1x, edge1y = v2y - v1y;
+    float edge1Len = sqrt(edge1x * edge1x + edge1y * edge1y);
+    if (edge1Len > 0.0001f)
+    {
+        edge1x /= edge1Len;
+        edge1y /= edge1Len;
+        float proj1 = (x - v1x) * edge1x + (y - v1y) * edge1y;
+        if (proj1 >= -radius && proj1 <= edge1Len + radius)
+        {
+            float dist1 = fabs((x - v1x) * edge1y - (y - v1y) * edge1x);
+            minDist = std::min(minDist, dist1);
+        }
+    }
+
+    // Edge 2: v2 to v3
+    float edge2x = v3x - v2x, edge2y = v3y - v2y;
+    float edge2Len = sqrt(edge2x * edge2x + edge2y * edge2y);
+    if (edge2Len > 0.0001f)
+    {
+        edge2x /= edge2Len;
+        edge2y /= edge2Len;
+        float proj2 = (x - v2x) * edge2x + (y - v2y) * edge2y;
+        if (proj2 >= -radius && proj2 <= edge2Len + radius)
+        {
+            float dist2 = fabs((x - v2x) * edge2y - (y - v2y) * edge2x);
+            minDist = std::min(minDist, dist2);
+        }
+    }
+
+    // Edge 3: v3 to v1
+    float edge3x = v1x - v3x, edge3y = v1y - v3y;
+    float edge3Len = sqrt(edge3x * edge3x + edge3y * edge3y);
+    if (edge3Len > 0.0001f)
+    {
+        edge3x /= edge3Len;
+        edge3y /= edge3Len;
+        float proj3 = (x - v3x) * edge3x + (y - v3y) * edge3y;
+        if (proj3 >= -radius && proj3 <= edge3Len + radius)
+        {
+            float dist3 = fabs((x - v3x) * edge3y - (y - v3y) * edge3x);
+            minDist = std::min(minDist, dist3);
+        }
+    }
+
+    return minDist < radius;
+}
+
+bool checkAirfoilCollision(const FluidSim &sim, float x, float y, float radius)
+{
+    // Cheap reject against the outline's bounds before the polygon distance
+    const ObstacleGeometry &geometry = sim.geometry;
+    if (x < geometry.minX - radius || x > geometry.maxX + radius || y < geometry.minY - radius || y > geometry.maxY + radius)
+        return false;
+    return obstacleSignedDistance(geometry, x, y) < radius;
+}
+
+bool checkPolygonCollision(const FluidSim &sim, float x, float y, float radius)
+{
+    const ObstacleGeometry &geometry = sim.geometry;
+    if (x < geometry.minX - radius || x > geometry.maxX + radius || y < geometry.minY - radius || y > geometry.maxY + radius)
+        return false;
+    return obstacleSignedDistance(geometry, x, y) < radius;
+}
+
+bool updateFluidObstacle(FluidSim &sim)
+{
+    bool changed = updateObstacleGeometry(sim.geometry, sim.shape, sim.obstacleX, sim.obstacleY, sim.obstacleRadius, sim.airfoil, sim.polygon);
+    for (ObstacleInstance &obstacle : sim.obstacles)
+        changed |= updateObstacleGeometry(obstacle.geometry, obstacle.shape, obstacle.x, obstacle.y, obstacle.radius, obstacle.airfoil, obstacle.polygon);
+    if (!changed && !sim.broadphase.cellStart.empty())
+        return false;
+
+    // The triangle test accepts points a little outside its edges, so the
+    // main obstacle's box is grown to keep those in its cells
+    float grow = 0.2f * sim.obstacleRadius;
+    std::vector<float> bounds = {sim.geometry.minX - grow, sim.geometry.minY - grow, sim.geometry.maxX + grow, sim.geometry.maxY + grow};
+    for (const ObstacleInstance &obstacle : sim.obstacles)
+        bounds.insert(bounds.end(), {obstacle.geometry.minX, obstacle.geometry.minY, obstacle.geometry.maxX, obstacle.geometry.maxY});
+    buildObstacleBroadphase(sim.broadphase, bounds, FLUID_OBSTACLE_MARGIN, BOX_LEFT, BOX_BOTTOM, BOX_RIGHT, BOX_TOP);
+    sim.obstacleVersion++;
+    return true;
+}
+
+float fluidObstacleSignedDistance(const FluidSim &sim, float x, float y)
+{
+    float distance = obstacleSignedDistance(sim.geometry, x, y);
+    for (const ObstacleInstance &obstacle : sim.obstacles)
+        distance = std::min(distance, obstacleSignedDistance(obstacle.geometry, x, y));
+    return distance;
+}
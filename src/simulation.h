@@ -0,0 +1,203 @@
+#pragma once
+
+#include "barnes_hut.h"
+#include "counter_rng.h"
+#include "obstacle_broadphase.h"
+#include "obstacle_geometry.h"
+#include "stable_fluid.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// Physics for the four demos. Each demo's state lives in an instance struct so
+// the GUI can drive one instance of each while headless runs (parameter
+// sweeps) create as many independent instances as they like. Nothing in here
+// touches GLFW or OpenGL.
+
+// Box boundaries
+const float BOX_LEFT = -0.8f;
+const float BOX_RIGHT = 0.8f;
+const float BOX_TOP = 0.6f;
+const float BOX_BOTTOM = -0.6f;
+
+// Per-step conservation diagnostics, filled in by the update functions.
+// Build with PHYSICS_TELEMETRY=0 to compile them out entirely.
+#ifndef PHYSICS_TELEMETRY
+#define PHYSICS_TELEMETRY 1
+#endif
+
+struct ConservationStats
+{
+    float kinetic;     // Total kinetic energy (unit masses where the demo has none)
+    float potential;   // Gravitational potential energy (cradle only)
+    float momentumX;   // Total linear momentum
+    float momentumY;
+    float penetration; // Deepest overlap found this step, before it was corrected
+};
+
+// Ball physics properties
+struct Ball
+{
+    float x, y;
+    float vx, vy;
+    float radius;
+    glm::vec3 color;
+};
+
+// Largest ball count offered by the red demo's buttons
+const int MAX_BALLS = 50;
+
+// N-body mode: balls attract each other (Barnes-Hut, softened Newtonian
+// gravity) and pass through each other instead of colliding. Lengths are box
+// units and time is steps; the whole system has G * M = NBODY_TOTAL_GM
+// however many bodies it holds, so the collapse takes a few seconds.
+const float NBODY_TOTAL_GM = 3e-6f;
+const float NBODY_SOFTENING = 0.01f;
+const float NBODY_OPENING_ANGLE = 0.7f;
+
+// Red demo: balls bouncing in the box
+struct BallSim
+{
+    BallVector balls;
+    unsigned int seed; // Key of the counter-based random draws
+    int collisions; // Ball-ball contacts resolved so far
+    ConservationStats stats;
+    bool gravity;   // N-body mode; balls are kept in Morton order while set
+    BarnesHutParams gravityParams;
+    BarnesHutTree tree;
+};
+
+// Balls start at Poisson-disk positions, so none overlap. Counts too large for
+// the demo's radii shrink the balls to cover packingFraction of the box, with
+// radii uniform in radius * [1 - radiusSpread, 1 + radiusSpread].
+const float BALL_PACKING_FRACTION = 0.4f;
+
+void initBalls(BallSim &sim, int count, unsigned int seed, float packingFraction = BALL_PACKING_FRACTION, float radiusSpread = 0.0f);
+bool updateBall(BallSim &sim);
+
+// Switch N-body mode on or off (initBalls switches it off)
+void setBallGravity(BallSim &sim, bool enabled, float openingAngle = NBODY_OPENING_ANGLE);
+
+// Square physics properties
+struct Square
+{
+    float x, y;
+    float vx, vy;
+    float size;
+    float mass;
+    glm::vec3 color;
+};
+
+const int NUM_SQUARES = 2;
+
+// Blue demo: two squares exchanging momentum
+struct SquareSim
+{
+    Square squares[NUM_SQUARES];
+    int collisions; // Square-square collisions so far
+    ConservationStats stats;
+};
+
+void initSquareMasses(SquareSim &sim, float massRatio);
+void resetSquares(SquareSim &sim);
+bool updateSquare(SquareSim &sim);
+
+// Newton's Cradle structures
+struct Pendulum
+{
+    float x, y;       // Current position
+    float angle;      // Current angle (radians)
+    float angularVel; // Angular velocity
+    float length;     // Length of pendulum string
+    float mass;       // Mass of the bob
+    float radius;     // Radius of the bob
+    glm::vec3 color;  // Color of the bob
+    bool isDragging;  // Whether this pendulum is being dragged
+};
+
+// Newton's Cradle parameters
+const int NUM_PENDULUMS = 5;
+const float PENDULUM_LENGTH = 0.8f;
+const float PENDULUM_SPACING = 0.12f;
+const float PENDULUM_RADIUS = 0.05f;
+const float PENDULUM_MASS = 1.0f;
+const float GRAVITY = 0.001f;
+const float DAMPING = 0.999f;
+const float COLLISION_DISTANCE = PENDULUM_RADIUS * 2.0f;
+
+// The cradle counts as settled (nothing left to redraw) below these amplitudes
+const float CRADLE_REST_ANGLE = 1e-4f;
+const float CRADLE_REST_VELOCITY = 1e-6f;
+
+// Green demo: Newton's cradle
+struct CradleSim
+{
+    Pendulum pendulums[NUM_PENDULUMS];
+    int collisions; // Bob-bob collisions so far
+    ConservationStats stats;
+};
+
+void initNewtonsCradle(CradleSim &sim);
+bool updateNewtonsCradle(CradleSim &sim);
+void resetNewtonsCradle(CradleSim &sim);
+
+// Pull back the first count pendulums, as when clicking ball number count
+void pullBackPendulums(CradleSim &sim, int count);
+
+// Fluid flow parameters
+struct FluidParticle
+{
+    float x, y;
+    float vx, vy;
+    float radius;
+    glm::vec3 color;
+    bool active;
+};
+
+// Fluid demo parameters
+const int MAX_FLUID_PARTICLES = 200;
+
+// Yellow demo: particle stream around an obstacle
+struct FluidSim
+{
+    FluidParticle particles[MAX_FLUID_PARTICLES];
+    int activeCount;
+    float streamSpeed;
+    float obstacleX;
+    float obstacleY;
+    float obstacleRadius;
+    ObstacleShape shape;
+    AirfoilParams airfoil;                                      // Profile used when shape is AIRFOIL
+    const ObstaclePolygon *polygon;                             // Outline used when shape is POLYGON, or NULL
+    ObstacleGeometry geometry;                                  // Outline cache, refreshed by updateFluidObstacle
+    TaggedVector<ObstacleInstance, MEMORY_OBSTACLES> obstacles; // Further obstacles from a layout file
+    ObstacleBroadphase broadphase;                              // Over the main obstacle (index 0) and the layout
+    unsigned int obstacleVersion;                               // Incremented whenever any obstacle is rebuilt
+    unsigned int seed;       // Key of the counter-based random draws
+    unsigned long long step; // Updates so far, part of each draw's counter
+    unsigned int spawned;    // Particles spawned so far, numbering the spawn draws
+    int exited; // Particles that have left through the right edge
+    ConservationStats stats;
+};
+
+void initFluidDemo(FluidSim &sim, unsigned int seed);
+void spawnFluidParticle(FluidSim &sim);
+// With a field, particles are passive tracers of its velocity instead of
+// being pushed around the obstacle
+bool updateFluidDemo(FluidSim &sim, const StableFluid *field = NULL);
+
+// Particles within this distance of an obstacle's bounds see it in the broadphase
+const float FLUID_OBSTACLE_MARGIN = 0.02f;
+
+// Re-tessellate the obstacles whose shape or parameters changed and rebuild
+// the broadphase; returns whether anything changed
+bool updateFluidObstacle(FluidSim &sim);
+
+// Signed distance to the nearest of the main and layout obstacles
+float fluidObstacleSignedDistance(const FluidSim &sim, float x, float y);
+
+// Shape collision detection (the airfoil test uses the cached outline)
+bool checkBallCollision(const FluidSim &sim, float x, float y, float radius);
+bool checkTriangleCollision(const FluidSim &sim, float x, float y, float radius);
+bool checkAirfoilCollision(const FluidSim &sim, float x, float y, float radius);
+bool checkPolygonCollision(const FluidSim &sim, float x, float y, float radius);
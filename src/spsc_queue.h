@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free single-producer/single-consumer ring buffer. One thread
+// may push and one (possibly different) thread may pop without locking.
+// Capacity must be a power of two.
+template <typename T, size_t Capacity>
+struct SpscQueue
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    // Head and tail live on separate cache lines so the two threads do not
+    // false-share
+    alignas(64) std::atomic<size_t> head{0}; // Next slot to pop (consumer)
+    alignas(64) std::atomic<size_t> tail{0}; // Next slot to push (producer)
+    alignas(64) T items[Capacity];
+
+    // Producer side; returns false if the queue is full
+    bool push(const T &item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == Capacity)
+            return false;
+        items[t & (Capacity - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side; returns false if the queue is empty
+    bool pop(T &item)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+        item = items[h & (Capacity - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+};
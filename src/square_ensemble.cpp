@@ -0,0 +1,80 @@
+#include "square_ensemble.h"
+#include "simulation.h"
+#include "profiler.h"
+#include "cpu_dispatch.h"
+
+// Square size used by resetSquares
+static const float ENSEMBLE_SQUARE_SIZE = 0.1f;
+
+int squareEnsembleLanes()
+{
+    return simdKernels->lanes;
+}
+
+void initSquareEnsemble(SquareEnsemble &ensemble, int count, const float *massRatios, const float *v1, const float *v2,
+                        int historyInterval)
+{
+    ensemble.count = count;
+    ensemble.padded = (count + SIMD_KERNEL_ENSEMBLE_PADDING - 1) / SIMD_KERNEL_ENSEMBLE_PADDING * SIMD_KERNEL_ENSEMBLE_PADDING;
+    ensemble.steps = 0;
+
+    // Padding lanes hold resting unit masses and never collide
+    ensemble.x0.assign(ensemble.padded, 0.0f);
+    ensemble.x1.assign(ensemble.padded, 0.3f);
+    ensemble.v0.assign(ensemble.padded, 0.0f);
+    ensemble.v1.assign(ensemble.padded, 0.0f);
+    ensemble.m0.assign(ensemble.padded, 1.0f);
+    ensemble.m1.assign(ensemble.padded, 1.0f);
+    ensemble.collisions.assign(ensemble.padded, 0.0f);
+    for (int i = 0; i < count; i++)
+    {
+        ensemble.m1[i] = massRatios[i];
+        ensemble.v0[i] = v1[i];
+        ensemble.v1[i] = v2[i];
+    }
+
+    ensemble.historyInterval = historyInterval;
+    ensemble.historySamples = 0;
+    ensemble.momentumHistory.clear();
+    ensemble.energyHistory.clear();
+    if (historyInterval > 0)
+    {
+        ensemble.historySamples = 1;
+        ensemble.momentumHistory.resize(ensemble.padded);
+        ensemble.energyHistory.resize(ensemble.padded);
+        for (int i = 0; i < ensemble.padded; i++)
+        {
+            float m0 = ensemble.m0[i], m1 = ensemble.m1[i];
+            float u0 = ensemble.v0[i], u1 = ensemble.v1[i];
+            ensemble.momentumHistory[i] = m0 * u0 + m1 * u1;
+            ensemble.energyHistory[i] = 0.5f * m0 * u0 * u0 + 0.5f * m1 * u1 * u1;
+        }
+    }
+}
+
+void runSquareEnsemble(SquareEnsemble &ensemble, int steps)
+{
+    PROFILE_ZONE("runSquareEnsemble");
+    int interval = ensemble.historyInterval;
+    int firstStep = ensemble.steps;
+    if (interval > 0)
+    {
+        ensemble.historySamples = (firstStep + steps) / interval + 1;
+        ensemble.momentumHistory.resize((size_t)ensemble.historySamples * ensemble.padded);
+        ensemble.energyHistory.resize((size_t)ensemble.historySamples * ensemble.padded);
+    }
+
+    EnsembleArrays arrays;
+    arrays.x0 = ensemble.x0.data();
+    arrays.x1 = ensemble.x1.data();
+    arrays.v0 = ensemble.v0.data();
+    arrays.v1 = ensemble.v1.data();
+    arrays.m0 = ensemble.m0.data();
+    arrays.m1 = ensemble.m1.data();
+    arrays.collisions = ensemble.collisions.data();
+    arrays.momentumHistory = interval > 0 ? ensemble.momentumHistory.data() : NULL;
+    arrays.energyHistory = interval > 0 ? ensemble.energyHistory.data() : NULL;
+    arrays.padded = ensemble.padded;
+    simdKernels->squareEnsembleSteps(arrays, firstStep, steps, interval, ENSEMBLE_SQUARE_SIZE, BOX_LEFT, BOX_RIGHT);
+    ensemble.steps = firstStep + steps;
+}
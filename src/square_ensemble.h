@@ -0,0 +1,48 @@
+#pragma once
+
+#include "memory_tracker.h"
+
+#include <vector>
+
+// Ensemble mode for the blue (momentum) demo. Thousands of independent
+// two-square systems are stepped in lockstep, one system per SIMD lane, with
+// the state stored as structure-of-arrays. Wall bounces and square-square
+// collisions are applied with lane masks instead of branches, so every lane
+// follows exactly the same rules as updateSquare. Only horizontal motion is
+// simulated, as in the demo (vy is always zero there).
+
+// Per-system arrays, counted as square-ensemble memory
+typedef TaggedVector<float, MEMORY_SQUARE_ENSEMBLE> EnsembleFloats;
+
+struct SquareEnsemble
+{
+    int count;  // Systems requested
+    int padded; // Systems allocated, rounded up to whole groups of lanes
+
+    // Per-system state, one entry per lane
+    EnsembleFloats x0, x1;
+    EnsembleFloats v0, v1;
+    EnsembleFloats m0, m1;
+    EnsembleFloats collisions;     // Counted in float so it can be updated under a mask
+    int steps;                     // Steps run so far
+
+    // Momentum and energy of every system, sampled every historyInterval steps
+    // (sample s of system i is at [s * padded + i]). Sample 0 is the initial state.
+    int historyInterval;
+    int historySamples;
+    EnsembleFloats momentumHistory;
+    EnsembleFloats energyHistory;
+};
+
+// Number of systems stepped per instruction by the dispatched kernels (16 with
+// AVX-512, 8 with AVX2, 4 with SSE2, else 1)
+int squareEnsembleLanes();
+
+// Set up count systems starting like resetSquares, with masses 1 and
+// massRatios[i] and initial velocities v1[i] and v2[i].
+// historyInterval 0 records no history.
+void initSquareEnsemble(SquareEnsemble &ensemble, int count, const float *massRatios, const float *v1, const float *v2,
+                        int historyInterval);
+
+// Advance every system by steps steps, appending history samples as they fall due
+void runSquareEnsemble(SquareEnsemble &ensemble, int steps);
@@ -0,0 +1,521 @@
+#include "stable_fluid.h"
+#include "cpu_dispatch.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Multigrid settings: V-cycles per step, Jacobi sweeps before and after each
+// coarse correction, and sweeps on the coarsest grid
+const int FLUID_V_CYCLES = 2;
+const int FLUID_SMOOTHING_SWEEPS = 2;
+const int FLUID_COARSEST_SWEEPS = 200;
+const float FLUID_JACOBI_WEIGHT = 0.8f;
+
+// Coarsening stops at this many cells across
+const int FLUID_COARSEST_CELLS = 4;
+
+// Rows a worker claims at a time
+const int FLUID_ROW_BATCH = 8;
+
+struct FluidWorkerPool
+{
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake, finished;
+    std::function<void(int, int)> job; // Processes rows [begin, end)
+    int rows;
+    std::atomic<int> nextRow;
+    unsigned int generation;
+    int busy; // Workers still on the current job
+    bool quit;
+};
+
+static void runRows(FluidWorkerPool &pool)
+{
+    for (int row = pool.nextRow.fetch_add(FLUID_ROW_BATCH); row < pool.rows; row = pool.nextRow.fetch_add(FLUID_ROW_BATCH))
+        pool.job(row, std::min(row + FLUID_ROW_BATCH, pool.rows));
+}
+
+static void fluidWorker(FluidWorkerPool *pool)
+{
+    profilerSetThreadName("fluid worker");
+    unsigned int seen = 0;
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    for (;;)
+    {
+        pool->wake.wait(lock, [&]() { return pool->quit || pool->generation != seen; });
+        if (pool->quit)
+            return;
+        seen = pool->generation;
+        lock.unlock();
+        runRows(*pool);
+        lock.lock();
+        if (--pool->busy == 0)
+            pool->finished.notify_one();
+    }
+}
+
+// Run job over rows [0, rows) on the pool, the calling thread included
+static void parallelRows(StableFluid &fluid, int rows, const std::function<void(int, int)> &job)
+{
+    FluidWorkerPool &pool = *fluid.pool;
+    if (pool.threads.empty() || rows <= FLUID_ROW_BATCH)
+    {
+        job(0, rows);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.job = job;
+        pool.rows = rows;
+        pool.nextRow = 0;
+        pool.busy = (int)pool.threads.size();
+        pool.generation++;
+    }
+    pool.wake.notify_all();
+    runRows(pool);
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    pool.finished.wait(lock, [&]() { return pool.busy == 0; });
+}
+
+static void initLevel(FluidGridLevel &level, int width, int height)
+{
+    level.width = width;
+    level.height = height;
+    level.stride = width + 2;
+    size_t cells = (size_t)(width + 2) * (height + 2);
+    level.x.assign(cells, 0.0f);
+    level.scratch.assign(cells, 0.0f);
+    level.b.assign(cells, 0.0f);
+    level.residual.assign(cells, 0.0f);
+    level.diag.assign(cells, 0.0f);
+    level.invDiag.assign(cells, 0.0f);
+    level.fluid.assign(cells, 0.0f);
+    level.open.assign(cells, 0);
+}
+
+// Derive the stencil of a level from its open cells. The right-hand ring is
+// the outflow: its cells hold 0 and the last column counts one extra
+// neighbour, which puts the zero pressure on the outflow face itself
+// (the ghost value is minus the cell's) at every level alike.
+static void finishLevel(FluidGridLevel &level)
+{
+    int s = level.stride;
+    for (int j = 0; j < level.height; j++)
+        level.open[(j + 1) * s + level.width + 1] = 1;
+    for (int j = 0; j < level.height; j++)
+    {
+        for (int i = 0; i < level.width; i++)
+        {
+            int c = (j + 1) * s + i + 1;
+            if (!level.open[c])
+            {
+                level.fluid[c] = level.diag[c] = level.invDiag[c] = level.x[c] = 0.0f;
+                continue;
+            }
+            float diag = (float)(level.open[c - 1] + level.open[c + 1] + level.open[c - s] + level.open[c + s]);
+            if (i == level.width - 1)
+                diag += 1.0f;
+            level.fluid[c] = 1.0f;
+            level.diag[c] = diag;
+            level.invDiag[c] = diag > 0.0f ? 1.0f / diag : 0.0f;
+        }
+    }
+}
+
+void initStableFluid(StableFluid &fluid, int width, float minX, float minY, float maxX, float maxY, int threads)
+{
+    fluid.width = std::max(8, (width + 4) / 8 * 8);
+    fluid.cellSize = (maxX - minX) / fluid.width;
+    fluid.height = std::max(8, (int)((maxY - minY) / fluid.cellSize / 8.0f + 0.5f) * 8);
+    fluid.minX = minX;
+    fluid.minY = minY;
+    int w = fluid.width, h = fluid.height;
+    fluid.u.assign((size_t)(w + 1) * h, 0.0f);
+    fluid.v.assign((size_t)w * (h + 1), 0.0f);
+    fluid.uNext = fluid.u;
+    fluid.vNext = fluid.v;
+    fluid.uOpen.assign(fluid.u.size(), 0.0f);
+    fluid.vOpen.assign(fluid.v.size(), 0.0f);
+    fluid.solid.assign((size_t)w * h, 0);
+    fluid.vorticity.assign((size_t)w * h, 0.0f);
+    fluid.vCycles = FLUID_V_CYCLES;
+    fluid.divergence = 0.0f;
+
+    fluid.levels.clear();
+    for (int lw = w, lh = h;; lw /= 2, lh /= 2)
+    {
+        fluid.levels.push_back(FluidGridLevel());
+        initLevel(fluid.levels.back(), lw, lh);
+        if (lw % 2 != 0 || lh % 2 != 0 || std::min(lw, lh) / 2 < FLUID_COARSEST_CELLS)
+            break;
+    }
+
+    fluid.pool = new FluidWorkerPool();
+    fluid.pool->rows = 0;
+    fluid.pool->nextRow = 0;
+    fluid.pool->generation = 0;
+    fluid.pool->busy = 0;
+    fluid.pool->quit = false;
+    int threadCount = threads > 0 ? threads : (int)std::max(1u, std::thread::hardware_concurrency());
+    for (int t = 1; t < threadCount; t++)
+        fluid.pool->threads.emplace_back(fluidWorker, fluid.pool);
+
+    // No obstacle until one is set
+    setStableFluidObstacle(fluid, NULL, 0, 0, 0.0f, 0.0f, 0.0f, 0.0f);
+}
+
+void setStableFluidObstacle(StableFluid &fluid, const float *distances, int width, int height,
+                            float minX, float minY, float maxX, float maxY)
+{
+    PROFILE_ZONE("setStableFluidObstacle");
+    int w = fluid.width, h = fluid.height;
+
+    // Bilinear lookup of the distance at each cell centre
+    for (int j = 0; j < h; j++)
+    {
+        for (int i = 0; i < w; i++)
+        {
+            bool solid = false;
+            if (distances)
+            {
+                float x = fluid.minX + (i + 0.5f) * fluid.cellSize;
+                float y = fluid.minY + (j + 0.5f) * fluid.cellSize;
+                float fx = std::min(std::max((x - minX) / (maxX - minX) * width - 0.5f, 0.0f), width - 1.0f);
+                float fy = std::min(std::max((y - minY) / (maxY - minY) * height - 0.5f, 0.0f), height - 1.0f);
+                int x0 = std::min((int)fx, width - 2), y0 = std::min((int)fy, height - 2);
+                float tx = fx - x0, ty = fy - y0;
+                const float *row0 = distances + y0 * width, *row1 = row0 + width;
+                float distance = (row0[x0] * (1.0f - tx) + row0[x0 + 1] * tx) * (1.0f - ty) +
+                                 (row1[x0] * (1.0f - tx) + row1[x0 + 1] * tx) * ty;
+                solid = distance < 0.0f;
+            }
+            fluid.solid[j * w + i] = solid;
+        }
+    }
+
+    // Faces are free between two fluid cells; the inflow face and the walls are fixed
+    for (int j = 0; j < h; j++)
+    {
+        for (int i = 0; i <= w; i++)
+        {
+            bool open = i > 0 && !fluid.solid[j * w + i - 1] && (i == w || !fluid.solid[j * w + i]);
+            fluid.uOpen[j * (w + 1) + i] = open ? 1.0f : 0.0f;
+        }
+    }
+    for (int j = 0; j <= h; j++)
+    {
+        for (int i = 0; i < w; i++)
+        {
+            bool open = j > 0 && j < h && !fluid.solid[(j - 1) * w + i] && !fluid.solid[j * w + i];
+            fluid.vOpen[j * w + i] = open ? 1.0f : 0.0f;
+        }
+    }
+    for (size_t f = 0; f < fluid.u.size(); f++)
+        fluid.u[f] *= fluid.uOpen[f];
+    for (size_t f = 0; f < fluid.v.size(); f++)
+        fluid.v[f] *= fluid.vOpen[f];
+
+    // Multigrid hierarchy: a coarse cell is fluid if any of its children is
+    FluidGridLevel &finest = fluid.levels[0];
+    for (int j = 0; j < h; j++)
+        for (int i = 0; i < w; i++)
+            finest.open[(j + 1) * finest.stride + i + 1] = !fluid.solid[j * w + i];
+    finishLevel(finest);
+    for (size_t l = 1; l < fluid.levels.size(); l++)
+    {
+        FluidGridLevel &fine = fluid.levels[l - 1], &coarse = fluid.levels[l];
+        for (int j = 0; j < coarse.height; j++)
+        {
+            for (int i = 0; i < coarse.width; i++)
+            {
+                int f = (2 * j + 1) * fine.stride + 2 * i + 1;
+                coarse.open[(j + 1) * coarse.stride + i + 1] =
+                    fine.open[f] | fine.open[f + 1] | fine.open[f + fine.stride] | fine.open[f + fine.stride + 1];
+            }
+        }
+        finishLevel(coarse);
+    }
+    std::fill(finest.x.begin(), finest.x.end(), 0.0f);
+}
+
+// Bilinear samples of the staggered components, at a point in cell units
+static float sampleU(const StableFluid &fluid, float gx, float gy)
+{
+    int w = fluid.width, h = fluid.height;
+    float fx = std::min(std::max(gx, 0.0f), (float)w);
+    float fy = std::min(std::max(gy - 0.5f, 0.0f), h - 1.0f);
+    int i = std::min((int)fx, w - 1), j = std::min((int)fy, h - 2);
+    float tx = fx - i, ty = fy - j;
+    const float *row0 = &fluid.u[(size_t)j * (w + 1) + i], *row1 = row0 + w + 1;
+    return (row0[0] * (1.0f - tx) + row0[1] * tx) * (1.0f - ty) + (row1[0] * (1.0f - tx) + row1[1] * tx) * ty;
+}
+
+static float sampleV(const StableFluid &fluid, float gx, float gy)
+{
+    int w = fluid.width, h = fluid.height;
+    float fx = std::min(std::max(gx - 0.5f, 0.0f), w - 1.0f);
+    float fy = std::min(std::max(gy, 0.0f), (float)h);
+    int i = std::min((int)fx, w - 2), j = std::min((int)fy, h - 1);
+    float tx = fx - i, ty = fy - j;
+    const float *row0 = &fluid.v[(size_t)j * w + i], *row1 = row0 + w;
+    return (row0[0] * (1.0f - tx) + row0[1] * tx) * (1.0f - ty) + (row1[0] * (1.0f - tx) + row1[1] * tx) * ty;
+}
+
+void sampleStableFluidVelocity(const StableFluid &fluid, float x, float y, float &vx, float &vy)
+{
+    float gx = (x - fluid.minX) / fluid.cellSize, gy = (y - fluid.minY) / fluid.cellSize;
+    vx = sampleU(fluid, gx, gy);
+    vy = sampleV(fluid, gx, gy);
+}
+
+bool stableFluidSolidAt(const StableFluid &fluid, float x, float y)
+{
+    int i = (int)std::floor((x - fluid.minX) / fluid.cellSize);
+    int j = (int)std::floor((y - fluid.minY) / fluid.cellSize);
+    if (i < 0 || j < 0 || i >= fluid.width || j >= fluid.height)
+        return false;
+    return fluid.solid[j * fluid.width + i] != 0;
+}
+
+// Semi-Lagrangian advection of both components: trace each face back along
+// the velocity for one step and take the value found there
+static void advectVelocity(StableFluid &fluid)
+{
+    PROFILE_ZONE("advectVelocity");
+    int w = fluid.width, h = fluid.height;
+    float toCells = 1.0f / fluid.cellSize;
+    parallelRows(fluid, h + 1, [&](int begin, int end)
+                 {
+        for (int j = begin; j < end; j++)
+        {
+            if (j < h)
+            {
+                for (int i = 0; i <= w; i++)
+                {
+                    float gx = (float)i, gy = j + 0.5f;
+                    float du = fluid.u[(size_t)j * (w + 1) + i] * toCells;
+                    float dv = sampleV(fluid, gx, gy) * toCells;
+                    fluid.uNext[(size_t)j * (w + 1) + i] = sampleU(fluid, gx - du, gy - dv);
+                }
+            }
+            for (int i = 0; i < w; i++)
+            {
+                float gx = i + 0.5f, gy = (float)j;
+                float du = sampleU(fluid, gx, gy) * toCells;
+                float dv = fluid.v[(size_t)j * w + i] * toCells;
+                fluid.vNext[(size_t)j * w + i] = sampleV(fluid, gx - du, gy - dv);
+            }
+        } });
+    fluid.u.swap(fluid.uNext);
+    fluid.v.swap(fluid.vNext);
+}
+
+// One damped Jacobi sweep of sum(neighbours) - diag * x = b into scratch
+static void jacobiRows(FluidGridLevel &level, int begin, int end)
+{
+    for (int j = begin; j < end; j++)
+    {
+        int row = (j + 1) * level.stride + 1;
+        simdKernels->jacobiRow(&level.x[row], &level.b[row], &level.invDiag[row], &level.scratch[row], level.width, level.stride,
+                               FLUID_JACOBI_WEIGHT);
+    }
+}
+
+static void smooth(StableFluid &fluid, FluidGridLevel &level, int sweeps)
+{
+    for (int k = 0; k < sweeps; k++)
+    {
+        parallelRows(fluid, level.height, [&](int begin, int end) { jacobiRows(level, begin, end); });
+        level.x.swap(level.scratch);
+    }
+}
+
+static void residualRows(FluidGridLevel &level, int begin, int end)
+{
+    for (int j = begin; j < end; j++)
+    {
+        int row = (j + 1) * level.stride + 1;
+        simdKernels->residualRow(&level.x[row], &level.b[row], &level.diag[row], &level.fluid[row], &level.residual[row],
+                                 level.width, level.stride);
+    }
+}
+
+// Coarse right-hand side: the sum of the four fine residuals (the unscaled
+// stencil grows by 4 per level); the coarse correction starts from zero
+static void restrictRows(const FluidGridLevel &fine, FluidGridLevel &coarse, int begin, int end)
+{
+    for (int j = begin; j < end; j++)
+    {
+        for (int i = 0; i < coarse.width; i++)
+        {
+            int f = (2 * j + 1) * fine.stride + 2 * i + 1;
+            int c = (j + 1) * coarse.stride + i + 1;
+            coarse.b[c] = (fine.residual[f] + fine.residual[f + 1] + fine.residual[f + fine.stride] + fine.residual[f + fine.stride + 1]) * coarse.fluid[c];
+            coarse.x[c] = 0.0f;
+        }
+    }
+}
+
+// Add the bilinearly interpolated coarse correction to the fine fluid cells.
+// Closed coarse neighbours (walls, obstacle) take the parent's value.
+static void prolongRows(const FluidGridLevel &coarse, FluidGridLevel &fine, int begin, int end)
+{
+    int cs = coarse.stride;
+    for (int j = begin; j < end; j++)
+    {
+        int cj = j / 2, dj = (j & 1) ? cs : -cs;
+        for (int i = 0; i < fine.width; i++)
+        {
+            int f = (j + 1) * fine.stride + i + 1;
+            if (fine.fluid[f] == 0.0f)
+                continue;
+            int c = (cj + 1) * cs + i / 2 + 1, di = (i & 1) ? 1 : -1;
+            float centre = coarse.x[c];
+            float side = coarse.open[c + di] ? coarse.x[c + di] : centre;
+            float vertical = coarse.open[c + dj] ? coarse.x[c + dj] : centre;
+            float corner = coarse.open[c + di + dj] ? coarse.x[c + di + dj] : centre;
+            fine.x[f] += (9.0f * centre + 3.0f * side + 3.0f * vertical + corner) * (1.0f / 16.0f);
+        }
+    }
+}
+
+static void vCycle(StableFluid &fluid, size_t l)
+{
+    FluidGridLevel &level = fluid.levels[l];
+    if (l + 1 == fluid.levels.size())
+    {
+        for (int k = 0; k < FLUID_COARSEST_SWEEPS; k++)
+        {
+            jacobiRows(level, 0, level.height);
+            level.x.swap(level.scratch);
+        }
+        return;
+    }
+    FluidGridLevel &coarse = fluid.levels[l + 1];
+    smooth(fluid, level, FLUID_SMOOTHING_SWEEPS);
+    parallelRows(fluid, level.height, [&](int begin, int end) { residualRows(level, begin, end); });
+    parallelRows(fluid, coarse.height, [&](int begin, int end) { restrictRows(level, coarse, begin, end); });
+    vCycle(fluid, l + 1);
+    parallelRows(fluid, level.height, [&](int begin, int end) { prolongRows(coarse, level, begin, end); });
+    smooth(fluid, level, FLUID_SMOOTHING_SWEEPS);
+}
+
+// Net outflow of each cell times the cell size: the right-hand side of the
+// pressure equation, and after the projection a measure of what is left
+static void divergenceRows(const StableFluid &fluid, FluidGridLevel &level, int begin, int end)
+{
+    int w = fluid.width;
+    for (int j = begin; j < end; j++)
+    {
+        const float *uRow = &fluid.u[(size_t)j * (w + 1)];
+        const float *vBottom = &fluid.v[(size_t)j * w], *vTop = vBottom + w;
+        int cell = (j + 1) * level.stride + 1;
+        simdKernels->divergenceRow(uRow, vBottom, vTop, &level.fluid[cell], &level.b[cell], w, fluid.cellSize);
+    }
+}
+
+// Subtract the pressure gradient from the free faces
+static void subtractGradient(StableFluid &fluid)
+{
+    int w = fluid.width, h = fluid.height;
+    const FluidGridLevel &level = fluid.levels[0];
+    int s = level.stride;
+    float inverseH = 1.0f / fluid.cellSize;
+    parallelRows(fluid, h, [&](int begin, int end)
+                 {
+        for (int j = begin; j < end; j++)
+        {
+            // u faces 1..w of this row; on the outflow face w the pressure
+            // outside is minus the pressure inside
+            const float *p = &level.x[(j + 1) * s + 1];
+            float *u = &fluid.u[(size_t)j * (w + 1)];
+            const float *uOpen = &fluid.uOpen[(size_t)j * (w + 1)];
+            simdKernels->gradientRow(p + 1, p, uOpen + 1, u + 1, w - 1, inverseH);
+            u[w] += 2.0f * p[w - 1] * inverseH * uOpen[w];
+
+            // v faces between this row and the one below
+            if (j == 0)
+                continue;
+            simdKernels->gradientRow(p, p - s, &fluid.vOpen[(size_t)j * w], &fluid.v[(size_t)j * w], w, inverseH);
+        } });
+}
+
+// Curl at cell centres from the centred velocity differences
+static void computeVorticity(StableFluid &fluid)
+{
+    int w = fluid.width, h = fluid.height;
+    float inverse2H = 0.5f / fluid.cellSize;
+    parallelRows(fluid, h, [&](int begin, int end)
+                 {
+        for (int j = begin; j < end; j++)
+        {
+            int jb = std::max(j - 1, 0), jt = std::min(j + 1, h - 1);
+            for (int i = 0; i < w; i++)
+            {
+                int il = std::max(i - 1, 0), ir = std::min(i + 1, w - 1);
+                float vRight = 0.5f * (fluid.v[(size_t)j * w + ir] + fluid.v[(size_t)(j + 1) * w + ir]);
+                float vLeft = 0.5f * (fluid.v[(size_t)j * w + il] + fluid.v[(size_t)(j + 1) * w + il]);
+                float uTop = 0.5f * (fluid.u[(size_t)jt * (w + 1) + i] + fluid.u[(size_t)jt * (w + 1) + i + 1]);
+                float uBottom = 0.5f * (fluid.u[(size_t)jb * (w + 1) + i] + fluid.u[(size_t)jb * (w + 1) + i + 1]);
+                fluid.vorticity[(size_t)j * w + i] = fluid.solid[(size_t)j * w + i] ? 0.0f : ((vRight - vLeft) - (uTop - uBottom)) * inverse2H;
+            }
+        } });
+}
+
+void updateStableFluid(StableFluid &fluid, float streamSpeed)
+{
+    PROFILE_ZONE("updateStableFluid");
+    int w = fluid.width, h = fluid.height;
+    advectVelocity(fluid);
+
+    // Boundary conditions: fixed faces are zero, the inflow face carries the stream
+    for (size_t f = 0; f < fluid.u.size(); f++)
+        fluid.u[f] *= fluid.uOpen[f];
+    for (size_t f = 0; f < fluid.v.size(); f++)
+        fluid.v[f] *= fluid.vOpen[f];
+    for (int j = 0; j < h; j++)
+        fluid.u[(size_t)j * (w + 1)] = fluid.solid[(size_t)j * w] ? 0.0f : streamSpeed;
+
+    // Pressure projection
+    {
+        PROFILE_ZONE("Pressure projection");
+        FluidGridLevel &finest = fluid.levels[0];
+        parallelRows(fluid, h, [&](int begin, int end) { divergenceRows(fluid, finest, begin, end); });
+        for (int cycle = 0; cycle < fluid.vCycles; cycle++)
+            vCycle(fluid, 0);
+        subtractGradient(fluid);
+    }
+
+    // What the projection left behind, in velocity units
+    FluidGridLevel &finest = fluid.levels[0];
+    parallelRows(fluid, h, [&](int begin, int end) { divergenceRows(fluid, finest, begin, end); });
+    float largest = 0.0f;
+    for (int j = 0; j < h; j++)
+        for (int i = 0; i < w; i++)
+            largest = std::max(largest, std::fabs(finest.b[(j + 1) * finest.stride + i + 1]));
+    fluid.divergence = largest / fluid.cellSize;
+
+    computeVorticity(fluid);
+}
+
+void destroyStableFluid(StableFluid &fluid)
+{
+    if (!fluid.pool)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(fluid.pool->mutex);
+        fluid.pool->quit = true;
+    }
+    fluid.pool->wake.notify_all();
+    for (std::thread &thread : fluid.pool->threads)
+        thread.join();
+    delete fluid.pool;
+    fluid.pool = NULL;
+}
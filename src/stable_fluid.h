@@ -0,0 +1,67 @@
+#pragma once
+
+#include "memory_tracker.h"
+
+#include <vector>
+
+// Eulerian wind tunnel (Stam's "stable fluids") on a staggered MAC grid over
+// the box. Each step the velocity is advected semi-Lagrangian, then made
+// divergence free by a pressure projection solved with geometric multigrid
+// V-cycles (damped Jacobi smoothing, cell-centred restriction and bilinear
+// prolongation, warm started from the last step's pressure). Air enters at
+// streamSpeed on the left and leaves on the right (pressure 0 there); the top
+// and bottom walls and the voxelised obstacle are solid. The grid kernels
+// are SIMD over a row and split by rows over a small pool of worker threads.
+
+// Grid storage, counted as stable-fluid memory
+typedef TaggedVector<float, MEMORY_STABLE_FLUID> FluidFloats;
+typedef TaggedVector<unsigned char, MEMORY_STABLE_FLUID> FluidBytes;
+
+struct FluidGridLevel
+{
+    int width, height;  // Cells; arrays are (width + 2) x (height + 2) with a ring of boundary cells
+    int stride;         // width + 2
+    FluidFloats x, scratch; // Solution (pressure on level 0) and the Jacobi target
+    FluidFloats b, residual;
+    FluidFloats diag, invDiag; // Open neighbours of each fluid cell; invDiag 0 outside the fluid
+    FluidFloats fluid;         // 1 for fluid cells, 0 for solid cells and the ring
+    FluidBytes open;           // Fluid cells plus the outflow ring (pressure fixed at 0)
+};
+
+struct FluidWorkerPool;
+
+struct StableFluid
+{
+    int width, height; // Cells
+    float minX, minY, cellSize;
+    FluidFloats u, v;         // Face velocities: u is (width + 1) x height, v is width x (height + 1)
+    FluidFloats uNext, vNext; // Advection targets
+    FluidFloats uOpen, vOpen; // 1 where a face is free, 0 on walls, obstacle faces and the inflow
+    FluidBytes solid;
+    FluidFloats vorticity;    // Per cell, for display
+    TaggedVector<FluidGridLevel, MEMORY_STABLE_FLUID> levels;
+    int vCycles;          // Per step
+    float divergence;     // Largest |div u| * cellSize after the last projection
+    FluidWorkerPool *pool;
+};
+
+// Grid of width x (width * box aspect) cells; width is rounded to a multiple
+// of 8 so the multigrid hierarchy coarsens evenly. threads 0 = one per
+// hardware thread.
+void initStableFluid(StableFluid &fluid, int width, float minX, float minY, float maxX, float maxY, int threads);
+
+// Voxelise an obstacle from a signed distance field covering [minX,maxX] x [minY,maxY]
+// (negative inside, as built for the GPU backend); cells whose centre is inside are solid
+void setStableFluidObstacle(StableFluid &fluid, const float *distances, int width, int height,
+                            float minX, float minY, float maxX, float maxY);
+
+// Advance one step with air entering at streamSpeed (box units per step)
+void updateStableFluid(StableFluid &fluid, float streamSpeed);
+
+// Velocity at a point, in box units per step
+void sampleStableFluidVelocity(const StableFluid &fluid, float x, float y, float &vx, float &vy);
+
+// Whether the cell containing the point is solid
+bool stableFluidSolidAt(const StableFluid &fluid, float x, float y);
+
+void destroyStableFluid(StableFluid &fluid);
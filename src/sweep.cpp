@@ -0,0 +1,442 @@
+#include "sweep.h"
+#include "simulation.h"
+#include "square_ensemble.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SweepParameter
+{
+    const char *name;
+    std::vector<double> values;
+};
+
+// One demo that can be swept: its parameters (with defaults), the metric
+// columns it reports and the function that runs a single instance. Demos with
+// an ensemble mode also provide runBatch, which runs count consecutive grid
+// points at once and must produce the same metrics.
+struct SweepDemo
+{
+    const char *name;
+    std::vector<SweepParameter> parameters;
+    std::vector<const char *> metrics;
+    int defaultSteps;
+    void (*run)(const double *params, int steps, double *metrics);
+    void (*runBatch)(const double *params, int count, int steps, double *metrics);
+};
+
+// Grid points handed to runBatch at a time
+const int SWEEP_BATCH_SIZE = 1024;
+
+// Force threads of each N-body run: the cores left over per sweep worker, so
+// concurrent runs do not each start one per core
+static int nbodyForceThreads = 0;
+
+// Red demo: params = count, seed
+static void runBalls(const double *params, int steps, double *metrics)
+{
+    BallSim sim;
+    initBalls(sim, (int)params[0], (unsigned int)params[1]);
+
+    double initialEnergy = 0.0;
+    for (const Ball &b : sim.balls)
+        initialEnergy += 0.5 * (b.vx * b.vx + b.vy * b.vy);
+
+    for (int step = 0; step < steps; step++)
+        updateBall(sim);
+
+    double energy = 0.0, px = 0.0, py = 0.0, speed = 0.0;
+    for (const Ball &b : sim.balls)
+    {
+        energy += 0.5 * (b.vx * b.vx + b.vy * b.vy);
+        px += b.vx;
+        py += b.vy;
+        speed += sqrt(b.vx * b.vx + b.vy * b.vy);
+    }
+    metrics[0] = initialEnergy;
+    metrics[1] = energy;
+    metrics[2] = initialEnergy > 0.0 ? (energy - initialEnergy) / initialEnergy : 0.0;
+    metrics[3] = px;
+    metrics[4] = py;
+    metrics[5] = sim.balls.empty() ? 0.0 : speed / sim.balls.size();
+    metrics[6] = sim.collisions;
+}
+
+// Kinetic plus potential energy of an N-body system, from the bodies and the
+// potentials of the last force evaluation (sim.stats is compiled out without
+// PHYSICS_TELEMETRY)
+static double nbodyEnergy(const BallSim &sim)
+{
+    double energy = 0.0;
+    for (const Ball &b : sim.balls)
+        energy += 0.5 * (b.vx * b.vx + b.vy * b.vy);
+    for (float potential : sim.tree.potential)
+        energy += 0.5 * potential;
+    return energy;
+}
+
+// Red demo in N-body mode: params = count, opening angle, seed
+static void runNBody(const double *params, int steps, double *metrics)
+{
+    BallSim sim;
+    initBalls(sim, (int)params[0], (unsigned int)params[2]);
+    setBallGravity(sim, true, (float)params[1]);
+    sim.gravityParams.threads = nbodyForceThreads;
+
+    // Energies are only known after a step (the potential comes from the tree)
+    updateBall(sim);
+    double initialEnergy = nbodyEnergy(sim);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int step = 1; step < steps; step++)
+        updateBall(sim);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double energy = nbodyEnergy(sim);
+    metrics[0] = initialEnergy;
+    metrics[1] = energy;
+    metrics[2] = initialEnergy != 0.0 ? (energy - initialEnergy) / fabs(initialEnergy) : 0.0;
+    metrics[3] = steps > 1 ? seconds * 1000.0 / (steps - 1) : 0.0;
+}
+
+// Blue demo: params = mass ratio, v1, v2
+static void runSquares(const double *params, int steps, double *metrics)
+{
+    SquareSim sim;
+    initSquareMasses(sim, (float)params[0]);
+    resetSquares(sim);
+    sim.squares[0].vx = (float)params[1];
+    sim.squares[1].vx = (float)params[2];
+
+    double initialMomentum = 0.0, initialEnergy = 0.0;
+    for (const Square &s : sim.squares)
+    {
+        initialMomentum += s.mass * s.vx;
+        initialEnergy += 0.5 * s.mass * s.vx * s.vx;
+    }
+
+    for (int step = 0; step < steps; step++)
+        updateSquare(sim);
+
+    double momentum = 0.0, energy = 0.0;
+    for (const Square &s : sim.squares)
+    {
+        momentum += s.mass * s.vx;
+        energy += 0.5 * s.mass * s.vx * s.vx;
+    }
+    metrics[0] = initialMomentum;
+    metrics[1] = momentum;
+    metrics[2] = initialEnergy;
+    metrics[3] = energy;
+    metrics[4] = sim.squares[0].vx;
+    metrics[5] = sim.squares[1].vx;
+    metrics[6] = sim.collisions;
+}
+
+// Blue demo in ensemble mode: the same metrics for count systems, one per SIMD lane
+static void runSquaresBatch(const double *params, int count, int steps, double *metrics)
+{
+    std::vector<float> massRatios(count), v1(count), v2(count);
+    for (int i = 0; i < count; i++)
+    {
+        massRatios[i] = (float)params[i * 3 + 0];
+        v1[i] = (float)params[i * 3 + 1];
+        v2[i] = (float)params[i * 3 + 2];
+    }
+
+    SquareEnsemble ensemble;
+    initSquareEnsemble(ensemble, count, massRatios.data(), v1.data(), v2.data(), 0);
+    runSquareEnsemble(ensemble, steps);
+
+    // Same arithmetic as runSquares so both paths print identical tables
+    for (int i = 0; i < count; i++)
+    {
+        float m0 = ensemble.m0[i], m1 = ensemble.m1[i];
+        float u0 = ensemble.v0[i], u1 = ensemble.v1[i];
+        double *out = &metrics[i * 7];
+        out[0] = (double)(m0 * v1[i]) + (double)(m1 * v2[i]);
+        out[1] = (double)(m0 * u0) + (double)(m1 * u1);
+        out[2] = 0.5 * m0 * v1[i] * v1[i] + 0.5 * m1 * v2[i] * v2[i];
+        out[3] = 0.5 * m0 * u0 * u0 + 0.5 * m1 * u1 * u1;
+        out[4] = u0;
+        out[5] = u1;
+        out[6] = ensemble.collisions[i];
+    }
+}
+
+// Total cradle energy: kinetic 1/2 m (L w)^2 plus potential m g L (1 - cos a)
+static double cradleEnergy(const CradleSim &sim)
+{
+    double energy = 0.0;
+    for (const Pendulum &p : sim.pendulums)
+    {
+        energy += 0.5 * p.mass * (p.length * p.angularVel) * (p.length * p.angularVel);
+        energy += p.mass * GRAVITY * p.length * (1.0 - cos(p.angle));
+    }
+    return energy;
+}
+
+// Green demo: params = number of balls pulled back
+static void runCradle(const double *params, int steps, double *metrics)
+{
+    CradleSim sim;
+    initNewtonsCradle(sim);
+    pullBackPendulums(sim, (int)params[0]);
+
+    double initialEnergy = cradleEnergy(sim);
+    float lastSwing = 0.0f;
+    for (int step = 0; step < steps; step++)
+    {
+        updateNewtonsCradle(sim);
+        lastSwing = std::max(lastSwing, sim.pendulums[NUM_PENDULUMS - 1].angle);
+    }
+    double energy = cradleEnergy(sim);
+    metrics[0] = initialEnergy;
+    metrics[1] = energy;
+    metrics[2] = initialEnergy > 0.0 ? energy / initialEnergy : 0.0;
+    metrics[3] = lastSwing;
+    metrics[4] = sim.collisions;
+}
+
+// Yellow demo: params = stream speed, shape, obstacle radius, seed, airfoil angle of attack (degrees)
+static void runFluid(const double *params, int steps, double *metrics)
+{
+    FluidSim sim;
+    initFluidDemo(sim, (unsigned int)params[3]);
+    sim.streamSpeed = (float)params[0];
+    sim.shape = (ObstacleShape)(int)params[1];
+    sim.obstacleRadius = (float)params[2];
+    sim.airfoil.angleOfAttack = (float)(params[4] * 3.14159265358979 / 180.0);
+
+    for (int step = 0; step < steps; step++)
+        updateFluidDemo(sim);
+
+    double meanVx = 0.0, meanAbsVy = 0.0;
+    int active = 0, turbulent = 0;
+    for (const FluidParticle &p : sim.particles)
+    {
+        if (!p.active)
+            continue;
+        active++;
+        meanVx += p.vx;
+        meanAbsVy += fabs(p.vy);
+        if (sqrt(p.vx * p.vx + p.vy * p.vy) >= sim.streamSpeed * 1.5f)
+            turbulent++;
+    }
+    metrics[0] = sim.exited;
+    metrics[1] = active ? meanVx / active : 0.0;
+    metrics[2] = active ? meanAbsVy / active : 0.0;
+    metrics[3] = active ? (double)turbulent / active : 0.0;
+}
+
+static std::vector<SweepDemo> sweepDemos()
+{
+    return {
+        {"balls", {{"count", {50}}, {"seed", {1}}}, {"energy0", "energy", "energy_drift", "px", "py", "mean_speed", "collisions"}, 5000, runBalls, NULL},
+        {"nbody", {{"count", {100000}}, {"theta", {NBODY_OPENING_ANGLE}}, {"seed", {1}}}, {"energy0", "energy", "energy_drift", "ms_per_step"}, 100, runNBody, NULL},
+        {"squares", {{"mass", {1}}, {"v1", {0.004}}, {"v2", {-0.003}}}, {"momentum0", "momentum", "energy0", "energy", "v1_final", "v2_final", "collisions"}, 10000, runSquares, runSquaresBatch},
+        {"cradle", {{"pull", {1}}}, {"energy0", "energy", "energy_ratio", "last_ball_max_angle", "collisions"}, 5000, runCradle, NULL},
+        {"fluid", {{"speed", {0.01}}, {"shape", {0}}, {"radius", {0.15}}, {"seed", {1}}, {"aoa", {0}}}, {"exited", "mean_vx", "mean_abs_vy", "turbulent_fraction"}, 2000, runFluid, NULL},
+    };
+}
+
+// Parse "1,2,5", "1:8" or "0.1:0.5:0.1"; shape names are accepted as values
+static bool parseValues(const char *text, std::vector<double> &values)
+{
+    values.clear();
+    std::string list = text;
+    size_t start = 0;
+    while (start <= list.size())
+    {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos)
+            end = list.size();
+        std::string item = list.substr(start, end - start);
+        start = end + 1;
+        if (item.empty())
+            continue;
+
+        if (item == "ball")
+            values.push_back((double)ObstacleShape::BALL);
+        else if (item == "triangle")
+            values.push_back((double)ObstacleShape::TRIANGLE);
+        else if (item == "airfoil")
+            values.push_back((double)ObstacleShape::AIRFOIL);
+        else
+        {
+            double first, last, step = 1.0;
+            int fields = sscanf(item.c_str(), "%lf:%lf:%lf", &first, &last, &step);
+            if (fields == 1)
+                values.push_back(first);
+            else if (fields >= 2 && step > 0.0)
+            {
+                for (int i = 0; first + i * step <= last + step * 1e-9; i++)
+                    values.push_back(first + i * step);
+            }
+            else
+                return false;
+        }
+    }
+    return !values.empty();
+}
+
+int runSweep(int argc, char **argv)
+{
+    // Find the demo name following --sweep
+    int first = 1;
+    while (first < argc && strcmp(argv[first], "--sweep") != 0)
+        first++;
+    if (first + 1 >= argc)
+    {
+        std::cerr << "Usage: --sweep balls|nbody|squares|cradle|fluid [name=values ...] [steps=N] [threads=N] [ensemble=0|1] [out=FILE] [profile=FILE]" << std::endl;
+        return 1;
+    }
+
+    std::vector<SweepDemo> demos = sweepDemos();
+    SweepDemo *demo = NULL;
+    for (SweepDemo &d : demos)
+    {
+        if (strcmp(d.name, argv[first + 1]) == 0)
+            demo = &d;
+    }
+    if (!demo)
+    {
+        std::cerr << "Unknown sweep demo " << argv[first + 1] << std::endl;
+        return 1;
+    }
+
+    int steps = demo->defaultSteps;
+    int threadCount = (int)std::thread::hardware_concurrency();
+    bool ensemble = demo->runBatch != NULL;
+    const char *outPath = NULL;
+    const char *profilePath = NULL;
+    for (int i = first + 2; i < argc; i++)
+    {
+        const char *equals = strchr(argv[i], '=');
+        if (!equals)
+            continue;
+        std::string key(argv[i], equals - argv[i]);
+        const char *value = equals + 1;
+        if (key == "steps")
+            steps = atoi(value);
+        else if (key == "threads")
+            threadCount = atoi(value);
+        else if (key == "out")
+            outPath = value;
+        else if (key == "profile")
+            profilePath = value;
+        else if (key == "ensemble")
+            ensemble = demo->runBatch != NULL && atoi(value) != 0;
+        else
+        {
+            bool known = false;
+            for (SweepParameter &parameter : demo->parameters)
+            {
+                if (key == parameter.name)
+                {
+                    known = true;
+                    if (!parseValues(value, parameter.values))
+                    {
+                        std::cerr << "Bad values for " << key << ": " << value << std::endl;
+                        return 1;
+                    }
+                }
+            }
+            if (!known)
+            {
+                std::cerr << "Unknown parameter " << key << " for " << demo->name << std::endl;
+                return 1;
+            }
+        }
+    }
+    if (threadCount < 1)
+        threadCount = 1;
+    nbodyForceThreads = std::max(1, (int)std::thread::hardware_concurrency() / threadCount);
+
+    // Expand the grid (cartesian product, last parameter varies fastest)
+    size_t parameterCount = demo->parameters.size();
+    size_t runCount = 1;
+    for (const SweepParameter &parameter : demo->parameters)
+        runCount *= parameter.values.size();
+    std::vector<double> grid(runCount * parameterCount);
+    for (size_t run = 0; run < runCount; run++)
+    {
+        size_t index = run;
+        for (size_t p = parameterCount; p-- > 0;)
+        {
+            const std::vector<double> &values = demo->parameters[p].values;
+            grid[run * parameterCount + p] = values[index % values.size()];
+            index /= values.size();
+        }
+    }
+
+    // Workers pull run indices (or batches of them) until the grid is exhausted
+    size_t metricCount = demo->metrics.size();
+    std::vector<double> results(runCount * metricCount);
+    std::atomic<size_t> nextRun(0);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (profilePath)
+        startProfiler();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threadCount; t++)
+    {
+        workers.emplace_back([&, t]()
+                             {
+            std::string threadName = "sweep worker " + std::to_string(t);
+            profilerSetThreadName(threadName.c_str());
+            if (ensemble)
+            {
+                for (size_t run = nextRun.fetch_add(SWEEP_BATCH_SIZE); run < runCount; run = nextRun.fetch_add(SWEEP_BATCH_SIZE))
+                {
+                    PROFILE_ZONE("Sweep batch");
+                    int count = (int)std::min((size_t)SWEEP_BATCH_SIZE, runCount - run);
+                    demo->runBatch(&grid[run * parameterCount], count, steps, &results[run * metricCount]);
+                }
+                return;
+            }
+            for (size_t run = nextRun++; run < runCount; run = nextRun++)
+            {
+                PROFILE_ZONE("Sweep run");
+                demo->run(&grid[run * parameterCount], steps, &results[run * metricCount]);
+            } });
+    }
+    for (std::thread &worker : workers)
+        worker.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // One table: parameters then metrics
+    FILE *out = outPath ? fopen(outPath, "w") : stdout;
+    if (!out)
+    {
+        std::cerr << "Failed to open " << outPath << std::endl;
+        return 1;
+    }
+    for (size_t p = 0; p < parameterCount; p++)
+        fprintf(out, "%s,", demo->parameters[p].name);
+    for (size_t m = 0; m < metricCount; m++)
+        fprintf(out, "%s%s", demo->metrics[m], m + 1 < metricCount ? "," : "\n");
+    for (size_t run = 0; run < runCount; run++)
+    {
+        for (size_t p = 0; p < parameterCount; p++)
+            fprintf(out, "%.9g,", grid[run * parameterCount + p]);
+        for (size_t m = 0; m < metricCount; m++)
+            fprintf(out, "%.9g%s", results[run * metricCount + m], m + 1 < metricCount ? "," : "\n");
+    }
+    if (out != stdout)
+        fclose(out);
+    if (profilePath && !writeProfilerTrace(profilePath))
+        std::cerr << "Profiler not written (compiled out in release builds or file error)" << std::endl;
+
+    std::cerr << "Sweep " << demo->name << ": " << runCount << " runs x " << steps << " steps on " << threadCount
+              << " threads" << (ensemble ? " (ensemble)" : "") << " in " << seconds << " s (" << (seconds > 0.0 ? runCount / seconds * 3600.0 : 0.0) << " runs/hour)" << std::endl;
+    return 0;
+}
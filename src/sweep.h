@@ -0,0 +1,14 @@
+#pragma once
+
+// Headless parameter sweeps. Runs one simulation instance per grid point,
+// spread over one worker thread per core, and writes a single CSV table with
+// the parameters and summary metrics of every run:
+//
+//   PhysicsDemo --sweep squares mass=1,2,5,10 steps=20000 out=squares.csv
+//   PhysicsDemo --sweep balls count=5,10,50 seed=1:32 threads=8
+//   PhysicsDemo --sweep fluid speed=0.002,0.005,0.01 shape=ball,triangle,airfoil
+//
+// Values are comma separated; a:b expands to the integers a..b and a:b:step to
+// an arithmetic range. The grid is the cartesian product of all parameters.
+// Returns the process exit code.
+int runSweep(int argc, char **argv);
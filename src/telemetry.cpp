@@ -0,0 +1,131 @@
+#include "telemetry.h"
+
+#if PHYSICS_TELEMETRY
+
+#include "profiler.h"
+#include "spsc_queue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+static SpscQueue<TelemetrySample, TELEMETRY_RING_SIZE> telemetryRing;
+static std::atomic<unsigned long long> telemetryDropped(0);
+static std::atomic<bool> telemetryRunning(false);
+static std::thread telemetryThread;
+static FILE *telemetryFile = NULL;
+
+// Producer-side: a restart whose sample was dropped is carried to the next
+// sample of that demo that makes it into the ring
+static bool pendingRestart[TELEMETRY_MAX_DEMOS];
+
+// Sink-side state per demo; the mutex is only shared between the sink and
+// the HUD, never the simulation
+static std::mutex snapshotMutex;
+static TelemetrySnapshot snapshots[TELEMETRY_MAX_DEMOS];
+static TelemetrySample baselines[TELEMETRY_MAX_DEMOS];
+
+static void consumeSample(const TelemetrySample &sample)
+{
+    const ConservationStats &s = sample.stats;
+    if (telemetryFile)
+    {
+        fprintf(telemetryFile, "%llu,%d,%d,%.9g,%.9g,%.9g,%.9g,%.9g\n", sample.step, sample.demo, sample.restart ? 1 : 0,
+                s.kinetic, s.potential, s.momentumX, s.momentumY, s.penetration);
+    }
+
+    std::lock_guard<std::mutex> lock(snapshotMutex);
+    TelemetrySnapshot &snapshot = snapshots[sample.demo];
+    if (sample.restart || !snapshot.valid)
+    {
+        baselines[sample.demo] = sample;
+        snapshot.maxPenetration = 0.0f;
+    }
+    const ConservationStats &base = baselines[sample.demo].stats;
+    float baseEnergy = base.kinetic + base.potential;
+    snapshot.valid = true;
+    snapshot.latest = sample;
+    snapshot.energyDrift = baseEnergy > 0.0f ? (s.kinetic + s.potential - baseEnergy) / baseEnergy : 0.0f;
+    snapshot.momentumDriftX = s.momentumX - base.momentumX;
+    snapshot.momentumDriftY = s.momentumY - base.momentumY;
+    snapshot.maxPenetration = std::max(snapshot.maxPenetration, s.penetration);
+}
+
+static void telemetrySink()
+{
+    profilerSetThreadName("telemetry sink");
+    TelemetrySample sample;
+    for (;;)
+    {
+        bool running = telemetryRunning.load(std::memory_order_acquire);
+        bool any = !telemetryRing.empty();
+        if (any)
+        {
+            PROFILE_ZONE("Telemetry drain");
+            while (telemetryRing.pop(sample))
+                consumeSample(sample);
+        }
+        if (!running)
+            break;
+        if (!any)
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
+
+void initTelemetry(const char *csvPath)
+{
+    if (csvPath)
+    {
+        telemetryFile = fopen(csvPath, "w");
+        if (telemetryFile)
+            fprintf(telemetryFile, "step,demo,restart,kinetic,potential,momentum_x,momentum_y,penetration\n");
+        else
+            std::cerr << "ERROR::TELEMETRY::FILE_NOT_OPENED " << csvPath << std::endl;
+    }
+    telemetryRunning = true;
+    telemetryThread = std::thread(telemetrySink);
+}
+
+void recordTelemetry(int demo, unsigned long long step, bool restart, const ConservationStats &stats)
+{
+    TelemetrySample sample;
+    sample.step = step;
+    sample.demo = demo;
+    sample.restart = restart || pendingRestart[demo];
+    sample.stats = stats;
+    if (telemetryRing.push(sample))
+    {
+        pendingRestart[demo] = false;
+    }
+    else
+    {
+        pendingRestart[demo] = sample.restart;
+        telemetryDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+TelemetrySnapshot telemetrySnapshot(int demo)
+{
+    std::lock_guard<std::mutex> lock(snapshotMutex);
+    return snapshots[demo];
+}
+
+void shutdownTelemetry()
+{
+    if (!telemetryRunning)
+        return;
+    telemetryRunning = false;
+    telemetryThread.join();
+    if (telemetryFile)
+        fclose(telemetryFile);
+    telemetryFile = NULL;
+    if (telemetryDropped > 0)
+        std::cout << "Telemetry: " << telemetryDropped << " samples dropped (sink fell behind)" << std::endl;
+}
+
+#endif
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "simulation.h"
+
+// Telemetry ring for the conservation monitors. The simulation thread records
+// each step's ConservationStats into a fixed-size lock-free ring; a sink thread
+// drains it into an optional CSV file and keeps the latest values for the HUD.
+// Recording never blocks: if the sink falls behind, samples are dropped and
+// counted. With PHYSICS_TELEMETRY=0 recording compiles to nothing.
+
+// Samples the ring holds before the producer starts dropping
+const int TELEMETRY_RING_SIZE = 4096;
+
+struct TelemetrySample
+{
+    unsigned long long step;
+    int demo;     // Which demo produced it (the caller's own numbering, < TELEMETRY_MAX_DEMOS)
+    bool restart; // Demo state was reset; drift is measured from here
+    ConservationStats stats;
+};
+
+const int TELEMETRY_MAX_DEMOS = 8;
+
+// HUD view of one demo's most recent sample and its drift since the last restart
+struct TelemetrySnapshot
+{
+    bool valid;
+    TelemetrySample latest;
+    float energyDrift;      // Relative change in kinetic + potential energy
+    float momentumDriftX;   // Absolute change in momentum
+    float momentumDriftY;
+    float maxPenetration;   // Deepest penetration since the restart
+};
+
+#if PHYSICS_TELEMETRY
+
+// Start the sink thread; csvPath may be NULL for HUD-only monitoring
+void initTelemetry(const char *csvPath);
+
+// Producer side, called from the simulation thread after each step
+void recordTelemetry(int demo, unsigned long long step, bool restart, const ConservationStats &stats);
+
+// Latest values for a demo, as last seen by the sink
+TelemetrySnapshot telemetrySnapshot(int demo);
+
+// Stop the sink after draining what is left and report dropped samples
+void shutdownTelemetry();
+
+#else
+
+inline void initTelemetry(const char *) {}
+inline void recordTelemetry(int, unsigned long long, bool, const ConservationStats &) {}
+inline TelemetrySnapshot telemetrySnapshot(int) { return TelemetrySnapshot(); }
+inline void shutdownTelemetry() {}
+
+#endif